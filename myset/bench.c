@@ -0,0 +1,427 @@
+/**
+ * @file bench.c
+ * @brief Benchmarks of the set operations and of the command loop.
+ *
+ * The micro benchmarks time addToSet, isInSet and the binary operations on
+ * random sets of several universe sizes and densities, for each representation,
+ * and the atomic insertions into shared bitmap sets.
+ * The macro benchmark runs a generated command stream shaped like
+ * valid_input.txt through the command loop and reports commands per second.
+ * Every result is one row of CSV, or one object of a JSON array, so runs can be
+ * compared across releases.
+ *
+ * Usage: myset_bench [-o csv|json] [-k auto|scalar|sse2|avx2|avx512] [-n commands]
+ *   -o  Format of the results (default csv).
+ *   -k  Forces the kernel backend used by the set operations.
+ *   -n  Number of commands in the stream of the macro benchmark.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "program.h"
+#include "set_atomic.h"
+#include "set_kernels.h"
+#include "string_utils.h"
+#include "output_utils.h"
+
+#define BENCH_MIN_NS 50000000.0  /**< Define the shortest time a measurement is repeated for, in nanoseconds */
+#define BENCH_QUERIES 65536      /**< Define the number of random numbers looked up by isInSet */
+#define BENCH_COMMANDS 200000    /**< Define the default number of commands of the macro benchmark */
+#define BENCH_READ_LEN 8         /**< Define the number of elements of a generated read_set */
+
+/**
+ * @brief Enumeration representing the formats of the results.
+ */
+typedef enum {
+    FORMAT_CSV, /**< One comma separated row per result, after a header */
+    FORMAT_JSON /**< One object per result, in an array */
+} OutputFormat;
+
+/**
+ * @brief Structure representing a binary operation to time.
+ */
+typedef struct {
+    const char *name;                 /**< Name of the operation */
+    void (*op)(set *, set *, set *);  /**< Function computing it */
+} binaryOp;
+
+static const binaryOp binaryOps[] = {
+    { "union_set", union_set },
+    { "intersect_set", intersect_set },
+    { "sub_set", sub_set },
+    { "symdiff_set", symdiff_set }
+};
+
+static const unsigned long universes[] = { 1UL << 16, 1UL << 20, 1UL << 24 };
+static const double densities[] = { 0.001, 0.01, 0.1, 0.5 };
+
+static OutputFormat format = FORMAT_CSV; /**< Format of the results */
+static int rows = 0;                     /**< Number of results printed so far */
+static unsigned long seed = 2463534242UL; /**< State of the random number generator */
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return The current time in nanoseconds.
+ */
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Draws a random number with a 32-bit xorshift generator.
+ *
+ * The sequence is the same on every run, so runs time the same work.
+ *
+ * @param limit Number of possible values.
+ * @return A number between 0 and limit - 1.
+ */
+static unsigned long nextRandom(unsigned long limit) {
+    seed ^= (seed << 13) & 0xFFFFFFFFUL;
+    seed ^= seed >> 17;
+    seed ^= (seed << 5) & 0xFFFFFFFFUL;
+    return seed % limit;
+}
+
+/**
+ * @brief Allocates an array of random numbers.
+ *
+ * @param len Number of numbers.
+ * @param limit Number of possible values of each number.
+ * @return The array, to be released with free.
+ */
+static unsigned long *randomArray(size_t len, unsigned long limit) {
+    unsigned long *arr = (unsigned long *)malloc((len ? len : 1) * sizeof(unsigned long));
+    size_t i;
+
+    if(!arr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for(i = 0; i < len; i++)
+        arr[i] = nextRandom(limit);
+    return arr;
+}
+
+/**
+ * @brief Prints one result.
+ *
+ * @param name Name of what was measured.
+ * @param kind Representation of the sets.
+ * @param universe Number of elements in the universe.
+ * @param density Fraction of the universe in each set, negative if it does not apply.
+ * @param iterations Number of operations timed.
+ * @param value The result.
+ * @param unit Unit of the result.
+ */
+static void printResult(const char *name, SetKind kind, unsigned long universe, double density,
+                        unsigned long iterations, double value, const char *unit) {
+    const char *kindName = kind == SET_BITMAP ? "bitmap" : "roaring";
+
+    if(format == FORMAT_CSV) {
+        if(!rows) printf("benchmark,representation,universe,density,iterations,value,unit\n");
+        printf("%s,%s,%lu,", name, kindName, universe);
+        if(density >= 0) printf("%g", density);
+        printf(",%lu,%.3f,%s\n", iterations, value, unit);
+    }
+    else {
+        printf("%s\n  {\"benchmark\": \"%s\", \"representation\": \"%s\", \"universe\": %lu, \"density\": ",
+               rows ? "," : "[", name, kindName, universe);
+        if(density >= 0) printf("%g", density);
+        else printf("null");
+        printf(", \"iterations\": %lu, \"value\": %.3f, \"unit\": \"%s\"}", iterations, value, unit);
+    }
+
+    rows++;
+    fflush(stdout);
+}
+
+/**
+ * @brief Times addToSet by filling an empty set with random numbers.
+ *
+ * The set is emptied before each round, which is included in the time.
+ *
+ * @param A Pointer to the set.
+ * @param values Numbers to add.
+ * @param len Number of numbers.
+ * @param ops Where the number of additions timed is stored.
+ * @return Time per addition in nanoseconds.
+ */
+static double timeAdd(set *A, const unsigned long *values, size_t len, unsigned long *ops) {
+    double start = now(), elapsed;
+    size_t i;
+
+    *ops = 0;
+    do {
+        emptySet(A);
+        for(i = 0; i < len; i++)
+            addToSet(A, values[i]);
+        *ops += len;
+        elapsed = now() - start;
+    } while(elapsed < BENCH_MIN_NS);
+
+    return elapsed / *ops;
+}
+
+/**
+ * @brief Times the atomic insertions by filling an empty shared set with random numbers.
+ *
+ * @param A Pointer to the set, a bitmap.
+ * @param values Numbers to add.
+ * @param len Number of numbers.
+ * @param bulk 1 to add the whole array with atomicAddArray, 0 to add the numbers one by one.
+ * @param ops Where the number of additions timed is stored.
+ * @return Time per addition in nanoseconds.
+ */
+static double timeAtomicAdd(set *A, const unsigned long *values, size_t len, int bulk, unsigned long *ops) {
+    double start = now(), elapsed;
+    sharedSet S;
+    size_t i;
+
+    shareSet(&S, A);
+    *ops = 0;
+    do {
+        emptySet(A);
+        if(bulk) atomicAddArray(&S, values, len);
+        else {
+            for(i = 0; i < len; i++)
+                atomicAddToSet(&S, values[i]);
+        }
+        *ops += len;
+        elapsed = now() - start;
+    } while(elapsed < BENCH_MIN_NS);
+
+    return elapsed / *ops;
+}
+
+/**
+ * @brief Times isInSet on random numbers, members or not.
+ *
+ * @param A Pointer to the set.
+ * @param queries Numbers to look up.
+ * @param ops Where the number of lookups timed is stored.
+ * @return Time per lookup in nanoseconds.
+ */
+static double timeLookup(set *A, const unsigned long *queries, unsigned long *ops) {
+    double start = now(), elapsed;
+    unsigned long found = 0;
+    size_t i;
+
+    *ops = 0;
+    do {
+        for(i = 0; i < BENCH_QUERIES; i++)
+            found += (unsigned long)isInSet(A, queries[i]);
+        *ops += BENCH_QUERIES;
+        elapsed = now() - start;
+    } while(elapsed < BENCH_MIN_NS);
+
+    /* Use the lookups so they are not optimized away */
+    if(found > *ops) printf("unreachable\n");
+    return elapsed / *ops;
+}
+
+/**
+ * @brief Times a binary operation on two sets.
+ *
+ * @param op The operation.
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the result set, distinct from A and B.
+ * @param ops Where the number of operations timed is stored.
+ * @return Time per operation in nanoseconds.
+ */
+static double timeBinary(const binaryOp *op, set *A, set *B, set *C, unsigned long *ops) {
+    double start = now(), elapsed;
+
+    *ops = 0;
+    do {
+        op->op(A, B, C);
+        (*ops)++;
+        elapsed = now() - start;
+    } while(elapsed < BENCH_MIN_NS);
+
+    return elapsed / *ops;
+}
+
+/**
+ * @brief Runs the micro benchmarks for one universe, density and representation.
+ *
+ * @param universe Number of elements in the universe.
+ * @param density Fraction of the universe added to each set.
+ * @param kind Representation of the sets.
+ */
+static void benchSets(unsigned long universe, double density, SetKind kind) {
+    size_t len = (size_t)(universe * density), i;
+    unsigned long *values = randomArray(len, universe), *other = randomArray(len, universe);
+    unsigned long *queries = randomArray(BENCH_QUERIES, universe), ops;
+    set A, B, C;
+    double ns;
+
+    initSet(&A, universe - 1, kind);
+    initSet(&B, universe - 1, kind);
+    initSet(&C, universe - 1, kind);
+
+    ns = timeAdd(&A, values, len, &ops);
+    printResult("addToSet", kind, universe, density, ops, ns, "ns/op");
+
+    ns = timeLookup(&A, queries, &ops);
+    printResult("isInSet", kind, universe, density, ops, ns, "ns/op");
+
+    if(kind == SET_BITMAP) {
+        ns = timeAtomicAdd(&C, values, len, 0, &ops);
+        printResult("atomicAddToSet", kind, universe, density, ops, ns, "ns/op");
+        ns = timeAtomicAdd(&C, values, len, 1, &ops);
+        printResult("atomicAddArray", kind, universe, density, ops, ns, "ns/op");
+    }
+
+    for(i = 0; i < len; i++)
+        addToSet(&B, other[i]);
+    for(i = 0; i < sizeof(binaryOps) / sizeof(binaryOps[0]); i++) {
+        ns = timeBinary(&binaryOps[i], &A, &B, &C, &ops);
+        printResult(binaryOps[i].name, kind, universe, density, ops, ns, "ns/op");
+    }
+
+    freeSet(&A);
+    freeSet(&B);
+    freeSet(&C);
+    free(values);
+    free(other);
+    free(queries);
+}
+
+/**
+ * @brief Writes a random command stream shaped like valid_input.txt.
+ *
+ * The stream reads lists into the sets, prints them and combines them with
+ * the binary operations, and ends with the stop command.
+ *
+ * @param file The file to write to.
+ * @param commands Number of commands before the stop command.
+ * @param universe Number of elements in the universe.
+ */
+static void writeCommands(FILE *file, unsigned long commands, unsigned long universe) {
+    static const char *names[SET_COUNT] = { "SETA", "SETB", "SETC", "SETD", "SETE", "SETF" };
+    unsigned long c, choice;
+    int i;
+
+    for(c = 0; c < commands; c++) {
+        choice = nextRandom(10);
+        if(choice < 3) {
+            fprintf(file, "read_set %s", names[nextRandom(SET_COUNT)]);
+            for(i = 0; i < BENCH_READ_LEN; i++)
+                fprintf(file, ", %lu", nextRandom(universe));
+            fprintf(file, ", -1\n");
+        }
+        else if(choice < 7)
+            fprintf(file, "print_set %s\n", names[nextRandom(SET_COUNT)]);
+        else
+            fprintf(file, "%s %s, %s, %s\n", binaryOps[nextRandom(4)].name, names[nextRandom(SET_COUNT)],
+                    names[nextRandom(SET_COUNT)], names[nextRandom(SET_COUNT)]);
+    }
+    fprintf(file, "stop\n");
+}
+
+/**
+ * @brief Runs a generated command stream through the command loop.
+ *
+ * The output of the commands is discarded while the stream runs.
+ *
+ * @param commands Number of commands in the stream.
+ * @param universe Number of elements in the universe.
+ * @param kind Representation of the sets.
+ * @return 0 if successful, 1 if the stream could not be set up.
+ */
+static int benchCommands(unsigned long commands, unsigned long universe, SetKind kind) {
+    static const char *names[SET_COUNT] = { "SETA", "SETB", "SETC", "SETD", "SETE", "SETF" };
+    char path[64];
+    int fd, out, devNull, i;
+    FILE *file;
+    registry sets;
+    double start, elapsed;
+
+    sprintf(path, "/tmp/myset_bench.%ld", (long)getpid());
+    fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if(fd < 0 || !(file = fdopen(fd, "w"))) {
+        fprintf(stderr, "Cannot create command stream\n");
+        return 1;
+    }
+    writeCommands(file, commands, universe);
+    fclose(file);
+
+    initRegistry(&sets, universe - 1, kind);
+    for(i = 0; i < SET_COUNT; i++)
+        createSet(&sets, names[i], strlen(names[i]));
+
+    /* The command output goes to /dev/null while the results stay on stdout */
+    out = dup(STDOUT_FILENO);
+    devNull = open("/dev/null", O_WRONLY);
+    if(openInput(path) || out < 0 || devNull < 0) {
+        fprintf(stderr, "Cannot open command stream\n");
+        unlink(path);
+        return 1;
+    }
+    dup2(devNull, STDOUT_FILENO);
+
+    start = now();
+    boot_program(&sets);
+    flushOutput();
+    elapsed = now() - start;
+
+    dup2(out, STDOUT_FILENO);
+    close(out);
+    close(devNull);
+    closeInput();
+    unlink(path);
+    freeRegistry(&sets);
+
+    printResult("parseInput", kind, universe, -1, commands + 1, (commands + 1) / (elapsed / 1e9), "commands/s");
+    return 0;
+}
+
+/**
+ * @brief The main function of the benchmark program.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Array of command line arguments.
+ * @return 0 on successful execution, 1 if the command line is invalid or a benchmark fails.
+ */
+int main(int argc, char *argv[]) {
+    unsigned long commands = BENCH_COMMANDS;
+    size_t u, d;
+    int i, k;
+    char *end;
+
+    for(i = 1; i + 1 < argc; i += 2) {
+        if(!strcmp(argv[i], "-o") && !strcmp(argv[i + 1], "csv")) format = FORMAT_CSV;
+        else if(!strcmp(argv[i], "-o") && !strcmp(argv[i + 1], "json")) format = FORMAT_JSON;
+        else if(!strcmp(argv[i], "-k") && !selectKernels(parseKernelBackend(argv[i + 1])));
+        else if(!strcmp(argv[i], "-n") && (commands = strtoul(argv[i + 1], &end, 10)) && !*end);
+        else break;
+    }
+    if(i < argc) {
+        fprintf(stderr, "Usage: %s [-o csv|json] [-k auto|scalar|sse2|avx2|avx512] [-n commands]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* The commands run quietly, like a batch file */
+    setQuiet(1);
+
+    for(k = SET_BITMAP; k <= SET_ROARING; k++)
+        for(u = 0; u < sizeof(universes) / sizeof(universes[0]); u++)
+            for(d = 0; d < sizeof(densities) / sizeof(densities[0]); d++)
+                benchSets(universes[u], densities[d], (SetKind)k);
+
+    for(k = SET_BITMAP; k <= SET_ROARING; k++)
+        if(benchCommands(commands, SET_SIZE, (SetKind)k) || benchCommands(commands, universes[1], (SetKind)k))
+            return EXIT_FAILURE;
+
+    if(format == FORMAT_JSON) printf("%s]\n", rows ? "\n" : "[");
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file bit_utils.c
+ * @brief A collection of utility functions for bit manipulation within a word.
+ */
+
+#include "bit_utils.h"
+
+/**
+ * @brief Counts the bits set in a word.
+ *
+ * @param w The word.
+ * @return Number of bits set.
+ */
+unsigned long popcountWord(setWord w) {
+#ifdef __GNUC__
+    return (unsigned long)__builtin_popcountl(w);
+#else
+    unsigned long count = 0;
+
+    /* Clear the lowest set bit until none is left */
+    for(; w; w &= w - 1)
+        count++;
+    return count;
+#endif
+}
+
+/**
+ * @brief Finds the position of the lowest bit set in a non-zero word.
+ *
+ * @param w The word, must not be 0.
+ * @return Position of the lowest set bit.
+ */
+unsigned long lowestBit(setWord w) {
+#ifdef __GNUC__
+    return (unsigned long)__builtin_ctzl(w);
+#else
+    unsigned long i = 0;
+
+    for(; !(w & 1); w >>= 1)
+        i++;
+    return i;
+#endif
+}
+
+/**
+ * @brief Finds the position of the k-th lowest bit set in a word.
+ *
+ * @param w The word.
+ * @param k Index of the bit among the set bits, starting from 0.
+ * @return Position of the bit, the word must have more than k bits set.
+ */
+unsigned long selectBit(setWord w, unsigned long k) {
+    unsigned long skip = 0, half;
+    setWord low;
+
+    /* Narrow down to the half of the word holding the bit */
+    for(half = WORD_BITS / 2; half >= BYTE_SIZE; half /= 2) {
+        low = w & ((~(setWord)0) >> (WORD_BITS - half));
+        if(popcountWord(low) <= k) {
+            k -= popcountWord(low);
+            w >>= half;
+            skip += half;
+        }
+        else w = low;
+    }
+
+    /* Clear the k lower bits left in the byte */
+    for(; k; k--)
+        w &= w - 1;
+    return skip + lowestBit(w);
+}
+
+/**
+ * @brief Finds the first bit of a given value at or after a position in an array of words.
+ *
+ * @param bits Array of words.
+ * @param words Number of words in the array.
+ * @param from Position to start from.
+ * @param flip 0 to look for a set bit, all bits set to look for a clear bit.
+ * @param pos Where the position of the bit found is stored.
+ * @return 1 if a bit was found, 0 otherwise.
+ */
+static int nextBit(const setWord *bits, size_t words, unsigned long from, setWord flip, unsigned long *pos) {
+    size_t i = from / WORD_BITS;
+    setWord w;
+
+    if(i >= words) return 0;
+
+    /* Mask the bits below from in its word, then skip words without a match */
+    w = (bits[i] ^ flip) & (~(setWord)0 << (from % WORD_BITS));
+    while(!w) {
+        if(++i == words) return 0;
+        w = bits[i] ^ flip;
+    }
+
+    *pos = i * WORD_BITS + lowestBit(w);
+    return 1;
+}
+
+/**
+ * @brief Finds the first set bit at or after a position in an array of words.
+ *
+ * Words holding no set bit are skipped whole.
+ *
+ * @param bits Array of words.
+ * @param words Number of words in the array.
+ * @param from Position to start from.
+ * @param pos Where the position of the bit found is stored.
+ * @return 1 if a set bit was found, 0 otherwise.
+ */
+int nextSetBit(const setWord *bits, size_t words, unsigned long from, unsigned long *pos) {
+    return nextBit(bits, words, from, 0, pos);
+}
+
+/**
+ * @brief Finds the first clear bit at or after a position in an array of words.
+ *
+ * Words with every bit set are skipped whole.
+ *
+ * @param bits Array of words.
+ * @param words Number of words in the array.
+ * @param from Position to start from.
+ * @param pos Where the position of the bit found is stored.
+ * @return 1 if a clear bit was found, 0 otherwise.
+ */
+int nextClearBit(const setWord *bits, size_t words, unsigned long from, unsigned long *pos) {
+    return nextBit(bits, words, from, ~(setWord)0, pos);
+}
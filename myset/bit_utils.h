@@ -0,0 +1,65 @@
+/**
+ * @file bit_utils.h
+ * @brief Utility functions for bit manipulation within a word.
+ *
+ * The functions use the population count and count trailing zeros
+ * instructions through compiler builtins when they are available.
+ */
+
+#ifndef BIT_UTILS_H
+#define BIT_UTILS_H
+
+#include "set.h"
+
+/**
+ * @brief Counts the bits set in a word.
+ *
+ * @param w The word.
+ * @return Number of bits set.
+ */
+unsigned long popcountWord(setWord w);
+
+/**
+ * @brief Finds the position of the lowest bit set in a non-zero word.
+ *
+ * @param w The word, must not be 0.
+ * @return Position of the lowest set bit.
+ */
+unsigned long lowestBit(setWord w);
+
+/**
+ * @brief Finds the position of the k-th lowest bit set in a word.
+ *
+ * @param w The word.
+ * @param k Index of the bit among the set bits, starting from 0.
+ * @return Position of the bit, the word must have more than k bits set.
+ */
+unsigned long selectBit(setWord w, unsigned long k);
+
+/**
+ * @brief Finds the first set bit at or after a position in an array of words.
+ *
+ * Words holding no set bit are skipped whole.
+ *
+ * @param bits Array of words.
+ * @param words Number of words in the array.
+ * @param from Position to start from.
+ * @param pos Where the position of the bit found is stored.
+ * @return 1 if a set bit was found, 0 otherwise.
+ */
+int nextSetBit(const setWord *bits, size_t words, unsigned long from, unsigned long *pos);
+
+/**
+ * @brief Finds the first clear bit at or after a position in an array of words.
+ *
+ * Words with every bit set are skipped whole.
+ *
+ * @param bits Array of words.
+ * @param words Number of words in the array.
+ * @param from Position to start from.
+ * @param pos Where the position of the bit found is stored.
+ * @return 1 if a clear bit was found, 0 otherwise.
+ */
+int nextClearBit(const setWord *bits, size_t words, unsigned long from, unsigned long *pos);
+
+#endif /* BIT_UTILS_H */
@@ -0,0 +1,720 @@
+/**
+ * @file command_log.c
+ * @brief Write-ahead log of the commands that change the sets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "command_log.h"
+#include "snapshot.h"
+#include "expr.h"
+#include "memory_utils.h"
+
+/**
+ * @brief Structure representing the header of a command log.
+ */
+typedef struct {
+    char magic[8];            /**< LOG_MAGIC, without its terminator */
+    unsigned long version;    /**< Version of the format */
+    unsigned long byteOrder;  /**< SNAPSHOT_BYTE_ORDER as stored by the machine that wrote it */
+    unsigned long wordSize;   /**< Size of a word in bytes */
+    unsigned long generation; /**< Number of times the log was compacted, the snapshot of the log has the same */
+} logHeader;
+
+/**
+ * @brief Structure representing a buffer of records.
+ */
+typedef struct {
+    char *data;  /**< The records */
+    size_t used; /**< Number of bytes of records */
+    size_t cap;  /**< Size of the buffer in bytes */
+} logBuffer;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; /**< Guards every variable below */
+static pthread_cond_t synced = PTHREAD_COND_INITIALIZER; /**< Broadcast when a sync ends */
+static int logFd = -1;                                   /**< Descriptor of the log, -1 while the commands are not logged */
+static char *logPath = NULL;                             /**< Path of the log */
+static char *snapshotPath = NULL;                        /**< Path of the snapshot of the log */
+static unsigned long generation = 0;                     /**< Generation of the log */
+static logBuffer pending;                                /**< Records appended since the last sync started */
+static logBuffer writing;                                /**< Records being written by the sync in progress */
+static unsigned long appended = 0;                       /**< Position of the end of the last record appended */
+static unsigned long durable = 0;                        /**< Position up to which the records are on disk */
+static unsigned long fileSize = 0;                       /**< Number of bytes of records in the log file */
+static unsigned long compactAt = LOG_COMPACT_SIZE;       /**< Number of bytes of records the log is compacted at */
+static int syncing = 0;                                  /**< 1 while a sync is in progress */
+
+/**
+ * @brief Allocates memory, exiting the program if the allocation fails.
+ *
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the allocated memory.
+ */
+static void *allocOrExit(size_t size) {
+    void *ptr = malloc(size);
+
+    if(!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Exits the program once the log cannot be written.
+ *
+ * The commands already answered would be lost by a crash, so the program
+ * stops rather than answer more of them.
+ */
+static void failLog(void) {
+    fprintf(stderr, "Cannot write command log: %s\n", logPath);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Rounds a size up to a whole number of words.
+ *
+ * @param size The size in bytes.
+ * @return The smallest multiple of the word size not less than size.
+ */
+static size_t wordAlign(size_t size) {
+    return (size + sizeof(unsigned long) - 1) / sizeof(unsigned long) * sizeof(unsigned long);
+}
+
+/**
+ * @brief Writes bytes to a descriptor, retrying short and interrupted writes.
+ *
+ * @param fd The descriptor.
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @return 0 if successful, 1 if the write failed.
+ */
+static int writeAll(int fd, const char *data, size_t len) {
+    ssize_t n;
+
+    while(len) {
+        n = write(fd, data, len);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return 1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Syncs the directory holding a file, so that a file renamed into it stays there.
+ *
+ * @param path Path of the file.
+ * @return 0 if successful, 1 if the directory cannot be synced.
+ */
+static int syncDirectory(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir;
+    int fd, failed;
+
+    if(!slash) dir = strcpy((char *)allocOrExit(2), ".");
+    else {
+        dir = (char *)allocOrExit((size_t)(slash - path) + 2);
+        memcpy(dir, path, (size_t)(slash - path) + 1);
+        dir[slash - path + 1] = '\0';
+    }
+
+    fd = open(dir, O_RDONLY);
+    free(dir);
+    if(fd < 0) return 1;
+
+    /* Some file systems cannot sync a directory, their renames are durable already */
+    failed = fsync(fd) && errno != EINVAL;
+    close(fd);
+    return failed;
+}
+
+/**
+ * @brief Writes the header of a new log file, replacing its records.
+ *
+ * @param gen Generation of the log.
+ * @return 0 if successful, 1 if the log cannot be written.
+ */
+static int startFile(unsigned long gen) {
+    logHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+    header.version = LOG_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.wordSize = sizeof(unsigned long);
+    header.generation = gen;
+
+    /* The log is opened for appending, so the header lands at the start of the emptied file */
+    if(ftruncate(logFd, 0) || writeAll(logFd, (const char *)&header, sizeof(header)) || fsync(logFd))
+        return 1;
+
+    generation = gen;
+    fileSize = 0;
+    return 0;
+}
+
+/**
+ * @brief Writes and syncs every record appended so far.
+ *
+ * The records are moved to the second buffer, so commands keep appending
+ * while they are written, and the next sync takes all of them at once.
+ *
+ * @note The lock must be held and no sync may be in progress, the lock is released during the sync.
+ */
+static void syncRecords(void) {
+    unsigned long end = appended;
+    logBuffer swap;
+    int failed;
+
+    swap = writing;
+    writing = pending;
+    pending = swap;
+    pending.used = 0;
+    syncing = 1;
+
+    pthread_mutex_unlock(&lock);
+    failed = writeAll(logFd, writing.data, writing.used) || fsync(logFd);
+    pthread_mutex_lock(&lock);
+    if(failed) failLog();
+
+    fileSize += writing.used;
+    writing.used = 0;
+    durable = end;
+    syncing = 0;
+    pthread_cond_broadcast(&synced);
+}
+
+/**
+ * @brief Reserves space for a record at the end of the pending records.
+ *
+ * @param opr Operation of the command.
+ * @param fields Number of fields.
+ * @param size Number of bytes of the fields, with their lengths and padding.
+ * @return Pointer to the first field, the header is filled but for its checksum.
+ * @note The lock must be held until the record is ended.
+ */
+static char *startRecord(Operation opr, size_t fields, size_t size) {
+    size_t need = pending.used + sizeof(logRecord) + size;
+    logRecord *rec;
+    char *data;
+
+    if(need > pending.cap) {
+        pending.cap = need > 2 * pending.cap ? need : 2 * pending.cap;
+        data = (char *)allocOrExit(pending.cap);
+        if(pending.used) memcpy(data, pending.data, pending.used);
+        free(pending.data);
+        pending.data = data;
+    }
+
+    rec = (logRecord *)(pending.data + pending.used);
+    rec->size = size;
+    rec->opr = (unsigned long)opr;
+    rec->fields = fields;
+    rec->checksum = 0;
+    return (char *)(rec + 1);
+}
+
+/**
+ * @brief Stores a field of a record.
+ *
+ * @param dst Where the field starts.
+ * @param data The bytes of the field, NULL to leave them to the caller.
+ * @param len Number of bytes of the field.
+ * @return Pointer to the end of the field.
+ */
+static char *putField(char *dst, const void *data, size_t len) {
+    size_t padded = wordAlign(len);
+    unsigned long field = len;
+
+    memcpy(dst, &field, sizeof(field));
+    dst += sizeof(field);
+    if(data) memcpy(dst, data, len);
+    memset(dst + len, 0, padded - len);
+    return dst + padded;
+}
+
+/**
+ * @brief Ends the record being appended.
+ *
+ * A command that does not wait for its record would let the records pile
+ * up, so a full buffer is synced by the command that filled it.
+ *
+ * @return Position in the log of the end of the record.
+ * @note The lock is released.
+ */
+static unsigned long endRecord(void) {
+    logRecord *rec = (logRecord *)(pending.data + pending.used);
+    size_t len = sizeof(logRecord) + rec->size;
+    unsigned long sum = CHECKSUM_SEED, end;
+
+    addChecksum(&sum, (const unsigned long *)rec, len / sizeof(unsigned long));
+    rec->checksum = sum;
+    pending.used += len;
+    appended += len;
+    end = appended;
+
+    if(pending.used >= LOG_BUFFER_SIZE && !syncing) syncRecords();
+    pthread_mutex_unlock(&lock);
+    return end;
+}
+
+/**
+ * @brief Checks whether the commands are logged.
+ *
+ * @return 1 if the command log is open, 0 otherwise.
+ */
+int isLogging(void) {
+    return logFd >= 0;
+}
+
+/**
+ * @brief Logs a read_set command.
+ *
+ * @param name Name of the set.
+ * @param A Pointer to the set, with the elements the command read.
+ * @return Position in the log of the end of the record, 0 if the commands are not logged.
+ */
+unsigned long logRead(token name, set *A) {
+    size_t count, size, i = 0;
+    unsigned long *elements, num;
+    char *dst;
+    int found;
+
+    if(!isLogging()) return 0;
+
+    /* The elements go straight into the record */
+    count = (size_t)countSet(A);
+    size = sizeof(unsigned long) + wordAlign(name.len) + sizeof(unsigned long) + count * sizeof(unsigned long);
+
+    pthread_mutex_lock(&lock);
+    dst = putField(startRecord(READ, 2, size), name.ptr, name.len);
+    putField(dst, NULL, count * sizeof(unsigned long));
+    elements = (unsigned long *)(dst + sizeof(unsigned long));
+    for(found = firstInSet(A, &num); found; found = nextInSet(A, &num))
+        elements[i++] = num;
+    return endRecord();
+}
+
+/**
+ * @brief Logs a command whose fields are names of sets.
+ *
+ * @param opr Operation of the command.
+ * @param names Names of the sets, in the order the command takes them.
+ * @param count Number of names.
+ * @return Position in the log of the end of the record, 0 if the commands are not logged.
+ */
+unsigned long logNames(Operation opr, const token names[], size_t count) {
+    size_t size = 0, i;
+    char *dst;
+
+    if(!isLogging()) return 0;
+
+    for(i = 0; i < count; i++)
+        size += sizeof(unsigned long) + wordAlign(names[i].len);
+
+    pthread_mutex_lock(&lock);
+    dst = startRecord(opr, count, size);
+    for(i = 0; i < count; i++)
+        dst = putField(dst, names[i].ptr, names[i].len);
+    return endRecord();
+}
+
+/**
+ * @brief Logs a command whose field is the text of an expression.
+ *
+ * @param opr EVAL or DEFINE.
+ * @param text The rest of the command, "NAME = expression".
+ * @return Position in the log of the end of the record, 0 if the commands are not logged.
+ */
+unsigned long logText(Operation opr, const char *text) {
+    size_t len = strlen(text);
+
+    if(!isLogging()) return 0;
+
+    pthread_mutex_lock(&lock);
+    putField(startRecord(opr, 1, sizeof(unsigned long) + wordAlign(len)), text, len);
+    return endRecord();
+}
+
+/**
+ * @brief Waits until a record of the command log is on disk.
+ *
+ * The first command to wait syncs every record appended so far, and the
+ * commands arriving during its sync wait for it and then sync their own
+ * records together.
+ *
+ * @param end Position of the end of the record, as returned when it was logged.
+ */
+void commitLog(unsigned long end) {
+    if(!end) return;
+
+    pthread_mutex_lock(&lock);
+    while(durable < end) {
+        if(syncing) pthread_cond_wait(&synced, &lock);
+        else syncRecords();
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Checks whether the command log has grown enough to be compacted.
+ *
+ * @return 1 if the records reach LOG_COMPACT_SIZE bytes, 0 otherwise.
+ */
+int needsCompaction(void) {
+    int needed;
+
+    if(!isLogging()) return 0;
+
+    pthread_mutex_lock(&lock);
+    needed = fileSize + writing.used + pending.used >= compactAt;
+    pthread_mutex_unlock(&lock);
+    return needed;
+}
+
+/**
+ * @brief Saves the sets to the snapshot of the command log and starts the log over.
+ *
+ * The snapshot takes the next generation before the log is emptied. A crash
+ * in between leaves a log older than its snapshot, whose records the
+ * snapshot already holds, so it is started over when it is opened.
+ *
+ * @param R Pointer to the registry, which no other command may use meanwhile.
+ * @return 0 if successful, 1 if the snapshot or the new log cannot be written (an error is printed).
+ */
+int compactLog(registry *R) {
+    SnapshotStatus status;
+
+    if(!isLogging()) return 0;
+
+    /* Every record goes to disk first, so none is lost if the snapshot fails */
+    pthread_mutex_lock(&lock);
+    while(syncing || pending.used) {
+        if(syncing) pthread_cond_wait(&synced, &lock);
+        else syncRecords();
+    }
+
+    status = saveSnapshot(R, snapshotPath, generation + 1);
+    if(status != SNAPSHOT_OK || syncDirectory(snapshotPath)) {
+        /* The log stays whole, and grows further before the next attempt */
+        compactAt = fileSize + LOG_COMPACT_SIZE;
+        pthread_mutex_unlock(&lock);
+        fprintf(stderr, "Cannot compact command log: %s\n", snapshotPath);
+        return 1;
+    }
+
+    if(startFile(generation + 1)) failLog();
+    compactAt = LOG_COMPACT_SIZE;
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+/**
+ * @brief Finds a set named by a field of a record.
+ *
+ * @param R Pointer to the registry.
+ * @param field The field.
+ * @param len Number of bytes of the field.
+ * @return Pointer to the set, or NULL if there is none.
+ */
+static set *fieldSet(registry *R, const char *field, size_t len) {
+    return len ? findSet(R, field, len) : NULL;
+}
+
+/**
+ * @brief Applies a record of the log to the sets.
+ *
+ * @param R Pointer to the registry.
+ * @param opr Operation of the record.
+ * @param fields The fields of the record.
+ * @param lens Number of bytes of each field.
+ * @param count Number of fields.
+ * @param staging Set the elements of a read_set command are collected in.
+ * @param scratch Arena for the expressions and the derived sets.
+ * @return 0 if the record was applied, 1 if it does not match the sets.
+ */
+static int replayRecord(registry *R, Operation opr, char *fields[], size_t lens[], size_t count,
+                        set *staging, arena *scratch) {
+    set *A, *B, *C, **inputs;
+    unsigned long *elements;
+    size_t n, i;
+    char *text;
+
+    switch(opr) {
+        case READ:
+            A = fieldSet(R, fields[0], lens[0]);
+            if(count != 2 || !A || isDerived(A) || lens[1] % sizeof(unsigned long)) return 1;
+
+            /* The elements were read from the set, so they are increasing and in its universe */
+            elements = (unsigned long *)fields[1];
+            n = lens[1] / sizeof(unsigned long);
+            for(i = 0; i < n; i++)
+                if(elements[i] > getMaxValue(A) || (i && elements[i] <= elements[i - 1])) return 1;
+
+            if(getMaxValue(staging) != getMaxValue(A) || getKind(staging) != getKind(A)) {
+                freeSet(staging);
+                initSet(staging, getMaxValue(A), getKind(A));
+            }
+            if(n <= INT_MAX) read_set(staging, elements, (int)n);
+            else {
+                emptySet(staging);
+                for(i = 0; i < n; i++)
+                    addToSet(staging, elements[i]);
+            }
+            swapSets(A, staging);
+            markModified(A);
+            return 0;
+
+        case UNION:
+        case INTERSECT:
+        case SUB:
+        case SYMDIFF:
+            if(count != 3) return 1;
+            A = fieldSet(R, fields[0], lens[0]);
+            B = fieldSet(R, fields[1], lens[1]);
+            C = fieldSet(R, fields[2], lens[2]);
+            if(!A || !B || !C || isDerived(C)) return 1;
+
+            refreshSet(A, R, scratch);
+            refreshSet(B, R, scratch);
+            if(opr == UNION) union_set(A, B, C);
+            else if(opr == INTERSECT) intersect_set(A, B, C);
+            else if(opr == SUB) sub_set(A, B, C);
+            else symdiff_set(A, B, C);
+            markModified(C);
+            return 0;
+
+        case UNION_ALL:
+        case INTERSECT_ALL:
+            C = count ? fieldSet(R, fields[0], lens[0]) : NULL;
+            if(count < 2 || !C || isDerived(C) || count - 1 > INT_MAX) return 1;
+
+            inputs = (set **)arenaAlloc(scratch, (count - 1) * sizeof(set *));
+            for(i = 1; i < count; i++) {
+                if(!(inputs[i - 1] = fieldSet(R, fields[i], lens[i]))) return 1;
+                refreshSet(inputs[i - 1], R, scratch);
+            }
+            if(opr == UNION_ALL) union_all(inputs, (int)(count - 1), C);
+            else intersect_all(inputs, (int)(count - 1), C);
+            markModified(C);
+            return 0;
+
+        case CREATE:
+            return count != 1 || !lens[0] || !createSet(R, fields[0], lens[0]);
+
+        case DROP:
+            A = count == 1 ? fieldSet(R, fields[0], lens[0]) : NULL;
+            if(!A || hasDependents(A)) return 1;
+            return !dropSet(R, fields[0], lens[0]);
+
+        case EVAL:
+        case DEFINE:
+            if(count != 1) return 1;
+
+            /* The expression parser reads up to a terminator */
+            text = (char *)arenaAlloc(scratch, lens[0] + 1);
+            memcpy(text, fields[0], lens[0]);
+            text[lens[0]] = '\0';
+            return opr == EVAL ? eval_set(R, text, staging, scratch) : define_set(R, text, scratch);
+
+        default:
+            return 1;
+    }
+}
+
+/**
+ * @brief Applies every whole record of a mapped log to the sets.
+ *
+ * @param R Pointer to the registry.
+ * @param base Start of the log.
+ * @param size Size of the log in bytes.
+ * @param end Where the end of the last whole record is stored.
+ * @return 0 if every whole record was applied, 1 if a record does not match the sets.
+ */
+static int replayLog(registry *R, char *base, size_t size, size_t *end) {
+    size_t offset = sizeof(logHeader), pos, count, i, *lens;
+    unsigned long sum, checksum, len;
+    char **fields;
+    logRecord rec;
+    arena scratch;
+    set staging;
+    int failed = 0;
+
+    initArena(&scratch);
+    initSet(&staging, R->maxValue, R->kind);
+
+    /* A record cut short or damaged by a crash ends the log */
+    while(!failed && size - offset >= sizeof(logRecord)) {
+        memcpy(&rec, base + offset, sizeof(rec));
+        if(rec.size % sizeof(unsigned long) || rec.size > size - offset - sizeof(rec) ||
+           rec.fields > rec.size / sizeof(unsigned long))
+            break;
+
+        checksum = rec.checksum;
+        rec.checksum = 0;
+        sum = CHECKSUM_SEED;
+        addChecksum(&sum, (const unsigned long *)&rec, sizeof(rec) / sizeof(unsigned long));
+        addChecksum(&sum, (const unsigned long *)(base + offset + sizeof(rec)), rec.size / sizeof(unsigned long));
+        if(sum != checksum) break;
+
+        /* Each field is its length followed by its bytes */
+        count = (size_t)rec.fields;
+        fields = (char **)arenaAlloc(&scratch, (count ? count : 1) * sizeof(char *));
+        lens = (size_t *)arenaAlloc(&scratch, (count ? count : 1) * sizeof(size_t));
+        pos = offset + sizeof(rec);
+        for(i = 0; i < count && !failed; i++) {
+            if((failed = offset + sizeof(rec) + rec.size - pos < sizeof(len))) break;
+            memcpy(&len, base + pos, sizeof(len));
+            pos += sizeof(len);
+            failed = len > offset + sizeof(rec) + rec.size - pos;
+            fields[i] = base + pos;
+            lens[i] = (size_t)len;
+            if(!failed) pos += wordAlign(lens[i]);
+        }
+
+        failed = failed || rec.opr >= NONE_OPERATION ||
+                 replayRecord(R, (Operation)rec.opr, fields, lens, count, &staging, &scratch);
+        if(!failed) offset += sizeof(rec) + rec.size;
+        resetArena(&scratch);
+    }
+
+    freeArena(&scratch);
+    freeSet(&staging);
+    *end = offset;
+    return failed;
+}
+
+/**
+ * @brief Reads the header of a log and applies its records to the sets.
+ *
+ * @param R Pointer to the registry.
+ * @param size Size of the log in bytes.
+ * @param gen Generation of the snapshot the sets were restored from, 0 without one.
+ * @return 0 if successful, 1 if the log is invalid or does not match the sets (an error is printed).
+ */
+static int restoreLog(registry *R, size_t size, unsigned long gen) {
+    logHeader header;
+    size_t end = size;
+    char *base;
+    int failed;
+
+    base = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, logFd, 0);
+    if(base == (char *)MAP_FAILED) {
+        fprintf(stderr, "Cannot open command log: %s\n", logPath);
+        return 1;
+    }
+
+    memcpy(&header, base, sizeof(header));
+    if(memcmp(header.magic, LOG_MAGIC, sizeof(header.magic)) || header.version != LOG_VERSION ||
+       header.byteOrder != SNAPSHOT_BYTE_ORDER || header.wordSize != sizeof(unsigned long)) {
+        munmap(base, size);
+        fprintf(stderr, "Invalid command log: %s\n", logPath);
+        return 1;
+    }
+
+    /* A log older than its snapshot was being compacted, the snapshot holds its records */
+    if(header.generation < gen) {
+        munmap(base, size);
+        if(!startFile(gen)) return 0;
+        fprintf(stderr, "Cannot write command log: %s\n", logPath);
+        return 1;
+    }
+
+    failed = header.generation > gen || replayLog(R, base, size, &end);
+    munmap(base, size);
+    if(failed) {
+        fprintf(stderr, "Command log does not match the sets: %s\n", logPath);
+        return 1;
+    }
+
+    /* The end of a record cut short is dropped, the next records follow the last whole one */
+    generation = gen;
+    fileSize = end - sizeof(logHeader);
+    if(end < size && (ftruncate(logFd, (off_t)end) || fsync(logFd))) {
+        fprintf(stderr, "Cannot write command log: %s\n", logPath);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Opens the command log, restoring the sets it holds.
+ *
+ * A missing log is created. Otherwise the sets of the registry are replaced
+ * with the snapshot of the log, if there is one, and every record of the log
+ * is applied to them.
+ *
+ * @param R Pointer to the registry.
+ * @param path Path of the log, its snapshot is the path followed by LOG_SNAPSHOT_SUFFIX.
+ * @return 0 if successful, 1 if the log cannot be opened or replayed (an error is printed).
+ */
+int openLog(registry *R, const char *path) {
+    unsigned long gen = 0;
+    SnapshotStatus status;
+    struct stat st;
+    int failed;
+
+    logPath = strcpy((char *)allocOrExit(strlen(path) + 1), path);
+    snapshotPath = (char *)allocOrExit(strlen(path) + sizeof(LOG_SNAPSHOT_SUFFIX));
+    strcpy(snapshotPath, path);
+    strcat(snapshotPath, LOG_SNAPSHOT_SUFFIX);
+
+    /* The snapshot holds the sets up to the first record of the log */
+    if(!access(snapshotPath, F_OK) && (status = loadSnapshot(R, snapshotPath, &gen)) != SNAPSHOT_OK) {
+        fprintf(stderr, "%s: %s\n", snapshotMessage(status), snapshotPath);
+        failed = 1;
+    }
+    else if((logFd = open(path, O_RDWR | O_CREAT | O_APPEND, 0666)) < 0 || fstat(logFd, &st)) {
+        fprintf(stderr, "Cannot open command log: %s\n", path);
+        failed = 1;
+    }
+    else if((size_t)st.st_size < sizeof(logHeader)) {
+        /* A new log, or one emptied by a crash before its header was written */
+        failed = startFile(gen);
+        if(failed) fprintf(stderr, "Cannot write command log: %s\n", path);
+    }
+    else failed = restoreLog(R, (size_t)st.st_size, gen);
+
+    if(failed) {
+        if(logFd >= 0) close(logFd);
+        logFd = -1;
+        free(logPath);
+        free(snapshotPath);
+        logPath = snapshotPath = NULL;
+    }
+    return failed;
+}
+
+/**
+ * @brief Syncs the records of the command log and closes it.
+ */
+void closeLog(void) {
+    if(!isLogging()) return;
+
+    pthread_mutex_lock(&lock);
+    while(syncing || pending.used) {
+        if(syncing) pthread_cond_wait(&synced, &lock);
+        else syncRecords();
+    }
+    pthread_mutex_unlock(&lock);
+
+    close(logFd);
+    logFd = -1;
+    free(pending.data);
+    free(writing.data);
+    memset(&pending, 0, sizeof(pending));
+    memset(&writing, 0, sizeof(writing));
+    free(logPath);
+    free(snapshotPath);
+    logPath = snapshotPath = NULL;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file command_log.h
+ * @brief Write-ahead log of the commands that change the sets.
+ *
+ * Every command that changes a set or the registry appends a binary record
+ * to the log while it still holds the sets it wrote, so the records are in
+ * the order the changes were made. A record holds the operation and its
+ * fields: the names of the sets, the elements a read_set command left in its
+ * set, or the text of an expression.
+ *
+ * The records are written and synced to disk in groups. A command waiting for
+ * its record either syncs every record appended so far or waits for the sync
+ * in progress, so the clients of a server share one sync per group of
+ * commands. A command read from a file or a pipe does not wait, its records
+ * are synced when the buffer fills and when the log is closed.
+ *
+ * On startup the sets are restored from the snapshot the log was compacted
+ * into, and the records are applied directly to the sets, without parsing
+ * the commands again. A record cut short by a crash ends the log. Once the
+ * records reach LOG_COMPACT_SIZE bytes, the sets are saved to a new snapshot
+ * and the log starts over, so replaying it never takes long.
+ */
+
+#ifndef COMMAND_LOG_H
+#define COMMAND_LOG_H
+
+#include "set_utils.h"
+
+#define LOG_MAGIC "MYSETLOG"          /**< Define the first bytes of a command log */
+#define LOG_VERSION 1UL               /**< Define the version of the format written */
+#define LOG_BUFFER_SIZE (1UL << 20)   /**< Define the number of bytes of records written at once when no command waits */
+#define LOG_COMPACT_SIZE (64UL << 20) /**< Define the number of bytes of records after which the log is compacted */
+#define LOG_SNAPSHOT_SUFFIX ".snap"   /**< Define the suffix of the snapshot the log was compacted into */
+
+/**
+ * @brief Structure representing the header of a record of the command log.
+ *
+ * The fields follow the header, each one as its length in bytes in a word
+ * followed by its bytes, padded with zeros to a whole number of words.
+ */
+typedef struct {
+    unsigned long size;     /**< Number of bytes of the fields */
+    unsigned long opr;      /**< Operation of the command */
+    unsigned long fields;   /**< Number of fields */
+    unsigned long checksum; /**< Checksum of the header, with this field 0, and of the fields */
+} logRecord;
+
+/**
+ * @brief Opens the command log, restoring the sets it holds.
+ *
+ * A missing log is created. Otherwise the sets of the registry are replaced
+ * with the snapshot of the log, if there is one, and every record of the log
+ * is applied to them.
+ *
+ * @param R Pointer to the registry.
+ * @param path Path of the log, its snapshot is the path followed by LOG_SNAPSHOT_SUFFIX.
+ * @return 0 if successful, 1 if the log cannot be opened or replayed (an error is printed).
+ */
+int openLog(registry *R, const char *path);
+
+/**
+ * @brief Syncs the records of the command log and closes it.
+ */
+void closeLog(void);
+
+/**
+ * @brief Checks whether the commands are logged.
+ *
+ * @return 1 if the command log is open, 0 otherwise.
+ */
+int isLogging(void);
+
+/**
+ * @brief Logs a read_set command.
+ *
+ * @param name Name of the set.
+ * @param A Pointer to the set, with the elements the command read.
+ * @return Position in the log of the end of the record, 0 if the commands are not logged.
+ */
+unsigned long logRead(token name, set *A);
+
+/**
+ * @brief Logs a command whose fields are names of sets.
+ *
+ * @param opr Operation of the command.
+ * @param names Names of the sets, in the order the command takes them.
+ * @param count Number of names.
+ * @return Position in the log of the end of the record, 0 if the commands are not logged.
+ */
+unsigned long logNames(Operation opr, const token names[], size_t count);
+
+/**
+ * @brief Logs a command whose field is the text of an expression.
+ *
+ * @param opr EVAL or DEFINE.
+ * @param text The rest of the command, "NAME = expression".
+ * @return Position in the log of the end of the record, 0 if the commands are not logged.
+ */
+unsigned long logText(Operation opr, const char *text);
+
+/**
+ * @brief Waits until a record of the command log is on disk.
+ *
+ * @param end Position of the end of the record, as returned when it was logged.
+ */
+void commitLog(unsigned long end);
+
+/**
+ * @brief Checks whether the command log has grown enough to be compacted.
+ *
+ * @return 1 if the records reach LOG_COMPACT_SIZE bytes, 0 otherwise.
+ */
+int needsCompaction(void);
+
+/**
+ * @brief Saves the sets to the snapshot of the command log and starts the log over.
+ *
+ * @param R Pointer to the registry, which no other command may use meanwhile.
+ * @return 0 if successful, 1 if the snapshot or the new log cannot be written (an error is printed).
+ */
+int compactLog(registry *R);
+
+#endif /* COMMAND_LOG_H */
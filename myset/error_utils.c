@@ -1,101 +1,96 @@
-/**
- * @file error_utils.c
- * @brief Utility functions for error handling.
- *
- * This file contains utility functions for error handling in set operations.
- */
-
-#include <stdio.h>
-#include <string.h>
-#include "integer_utils.h"
-#include "set_utils.h"
-#include "string_utils.h"
-
-/**
- * @brief Checks if the given string represents a readable set of integers.
- *
- * @param str Pointer to the string to be parsed.
- * @param ptr Temporary pointer used for parsing.
- * @return 1 if the set is readable and correctly formatted, 0 otherwise.
- */
-int isReadableSet(char **str, char *ptr) {
-    int num, foundErr = 0;
-
-    /* Check for the first token in the string */
-    if(nextToken(str, ptr)) return 0;
-
-    /* Iterate through each token */
-    while(*ptr) {
-        num = parseInt(ptr);
-
-        /* Check if the token is a valid integer */
-        if(num == -2) {
-            foundErr = 1;
-            break;
-        }
-
-        /* Validate the length of the integer */
-        else if(strlen(ptr) != countDigits(num)) {
-            printf("Invalid set member - not an integer\n");
-            foundErr = 1;
-            break;
-        }
-
-        /* Check for the end of the list */
-        else if(num == -1) break;
-
-        /* Move to the next token */
-        else if(nextToken(str, ptr)) return 0;
-
-    }
-
-    /* Final validation of the set format */
-    if(!foundErr) {
-        if(num != -1) printf("List of set members is not terminated correctly\n");
-        else if(**str) printf("Extraneous text after end of command\n");
-        else return 1;
-    }
-
-    return 0;
-}
-
-/**
- * @brief Validates the parameters and sets for a given operation.
- *
- * @param opr The operation to be performed.
- * @param ptrArr Array of pointers to parameter strings.
- * @param A Pointer to the first set.
- * @param B Pointer to the second set (if applicable).
- * @param C Pointer to the third set (if applicable).
- * @return 1 if there is an error, 0 otherwise.
- */
-int prompt_err(Operation opr, char *ptrArr[], set *A, set *B, set *C) {
-    int foundErr = 1;
-
-    switch(opr) {
-        case READ:
-            /* Checks whether the user entered the name of the set and elements to read into the set */
-            if(!(*ptrArr[1]) || !(*ptrArr[2])) printf("Missing parameter\n");
-            else if(!A) printf("Undefined set name\n");
-            else foundErr = 0;
-            break;
-
-        case PRINT:
-            /* Checks whether the user entered the name of the set */
-            if(!(*ptrArr[1])) printf("Missing parameter\n");
-            else if(!A) printf("Undefined set name\n");
-            else if(*ptrArr[2]) printf("Extraneous text after end of command\n");
-            else foundErr = 0;
-            break;
-
-        default:
-            /* Checks whether the user entered the names of the sets */
-            if(!(*ptrArr[1]) || !(*ptrArr[2]) || !(*ptrArr[3])) printf("Missing parameter\n");
-            else if(!A || !B || !C) printf("Undefined set name\n");
-            else if(*ptrArr[4]) printf("Extraneous text after end of command\n");
-            else foundErr = 0;
-
-    }
-
-    return foundErr;
+/**
+ * @file error_utils.c
+ * @brief Utility functions for error handling.
+ *
+ * This file contains utility functions for error handling in set operations.
+ */
+
+#include "set_utils.h"
+#include "string_utils.h"
+#include "output_utils.h"
+
+/**
+ * @brief Validates the parameters and sets for a given operation.
+ *
+ * @param opr The operation to be performed.
+ * @param tokens Array of the command tokens.
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set (if applicable).
+ * @param C Pointer to the third set (if applicable).
+ * @return 1 if there is an error, 0 otherwise.
+ */
+int prompt_err(Operation opr, token tokens[], set *A, set *B, set *C) {
+    int foundErr = 1;
+
+    switch(opr) {
+        case READ:
+            /* Checks whether the user entered the name of the set and elements to read into the set */
+            if(!tokens[1].len || !tokens[2].len) writeStr("Missing parameter\n");
+            else if(!A) writeStr("Undefined set name\n");
+            else if(isDerived(A)) writeStr("Derived sets cannot be modified\n");
+            else foundErr = 0;
+            break;
+
+        case PRINT:
+        case SIZE:
+            /* Checks whether the user entered the name of the set */
+            if(!tokens[1].len) writeStr("Missing parameter\n");
+            else if(!A) writeStr("Undefined set name\n");
+            else if(tokens[2].len) writeStr("Extraneous text after end of command\n");
+            else foundErr = 0;
+            break;
+
+        case RANK:
+        case SELECT:
+            /* Checks whether the user entered the name of the set and the number */
+            if(!tokens[1].len || !tokens[2].len) writeStr("Missing parameter\n");
+            else if(!A) writeStr("Undefined set name\n");
+            else if(tokens[3].len) writeStr("Extraneous text after end of command\n");
+            else foundErr = 0;
+            break;
+
+        case CREATE:
+            /* Checks whether the user entered a name that is not in use */
+            if(!tokens[1].len) writeStr("Missing parameter\n");
+            else if(A) writeStr("Set name already in use\n");
+            else if(tokens[2].len) writeStr("Extraneous text after end of command\n");
+            else foundErr = 0;
+            break;
+
+        case DROP:
+            /* Checks whether the user entered the name of a set no derived set uses */
+            if(!tokens[1].len) writeStr("Missing parameter\n");
+            else if(!A) writeStr("Undefined set name\n");
+            else if(hasDependents(A)) writeStr("Set is used by a derived set\n");
+            else if(tokens[2].len) writeStr("Extraneous text after end of command\n");
+            else foundErr = 0;
+            break;
+
+        case STATS:
+            /* Checks whether the user entered a valid option, if any */
+            if(tokens[1].len && !tokenEquals(tokens[1], "on") && !tokenEquals(tokens[1], "off") && !tokenEquals(tokens[1], "reset"))
+                writeStr("Invalid stats option\n");
+            else if(tokens[2].len) writeStr("Extraneous text after end of command\n");
+            else foundErr = 0;
+            break;
+
+        case SAVE:
+        case LOAD:
+            /* Checks whether the user entered the path of the snapshot file */
+            if(!tokens[1].len) writeStr("Missing parameter\n");
+            else if(tokens[2].len) writeStr("Extraneous text after end of command\n");
+            else foundErr = 0;
+            break;
+
+        default:
+            /* Checks whether the user entered the names of the sets */
+            if(!tokens[1].len || !tokens[2].len || !tokens[3].len) writeStr("Missing parameter\n");
+            else if(!A || !B || !C) writeStr("Undefined set name\n");
+            else if(isDerived(C)) writeStr("Derived sets cannot be modified\n");
+            else if(tokens[4].len) writeStr("Extraneous text after end of command\n");
+            else foundErr = 0;
+
+    }
+
+    return foundErr;
 }
\ No newline at end of file
@@ -0,0 +1,349 @@
+/**
+ * @file expr.c
+ * @brief Set expressions of the eval command.
+ */
+
+#include <string.h>
+#include "expr.h"
+#include "output_utils.h"
+
+/**
+ * @brief Structure representing the state of the expression parser.
+ */
+typedef struct {
+    char *pos;          /**< Current position in the command */
+    registry *R;        /**< Registry the names are resolved in */
+    exprProgram *prog;  /**< Program the steps are written to */
+    size_t sp;          /**< Number of entries on the stack after the steps so far */
+    int nesting;        /**< Current depth of parentheses and complements */
+    int undefined;      /**< 1 if a name does not match any set */
+    int refresh;        /**< 1 if derived operands are brought up to date */
+    arena *scratch;     /**< Arena for the definitions of derived operands */
+} exprParser;
+
+static int parseUnion(exprParser *P);
+
+/**
+ * @brief Checks whether a character may appear in a set name of an expression.
+ *
+ * @param c The character.
+ * @return 1 if it is part of a name, 0 if it is a separator or an operator.
+ */
+static int isNameChar(char c) {
+    return c && !strchr(" \t,=()~&|^-", c);
+}
+
+/**
+ * @brief Skips the spaces at the current position.
+ *
+ * @param P Pointer to the parser.
+ */
+static void skipSpaces(exprParser *P) {
+    while(*P->pos == ' ' || *P->pos == '\t') P->pos++;
+}
+
+/**
+ * @brief Prints the error for a missing operand at the current position.
+ *
+ * @param P Pointer to the parser.
+ * @return Always 1.
+ */
+static int missingOperand(exprParser *P) {
+    if(!*P->pos) writeStr("Missing parameter\n");
+    else if(*P->pos == ',') writeStr("Illegal comma\n");
+    else writeStr("Invalid set expression\n");
+    return 1;
+}
+
+/**
+ * @brief Appends a step to the program, keeping track of the stack depth.
+ *
+ * @param P Pointer to the parser.
+ * @param op Operation of the step.
+ * @param operand Set pushed by EXPR_SET, NULL otherwise.
+ */
+static void emit(exprParser *P, ExprOp op, set *operand) {
+    exprProgram *prog = P->prog;
+
+    prog->steps[prog->len].op = op;
+    prog->steps[prog->len].operand = operand;
+    prog->len++;
+
+    if(op == EXPR_SET) {
+        if(++P->sp > prog->depth) prog->depth = P->sp;
+    }
+    else if(op == EXPR_NOT) prog->complement = 1;
+    else P->sp--;
+}
+
+/**
+ * @brief Parses a complement, a parenthesized expression or a set name.
+ *
+ * @param P Pointer to the parser.
+ * @return 0 if successful, 1 if an error was printed.
+ */
+static int parseFactor(exprParser *P) {
+    char *start;
+    set *A;
+
+    skipSpaces(P);
+    if(*P->pos == '~' || *P->pos == '(') {
+        if(++P->nesting > EXPR_MAX_NESTING) {
+            writeStr("Set expression is nested too deeply\n");
+            return 1;
+        }
+
+        if(*P->pos++ == '~') {
+            if(parseFactor(P)) return 1;
+            emit(P, EXPR_NOT, NULL);
+        }
+        else {
+            if(parseUnion(P)) return 1;
+            skipSpaces(P);
+            if(*P->pos != ')') {
+                writeStr("Missing closing parenthesis\n");
+                return 1;
+            }
+            P->pos++;
+        }
+        P->nesting--;
+        return 0;
+    }
+
+    /* A set name, undefined names are reported once the syntax is checked */
+    for(start = P->pos; isNameChar(*P->pos); P->pos++);
+    if(P->pos == start) return missingOperand(P);
+
+    A = findSet(P->R, start, (size_t)(P->pos - start));
+    if(!A) P->undefined = 1;
+    else if(P->refresh) refreshSet(A, P->R, P->scratch);
+    emit(P, EXPR_SET, A);
+    return 0;
+}
+
+/**
+ * @brief Parses factors joined by intersections and differences.
+ *
+ * @param P Pointer to the parser.
+ * @return 0 if successful, 1 if an error was printed.
+ */
+static int parseTerm(exprParser *P) {
+    ExprOp op;
+
+    if(parseFactor(P)) return 1;
+    for(;;) {
+        skipSpaces(P);
+        if(*P->pos == '&') op = EXPR_INTERSECT;
+        else if(*P->pos == '-') op = EXPR_SUB;
+        else return 0;
+
+        P->pos++;
+        if(parseFactor(P)) return 1;
+        emit(P, op, NULL);
+    }
+}
+
+/**
+ * @brief Parses terms joined by unions and symmetric differences.
+ *
+ * @param P Pointer to the parser.
+ * @return 0 if successful, 1 if an error was printed.
+ */
+static int parseUnion(exprParser *P) {
+    ExprOp op;
+
+    if(parseTerm(P)) return 1;
+    for(;;) {
+        skipSpaces(P);
+        if(*P->pos == '|') op = EXPR_UNION;
+        else if(*P->pos == '^') op = EXPR_SYMDIFF;
+        else return 0;
+
+        P->pos++;
+        if(parseTerm(P)) return 1;
+        emit(P, op, NULL);
+    }
+}
+
+/**
+ * @brief Prepares the parser and the program for an expression.
+ *
+ * @param P Pointer to the parser.
+ * @param str The text to parse.
+ * @param R Registry the names are resolved in.
+ * @param scratch Arena for the program.
+ * @param prog Pointer to the program the steps are written to.
+ * @param refresh 1 if derived operands are brought up to date while parsing.
+ */
+static void initParser(exprParser *P, char *str, registry *R, arena *scratch, exprProgram *prog, int refresh) {
+    P->pos = str;
+    P->R = R;
+    P->scratch = scratch;
+    P->prog = prog;
+    P->sp = 0;
+    P->nesting = 0;
+    P->undefined = 0;
+    P->refresh = refresh;
+
+    /* Every step takes at least one character of the text */
+    prog->steps = (exprStep *)arenaAlloc(scratch, (strlen(str) + 1) * sizeof(exprStep));
+    prog->len = 0;
+    prog->depth = 0;
+    prog->complement = 0;
+}
+
+/**
+ * @brief Parses the name of the set being assigned and the equals sign.
+ *
+ * @param P Pointer to the parser.
+ * @param name The name of the set, a view into the command.
+ * @return 0 if successful, 1 if an error was printed.
+ */
+static int parseTarget(exprParser *P, token *name) {
+    skipSpaces(P);
+    for(name->ptr = P->pos; isNameChar(*P->pos); P->pos++);
+    name->len = (size_t)(P->pos - name->ptr);
+    if(!name->len) return missingOperand(P);
+
+    skipSpaces(P);
+    if(*P->pos != '=') {
+        if(!*P->pos) writeStr("Missing parameter\n");
+        else writeStr("Missing assignment\n");
+        return 1;
+    }
+    P->pos++;
+    return 0;
+}
+
+/**
+ * @brief Checks the text after a parsed expression.
+ *
+ * @param P Pointer to the parser.
+ * @return 0 if nothing follows the expression, 1 if an error was printed.
+ */
+static int checkEnd(exprParser *P) {
+    skipSpaces(P);
+    if(*P->pos == ',') writeStr("Illegal comma\n");
+    else if(*P->pos) writeStr("Extraneous text after end of command\n");
+    else return 0;
+    return 1;
+}
+
+/**
+ * @brief Evaluates a compiled expression into a bitmap set.
+ *
+ * @param prog Pointer to the program.
+ * @param scratch Arena for the stack of the evaluation.
+ * @param C Pointer to the bitmap set receiving the result, distinct from every operand.
+ */
+static void runProgram(exprProgram *prog, arena *scratch, set *C) {
+    prog->buffers = (setWord *)arenaAlloc(scratch, prog->depth * EXPR_BLOCK_WORDS * sizeof(setWord));
+    prog->values = (const setWord **)arenaAlloc(scratch, prog->depth * sizeof(setWord *));
+    evalExpression(prog, C);
+}
+
+/**
+ * @brief Computes a derived set again if one of its inputs changed.
+ *
+ * @param A Pointer to a set of the registry.
+ * @param R Registry of the named sets.
+ * @param scratch Arena for the compiled definition.
+ */
+void refreshSet(set *A, registry *R, arena *scratch) {
+    namedSet *node = (namedSet *)A;
+    exprProgram prog;
+    exprParser P;
+    set tmp;
+
+    if(!node->definition || !node->stale) return;
+
+    /* The definition was checked when the set was defined, and its inputs cannot be dropped */
+    initParser(&P, node->definition, R, scratch, &prog, 1);
+    parseUnion(&P);
+
+    /* A derived set is never one of its own operands, a bitmap is computed in place */
+    if(getKind(A) == SET_BITMAP) runProgram(&prog, scratch, A);
+    else {
+        initSet(&tmp, getMaxValue(A), SET_BITMAP);
+        runProgram(&prog, scratch, &tmp);
+        copySet(&tmp, A);
+        freeSet(&tmp);
+    }
+    node->stale = 0;
+}
+
+/**
+ * @brief Evaluates an expression and stores the result in a set.
+ *
+ * @param R Registry of the named sets.
+ * @param str The rest of the command, "TARGET = expression".
+ * @param staging Set the result is computed in before it replaces the target.
+ * @param scratch Arena for the compiled expression.
+ * @return 0 if the target was replaced, 1 if an error was printed.
+ */
+int eval_set(registry *R, char *str, set *staging, arena *scratch) {
+    exprProgram prog;
+    exprParser P;
+    set *target;
+    token name;
+
+    initParser(&P, str, R, scratch, &prog, 1);
+    if(parseTarget(&P, &name) || parseUnion(&P)) return 1;
+    target = findSet(R, name.ptr, name.len);
+
+    if(!target || P.undefined) writeStr("Undefined set name\n");
+    else if(isDerived(target)) writeStr("Derived sets cannot be modified\n");
+    else if(!checkEnd(&P)) {
+        /* The result is computed in a bitmap over the universe of the target */
+        if(getKind(staging) != SET_BITMAP || getMaxValue(staging) != getMaxValue(target)) {
+            freeSet(staging);
+            initSet(staging, getMaxValue(target), SET_BITMAP);
+        }
+        runProgram(&prog, scratch, staging);
+
+        if(getKind(target) == SET_BITMAP) swapSets(target, staging);
+        else copySet(staging, target);
+        markModified(target);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Defines a derived set from an expression.
+ *
+ * @param R Registry of the named sets.
+ * @param str The rest of the command, "NAME = expression".
+ * @param scratch Arena for the compiled expression.
+ * @return 0 if the set was defined, 1 if an error was printed.
+ */
+int define_set(registry *R, char *str, arena *scratch) {
+    exprProgram prog;
+    exprParser P;
+    token name;
+    set **inputs;
+    size_t i, count = 0;
+    char *definition;
+
+    initParser(&P, str, R, scratch, &prog, 0);
+    if(parseTarget(&P, &name)) return 1;
+
+    skipSpaces(&P);
+    definition = P.pos;
+    if(parseUnion(&P)) return 1;
+
+    if(findSet(R, name.ptr, name.len)) writeStr("Set name already in use\n");
+    else if(P.undefined) writeStr("Undefined set name\n");
+    else if(!checkEnd(&P)) {
+        /* The operands become the inputs of the set */
+        inputs = (set **)arenaAlloc(scratch, prog.len * sizeof(set *));
+        for(i = 0; i < prog.len; i++)
+            if(prog.steps[i].op == EXPR_SET) inputs[count++] = prog.steps[i].operand;
+
+        /* The definition ends where the trailing spaces begin */
+        for(P.pos = definition + strlen(definition); P.pos > definition && (P.pos[-1] == ' ' || P.pos[-1] == '\t'); P.pos--);
+        defineSet(R, name.ptr, name.len, definition, (size_t)(P.pos - definition), inputs, count);
+        return 0;
+    }
+    return 1;
+}
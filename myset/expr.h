@@ -0,0 +1,64 @@
+/**
+ * @file expr.h
+ * @brief Set expressions of the eval command.
+ *
+ * An expression combines named sets with the operators below, listed from
+ * the highest precedence to the lowest. Binary operators group to the left.
+ *   ~A           Complement of A within the universe
+ *   A & B, A - B Intersection and difference
+ *   A | B, A ^ B Union and symmetric difference
+ * Parentheses group subexpressions, e.g. `eval SETG = (SETA | SETB) & ~SETC`.
+ *
+ * The same expressions define derived sets, e.g. `define SETX = SETA & SETB`.
+ * A derived set is computed when it is first read and kept until one of its
+ * inputs changes.
+ */
+
+#ifndef EXPR_H
+#define EXPR_H
+
+#include "registry.h"
+#include "memory_utils.h"
+#include "string_utils.h"
+
+#define EXPR_MAX_NESTING 256 /**< Define the deepest nesting of parentheses and complements */
+
+/**
+ * @brief Evaluates an expression and stores the result in a set.
+ *
+ * The expression is compiled to postfix steps and evaluated in one fused pass
+ * over the words of its operands. Unlike the commands on three sets, the
+ * target may appear in the expression and is read with its current contents.
+ *
+ * @param R Registry of the named sets.
+ * @param str The rest of the command, "TARGET = expression".
+ * @param staging Set the result is computed in before it replaces the target.
+ * @param scratch Arena for the compiled expression.
+ * @return 0 if the target was replaced, 1 if an error was printed.
+ */
+int eval_set(registry *R, char *str, set *staging, arena *scratch);
+
+/**
+ * @brief Defines a derived set from an expression.
+ *
+ * The set is created stale and computed when a command first reads it.
+ *
+ * @param R Registry of the named sets.
+ * @param str The rest of the command, "NAME = expression".
+ * @param scratch Arena for the compiled expression.
+ * @return 0 if the set was defined, 1 if an error was printed.
+ */
+int define_set(registry *R, char *str, arena *scratch);
+
+/**
+ * @brief Computes a derived set again if one of its inputs changed.
+ *
+ * Nothing is done for a plain set or a derived set that is up to date.
+ *
+ * @param A Pointer to a set of the registry.
+ * @param R Registry of the named sets.
+ * @param scratch Arena for the compiled definition.
+ */
+void refreshSet(set *A, registry *R, arena *scratch);
+
+#endif /* EXPR_H */
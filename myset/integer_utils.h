@@ -1,39 +1,43 @@
-/**
- * @file integer_utils.h
- * @brief Utility functions for integer manipulation.
- *
- * This header file provides utility functions for working with integers,
- * including counting the number of digits in an integer and parsing an integer
- * from a string. It defines macros for maximum and minimum integer values.
- */
-
-#ifndef INTEGER_UTILS_H
-#define INTEGER_UTILS_H
-
-#define MAX_VALUE 127 /**< Maximum integer value in the set */
-#define MIN_VALUE 0 /**< Minimum integer value in the set */
-
-/**
- * @brief Counts the number of digits in an integer.
- *
- * This function counts the number of digits in an integer, including
- * negative numbers. It adds 1 to the number of digits for 0 or any negative integer.
- *
- * @param num The integer whose digits are to be counted.
- * @return The number of digits in the integer.
- */
-int countDigits(int num);
-
-/**
- * @brief Parses an integer from a string.
- *
- * This function parses an integer from a string. It handles negative
- * numbers and checks for invalid characters or out-of-range values.
- *
- * @param str The string containing the integer.
- * @return The parsed integer, -1 if the string represents "-1",
- *         -2 if the string is not a valid integer or is out of range.
- */
-int parseInt(char *str);
-
-#endif /* INTEGER_UTILS_H */
+/**
+ * @file integer_utils.h
+ * @brief Utility functions for integer manipulation.
+ *
+ * This header file provides utility functions for working with integers,
+ * including counting the number of digits in an integer and parsing an integer
+ * from a string. The range of valid integers is given by the universe of the set.
+ */
+
+#ifndef INTEGER_UTILS_H
+#define INTEGER_UTILS_H
+
+#include <stddef.h>
+
+#define END_DIGITS 2 /**< Number of characters in the "-1" list terminator */
+
+/**
+ * @brief Counts the number of digits in an integer.
+ *
+ * This function counts the number of decimal digits in a non-negative integer.
+ * 0 has one digit.
+ *
+ * @param num The integer whose digits are to be counted.
+ * @return The number of digits in the integer.
+ */
+int countDigits(unsigned long num);
+
+/**
+ * @brief Parses an integer from a string.
+ *
+ * This function parses an integer from a string. It handles negative
+ * numbers and checks for invalid characters or out-of-range values.
+ *
+ * @param str The characters of the integer, not necessarily null-terminated.
+ * @param len Number of characters.
+ * @param maxValue The largest valid integer.
+ * @param num Where the parsed integer is stored.
+ * @return 0 if an integer was parsed into num, -1 if the string represents "-1",
+ *         -2 if the string is not a valid integer or is out of range.
+ */
+int parseInt(const char *str, size_t len, unsigned long maxValue, unsigned long *num);
+
+#endif /* INTEGER_UTILS_H */
@@ -0,0 +1,136 @@
+/**
+ * @file memory_utils.c
+ * @brief Scratch memory for the commands and a counter of heap allocations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "memory_utils.h"
+
+/** Bytes reserved at the start of a block for the link to the previous block */
+#define LINK_SIZE ((sizeof(void *) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+
+static unsigned long allocations = 0; /**< Number of heap allocations when counting */
+
+#ifdef COUNT_ALLOCS
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+/**
+ * @brief Counting wrapper of malloc, linked in with --wrap=malloc.
+ */
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+/**
+ * @brief Counting wrapper of calloc, linked in with --wrap=calloc.
+ */
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+/**
+ * @brief Counting wrapper of realloc, linked in with --wrap=realloc.
+ */
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+#endif /* COUNT_ALLOCS */
+
+/**
+ * @brief Prints the number of heap allocations made so far to stderr.
+ */
+void reportAllocations(void) {
+    fprintf(stderr, "Heap allocations: %lu\n", allocations);
+}
+
+/**
+ * @brief Initializes an empty arena, no memory is allocated yet.
+ *
+ * @param A Pointer to the arena.
+ */
+void initArena(arena *A) {
+    A->base = NULL;
+    A->size = 0;
+    A->used = 0;
+    A->retired = NULL;
+}
+
+/**
+ * @brief Allocates memory from an arena.
+ *
+ * When the current block is full a larger one replaces it, and the old block
+ * is kept until the reset since earlier allocations still point into it.
+ *
+ * @param A Pointer to the arena.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the memory, valid until the arena is reset.
+ */
+void *arenaAlloc(arena *A, size_t size) {
+    size_t newSize;
+    char *block;
+    void *ptr;
+
+    /* Keep every allocation aligned */
+    size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+
+    if(!A->base || A->used + size > A->size) {
+        newSize = A->size ? A->size * 2 : ARENA_SIZE;
+        while(newSize < size) newSize *= 2;
+
+        block = (char *)malloc(LINK_SIZE + newSize);
+        if(!block) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        /* The block links to the retired ones before it */
+        if(A->base) {
+            *(void **)(A->base - LINK_SIZE) = A->retired;
+            A->retired = A->base - LINK_SIZE;
+        }
+        *(void **)block = NULL;
+        A->base = block + LINK_SIZE;
+        A->size = newSize;
+        A->used = 0;
+    }
+
+    ptr = A->base + A->used;
+    A->used += size;
+    return ptr;
+}
+
+/**
+ * @brief Releases every allocation of an arena, keeping its largest block.
+ *
+ * @param A Pointer to the arena.
+ */
+void resetArena(arena *A) {
+    void *next;
+
+    /* Blocks are only retired for larger ones, so the current one is the largest */
+    while(A->retired) {
+        next = *(void **)A->retired;
+        free(A->retired);
+        A->retired = next;
+    }
+    A->used = 0;
+}
+
+/**
+ * @brief Frees the memory held by an arena.
+ *
+ * @param A Pointer to the arena.
+ */
+void freeArena(arena *A) {
+    resetArena(A);
+    if(A->base) free(A->base - LINK_SIZE);
+    initArena(A);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file memory_utils.h
+ * @brief Scratch memory for the commands and a counter of heap allocations.
+ *
+ * A command takes its temporary memory from an arena that is reset once the
+ * command is done, so after the first few commands the arena is large enough
+ * and processing a command does not allocate.
+ */
+
+#ifndef MEMORY_UTILS_H
+#define MEMORY_UTILS_H
+
+#include <stddef.h>
+
+#define ARENA_SIZE 4096 /**< Define the initial size of an arena in bytes */
+#define ARENA_ALIGN 16  /**< Define the alignment of every arena allocation */
+
+/**
+ * @brief Structure representing an arena of scratch memory.
+ */
+typedef struct {
+    char *base;    /**< Current block the allocations are taken from */
+    size_t size;   /**< Size of the current block in bytes */
+    size_t used;   /**< Number of bytes allocated from the current block */
+    void *retired; /**< Earlier blocks still in use, freed on reset */
+} arena;
+
+/**
+ * @brief Initializes an empty arena, no memory is allocated yet.
+ *
+ * @param A Pointer to the arena.
+ */
+void initArena(arena *A);
+
+/**
+ * @brief Allocates memory from an arena.
+ *
+ * @param A Pointer to the arena.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the memory, valid until the arena is reset.
+ * @note The program exits if the arena cannot grow.
+ */
+void *arenaAlloc(arena *A, size_t size);
+
+/**
+ * @brief Releases every allocation of an arena, keeping its largest block.
+ *
+ * @param A Pointer to the arena.
+ */
+void resetArena(arena *A);
+
+/**
+ * @brief Frees the memory held by an arena.
+ *
+ * @param A Pointer to the arena.
+ */
+void freeArena(arena *A);
+
+/**
+ * @brief Prints the number of heap allocations made so far to stderr.
+ *
+ * Only counts when the program is built with `make allocs`, which routes
+ * malloc, calloc and realloc through counting wrappers.
+ */
+void reportAllocations(void);
+
+#endif /* MEMORY_UTILS_H */
@@ -6,9 +6,168 @@
  * Users can interact with the program through a command-line interface,
  * performing actions such as reading sets, performing union operations,
  * and more. The program prompts the user for commands and executes them accordingly.
+ *
+ * Usage: myset [-q] [-p] [-f file] [-l socket] [-r snapshot] [-w log] [-k auto|scalar|sse2|avx2|avx512] [-t threads] [-u universe] [-s bitmap|roaring]
+ *   -q  Quiet mode, prompts and command echoes are not printed.
+ *   -p  Times every command from the start, the stats command prints the latencies.
+ *   -f  Batch mode, the commands are read from the file without prompts.
+ *   -l  Server mode, clients connecting to the Unix domain socket share the sets.
+ *   -r  Starts with the sets of the snapshot file, as saved by the save command.
+ *   -w  Logs the commands that change the sets, and restores the sets from the log on startup.
+ *   -k  Forces the kernel backend used by the set operations.
+ *   -t  Number of threads sharing the operations on very large sets (default 1).
+ *   -u  Number of elements in the universe of the sets (default SET_SIZE, at most 2^32).
+ *   -s  Representation of the sets, roaring suits sparse sets over large universes.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include "program.h"
+#include "set_kernels.h"
+#include "string_utils.h"
+#include "output_utils.h"
+#include "memory_utils.h"
+#include "stats_utils.h"
+#include "worker_pool.h"
+#include "server.h"
+#include "snapshot.h"
+#include "command_log.h"
+
+/**
+ * @brief Prints the command line usage to stderr.
+ *
+ * @param name Name the program was invoked with.
+ */
+static void usage(char *name) {
+    fprintf(stderr, "Usage: %s [-q] [-p] [-f file] [-l socket] [-r snapshot] [-w log] [-k auto|scalar|sse2|avx2|avx512] [-t threads] [-u universe] [-s bitmap|roaring]\n", name);
+}
+
+/**
+ * @brief Parses the size of the universe of the sets.
+ *
+ * @param str String holding the number of elements in the universe.
+ * @param maxValue Where the largest element of the universe is stored.
+ * @return 0 if successful, 1 if the size is not between 1 and 2^32.
+ */
+static int parseUniverse(char *str, unsigned long *maxValue) {
+    unsigned long size;
+    char *end;
+
+    errno = 0;
+    size = strtoul(str, &end, 10);
+    if(errno || *end || end == str || *str == '-' || !size || size - 1 > MAX_SET_VALUE) {
+        fprintf(stderr, "Invalid universe size: %s\n", str);
+        return 1;
+    }
+
+    *maxValue = size - 1;
+    return 0;
+}
+
+/**
+ * @brief Parses the number of threads and starts the worker pool.
+ *
+ * @param str String holding the number of threads.
+ * @return 0 if successful, 1 if the number is not between 1 and WORKERS_MAX or the threads cannot start.
+ */
+static int parseThreads(char *str) {
+    unsigned long threads;
+    char *end;
+
+    errno = 0;
+    threads = strtoul(str, &end, 10);
+    if(errno || *end || end == str || *str == '-' || !threads || threads > WORKERS_MAX) {
+        fprintf(stderr, "Invalid number of threads: %s\n", str);
+        return 1;
+    }
+
+    if(startWorkers((int)threads)) {
+        fprintf(stderr, "Cannot start the worker threads\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses the command line options.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Array of command line arguments.
+ * @param maxValue Where the largest element of the universe is stored.
+ * @param kind Where the representation of the sets is stored.
+ * @param socketPath Where the path of the server socket is stored, left NULL without a server.
+ * @param snapshotPath Where the path of the snapshot to start with is stored, left NULL without one.
+ * @param logPath Where the path of the command log is stored, left NULL without a log.
+ * @return 0 if successful, 1 if an option is invalid.
+ */
+static int parseOptions(int argc, char *argv[], unsigned long *maxValue, SetKind *kind, const char **socketPath,
+                        const char **snapshotPath, const char **logPath) {
+    int i;
+
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-q")) {
+            setQuiet(1);
+            continue;
+        }
+        if(!strcmp(argv[i], "-p")) {
+            setStats(1);
+            continue;
+        }
+
+        /* The other options take exactly one value */
+        if(i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        if(!strcmp(argv[i], "-f")) {
+            if(openInput(argv[++i])) {
+                fprintf(stderr, "Cannot open command file: %s\n", argv[i]);
+                return 1;
+            }
+            setQuiet(1);
+        }
+        else if(!strcmp(argv[i], "-l")) {
+            *socketPath = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-r")) {
+            *snapshotPath = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-w")) {
+            *logPath = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-k")) {
+            if(selectKernels(parseKernelBackend(argv[++i]))) {
+                fprintf(stderr, "Kernel backend not supported: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(!strcmp(argv[i], "-t")) {
+            if(parseThreads(argv[++i]))
+                return 1;
+        }
+        else if(!strcmp(argv[i], "-u")) {
+            if(parseUniverse(argv[++i], maxValue))
+                return 1;
+        }
+        else if(!strcmp(argv[i], "-s")) {
+            i++;
+            if(!strcmp(argv[i], "bitmap")) *kind = SET_BITMAP;
+            else if(!strcmp(argv[i], "roaring")) *kind = SET_ROARING;
+            else {
+                fprintf(stderr, "Unknown set representation: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    return 0;
+}
 
 /**
  * @brief The main function of the simulation program.
@@ -17,13 +176,60 @@
  * such as reading a set, performing union operations, and more.
  * It prompts the user for commands and executes them accordingly.
  *
- * @return 0 on successful execution.
+ * @param argc Number of command line arguments.
+ * @param argv Array of command line arguments.
+ * @return 0 on successful execution, 1 if the command line is invalid, the snapshot or the log cannot be loaded or the server cannot start.
  */
-int main() {
-    set SETA, SETB, SETC, SETD, SETE, SETF;
+int main(int argc, char *argv[]) {
+    static const char *names[SET_COUNT] = { "SETA", "SETB", "SETC", "SETD", "SETE", "SETF" };
+    unsigned long maxValue = SET_SIZE - 1;
+    SetKind kind = SET_BITMAP;
+    const char *socketPath = NULL, *snapshotPath = NULL, *logPath = NULL;
+    SnapshotStatus snap;
+    registry sets;
+    int i, status = 0;
 
-    /* Initializing sets and booting the simulation */
-    boot_program(&SETA, &SETB, &SETC, &SETD, &SETE, &SETF);
+    if(parseOptions(argc, argv, &maxValue, &kind, &socketPath, &snapshotPath, &logPath)) {
+        stopWorkers();
+        return EXIT_FAILURE;
+    }
 
-    return 0;
-}
\ No newline at end of file
+    /* Buffered output is written out however the program ends */
+    atexit(flushOutput);
+#ifdef COUNT_ALLOCS
+    atexit(reportAllocations);
+#endif
+
+    /* Creating the initial sets over the chosen universe */
+    initRegistry(&sets, maxValue, kind);
+    for(i = 0; i < SET_COUNT; i++)
+        createSet(&sets, names[i], strlen(names[i]));
+
+    /* The log restores the sets it holds, then a snapshot replaces them and the log starts over from it.
+     * Their universe and representation win over the options */
+    if(logPath && openLog(&sets, logPath)) status = EXIT_FAILURE;
+    else if(snapshotPath && (snap = loadSnapshot(&sets, snapshotPath, NULL)) != SNAPSHOT_OK) {
+        fprintf(stderr, "%s: %s\n", snapshotMessage(snap), snapshotPath);
+        status = EXIT_FAILURE;
+    }
+    else if(snapshotPath && compactLog(&sets)) status = EXIT_FAILURE;
+
+    if(status) {
+        closeLog();
+        stopWorkers();
+        freeRegistry(&sets);
+        return status;
+    }
+
+    /* Booting the simulation, or serving it to the clients of the socket */
+    if(socketPath) status = serve(&sets, socketPath) ? EXIT_FAILURE : 0;
+    else boot_program(&sets);
+
+    /* Sync the log, stop the worker threads and free the sets and the input buffer */
+    closeLog();
+    stopWorkers();
+    freeRegistry(&sets);
+    closeInput();
+
+    return status;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file output_utils.c
+ * @brief Buffered writer for the standard output.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "output_utils.h"
+
+static outputStream standard = { STDOUT_FILENO, 0, 0, { 0 } }; /**< Stream of the threads without their own */
+static pthread_key_t streamKey;                                /**< Stream bound by the calling thread */
+static pthread_once_t streamOnce = PTHREAD_ONCE_INIT;          /**< Creates streamKey once */
+static int streamsBound = 0;                                   /**< 1 once a thread bound its own stream */
+static int quietMode = 0;                                      /**< 1 if prompts and command echoes are suppressed */
+
+/** Pairs of digits for every number from 00 to 99 */
+static const char digitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/**
+ * @brief Creates the key of the streams bound by the threads.
+ */
+static void createStreamKey(void) {
+    pthread_key_create(&streamKey, NULL);
+    streamsBound = 1;
+}
+
+/**
+ * @brief Finds the stream of the calling thread.
+ *
+ * @return Pointer to the stream bound by the thread, or to the standard output.
+ */
+static outputStream *currentStream(void) {
+    outputStream *out;
+
+    /* Without a server no thread binds a stream, so the key is not even read */
+    if(!streamsBound) return &standard;
+    out = (outputStream *)pthread_getspecific(streamKey);
+    return out ? out : &standard;
+}
+
+/**
+ * @brief Directs the output of the calling thread to a stream.
+ *
+ * A failed write to the standard output ends the program, while a failed
+ * write to a bound stream only drops the rest of its output.
+ *
+ * @param out Pointer to the stream, or NULL to write to the standard output again.
+ * @param fd Descriptor the stream writes to.
+ */
+void bindOutput(outputStream *out, int fd) {
+    pthread_once(&streamOnce, createStreamKey);
+
+    if(out) {
+        out->fd = fd;
+        out->failed = 0;
+        out->used = 0;
+    }
+    pthread_setspecific(streamKey, out);
+}
+
+/**
+ * @brief Writes bytes to the descriptor of a stream, retrying partial and interrupted writes.
+ *
+ * @param out Pointer to the stream.
+ * @param str The bytes to write.
+ * @param len Number of bytes.
+ */
+static void writeAll(outputStream *out, const char *str, size_t len) {
+    ssize_t n;
+
+    while(len && !out->failed) {
+        n = write(out->fd, str, len);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            if(out != &standard) {
+                /* The client went away, its session ends at its next read */
+                out->failed = 1;
+                return;
+            }
+            fprintf(stderr, "Write to standard output failed\n");
+            exit(EXIT_FAILURE);
+        }
+        str += n;
+        len -= (size_t)n;
+    }
+}
+
+/**
+ * @brief Writes the content of the output buffer to its descriptor.
+ */
+void flushOutput(void) {
+    outputStream *out = currentStream();
+
+    writeAll(out, out->buffer, out->used);
+    out->used = 0;
+}
+
+/**
+ * @brief Appends characters to the output buffer.
+ *
+ * @param str The characters to write.
+ * @param len Number of characters.
+ */
+void writeChars(const char *str, size_t len) {
+    outputStream *out = currentStream();
+
+    if(out->used + len > OUTPUT_SIZE) {
+        flushOutput();
+
+        /* Larger than the whole buffer, write it directly */
+        if(len > OUTPUT_SIZE) {
+            writeAll(out, str, len);
+            return;
+        }
+    }
+    memcpy(out->buffer + out->used, str, len);
+    out->used += len;
+}
+
+/**
+ * @brief Appends a string to the output buffer.
+ *
+ * @param str The null-terminated string to write.
+ */
+void writeStr(const char *str) {
+    writeChars(str, strlen(str));
+}
+
+/**
+ * @brief Appends a character to the output buffer.
+ *
+ * @param c The character to write.
+ */
+void writeChar(char c) {
+    outputStream *out = currentStream();
+
+    if(out->used == OUTPUT_SIZE) flushOutput();
+    out->buffer[out->used++] = c;
+}
+
+/**
+ * @brief Appends the decimal representation of a number to the output buffer.
+ *
+ * @param num The number to write.
+ */
+void writeNum(unsigned long num) {
+    char digits[3 * sizeof(unsigned long)];
+    size_t i = sizeof(digits), pair;
+
+    /* Convert two digits at a time from the lowest ones */
+    while(num >= 100) {
+        pair = (size_t)(num % 100) * 2;
+        num /= 100;
+        digits[--i] = digitPairs[pair + 1];
+        digits[--i] = digitPairs[pair];
+    }
+    if(num >= 10) {
+        digits[--i] = digitPairs[num * 2 + 1];
+        digits[--i] = digitPairs[num * 2];
+    }
+    else digits[--i] = (char)('0' + num);
+
+    writeChars(digits + i, sizeof(digits) - i);
+}
+
+/**
+ * @brief Turns the quiet mode on or off.
+ *
+ * @param quiet 1 to suppress prompts and command echoes, 0 to show them.
+ */
+void setQuiet(int quiet) {
+    quietMode = quiet;
+}
+
+/**
+ * @brief Checks whether the quiet mode is on.
+ *
+ * @return 1 if prompts and command echoes are suppressed, 0 otherwise.
+ */
+int isQuiet(void) {
+    return quietMode;
+}
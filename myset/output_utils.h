@@ -0,0 +1,87 @@
+/**
+ * @file output_utils.h
+ * @brief Buffered writer for the standard output.
+ *
+ * All output of the program goes through a single reusable buffer that is
+ * written to the standard output with large write() calls, instead of one
+ * stdio call per message or number. A thread can bind its own stream, so
+ * that each client of the server writes its replies to its own socket.
+ */
+
+#ifndef OUTPUT_UTILS_H
+#define OUTPUT_UTILS_H
+
+#include <stddef.h>
+
+#define OUTPUT_SIZE 65536 /**< Define the size of the output buffer in bytes */
+
+/**
+ * @brief Structure representing a buffered output stream.
+ */
+typedef struct {
+    int fd;                   /**< Descriptor the output is written to */
+    int failed;               /**< 1 once a write failed, the rest of the output is dropped */
+    size_t used;              /**< Number of bytes used in the buffer */
+    char buffer[OUTPUT_SIZE]; /**< Output waiting to be written */
+} outputStream;
+
+/**
+ * @brief Directs the output of the calling thread to a stream.
+ *
+ * A failed write to the standard output ends the program, while a failed
+ * write to a bound stream only drops the rest of its output.
+ *
+ * @param out Pointer to the stream, or NULL to write to the standard output again.
+ * @param fd Descriptor the stream writes to.
+ */
+void bindOutput(outputStream *out, int fd);
+
+/**
+ * @brief Appends characters to the output buffer.
+ *
+ * @param str The characters to write.
+ * @param len Number of characters.
+ */
+void writeChars(const char *str, size_t len);
+
+/**
+ * @brief Appends a string to the output buffer.
+ *
+ * @param str The null-terminated string to write.
+ */
+void writeStr(const char *str);
+
+/**
+ * @brief Appends a character to the output buffer.
+ *
+ * @param c The character to write.
+ */
+void writeChar(char c);
+
+/**
+ * @brief Appends the decimal representation of a number to the output buffer.
+ *
+ * @param num The number to write.
+ */
+void writeNum(unsigned long num);
+
+/**
+ * @brief Writes the content of the output buffer to its descriptor.
+ */
+void flushOutput(void);
+
+/**
+ * @brief Turns the quiet mode on or off.
+ *
+ * @param quiet 1 to suppress prompts and command echoes, 0 to show them.
+ */
+void setQuiet(int quiet);
+
+/**
+ * @brief Checks whether the quiet mode is on.
+ *
+ * @return 1 if prompts and command echoes are suppressed, 0 otherwise.
+ */
+int isQuiet(void);
+
+#endif /* OUTPUT_UTILS_H */
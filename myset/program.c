@@ -1,137 +1,377 @@
-/**
- * @file program.c
- * @brief Program to perform various set operations based on user commands.
- *
- * This program allows the user to perform operations such as reading, printing,
- * union, intersection, subtraction, and symmetric difference on sets. The user
- * inputs commands, and the program parses and executes these commands accordingly.
- * The program continues to run until the STOP command is received.
- *
- * @note The sets are represented using an array of unsigned chars where each bit corresponds
- * to an element in the set.
- */
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "set_utils.h"
-#include "error_utils.h"
-#include "string_utils.h"
-
-/**
- * @brief Parses the input command and executes the corresponding set operation.
- *
- * @param setArr Array of set pointers that represent the available sets.
- * @return Returns 1 if the STOP command is received, otherwise returns 0.
- * @note This function handles memory allocation and deallocation for command parsing.
- */
-int parseInput(set *setArr[]) {
-    char *ptrArr[5], *command, *str, *ptr;
-    set *S1, *S2, *S3;
-
-    /* Prompt the user to enter a command */
-    command = read_line("Please enter a command:\n");
-    if(!command) return 1;
-    printf("Command received:\n%s\n", command);
-
-    /* Allocate memory for the command tokens */
-    allocPtrArray(ptrArr, 5, strlen(command) + 1);
-    ptr = command;
-
-    /* Extract the first and second tokens (operation and set name) */
-    if(firstToken(&ptr, ptrArr[0]) || nextToken(&ptr, ptrArr[1])) {
-        freePtrArray(ptrArr, 5);
-        free(command);
-        return 0;
-    }
-    str = ptr;
-
-    /* Extract the remaining tokens (can be sets names, 'numbers' or NULL) */
-    if(nextToken(&ptr, ptrArr[2]) || nextToken(&ptr, ptrArr[3]) || nextToken(&ptr, ptrArr[4])) {
-        freePtrArray(ptrArr, 5);
-        free(command);
-        return 0;
-    }
-
-    /* Parse the sets from the tokens.
-     * if a set does not exist, then it parsed as NULL */
-    S1 = parseSet(ptrArr[1], setArr);
-    S2 = parseSet(ptrArr[2], setArr);
-    S3 = parseSet(ptrArr[3], setArr);
-
-    /* Execute the command based on the parsed tokens */
-    switch(parseCommand(ptrArr[0])) {
-        case STOP:
-            /* Free the memory */
-            freePtrArray(ptrArr, 5);
-            free(command);
-            return 1;
-
-        case READ:
-            if(!prompt_err(READ, ptrArr, S1, S2, S3))
-                /* ptrArr[0] is used as a temporary buffer */
-                fillSet(S1, &str, ptrArr[0], strlen(command));
-            break;
-
-        case PRINT:
-            if(!prompt_err(PRINT, ptrArr, S1, S2, S3))
-                print_set(S1);
-            break;
-
-        case UNION:
-            if(!prompt_err(UNION, ptrArr, S1, S2, S3))
-                union_set(S1, S2, S3);
-            break;
-
-        case INTERSECT:
-            if(!prompt_err(INTERSECT, ptrArr, S1, S2, S3))
-                intersect_set(S1, S2, S3);
-            break;
-
-        case SUB:
-            if(!prompt_err(SUB, ptrArr, S1, S2, S3))
-                sub_set(S1, S2, S3);
-            break;
-
-        case SYMDIFF:
-            if(!prompt_err(SYMDIFF, ptrArr, S1, S2, S3))
-                symdiff_set(S1, S2, S3);
-            break;
-
-        default:
-            break;
-    }
-
-    /* Free the memory */
-    freePtrArray(ptrArr, 5);
-    free(command);
-    return 0;
-}
-
-/**
- * @brief Initializes the sets and starts the program loop to process commands.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the third set.
- * @param D Pointer to the fourth set.
- * @param E Pointer to the fifth set.
- * @param F Pointer to the sixth set.
- * @note This function runs an infinite loop until the STOP command is received.
- */
-void boot_program(set *A, set *B, set *C, set *D, set *E, set *F) {
-    /* Initialize the set array with the provided set pointers */
-    set *setArr[SET_COUNT];
-    setArr[0] = A;
-    setArr[1] = B;
-    setArr[2] = C;
-    setArr[3] = D;
-    setArr[4] = E;
-    setArr[5] = F;
-
-    /* Clear all sets in the array */
-    emptySetArray(setArr, SET_COUNT);
-
-    /* Continue parsing input until the STOP command is received */
-    while(!parseInput(setArr));
-}
\ No newline at end of file
+/**
+ * @file program.c
+ * @brief Program to perform various set operations based on user commands.
+ *
+ * This program allows the user to perform operations such as reading, printing,
+ * union, intersection, subtraction, and symmetric difference on sets, to combine
+ * any number of sets at once, to query their size, the rank of a number and the
+ * k-th smallest element, to create and drop named sets, to evaluate set expressions,
+ * to define derived sets, to time the commands, to save and load snapshots of the
+ * sets and to log the commands that change them. The user inputs commands, as text
+ * lines or as binary commands, and the program parses and executes these commands
+ * accordingly.
+ * The program continues to run until the STOP command is received.
+ *
+ * @note The sets are represented using an array of words where each bit corresponds
+ * to an element in the set.
+ */
+
+#include <string.h>
+#include "set_utils.h"
+#include "error_utils.h"
+#include "string_utils.h"
+#include "output_utils.h"
+#include "memory_utils.h"
+#include "stats_utils.h"
+#include "expr.h"
+#include "snapshot.h"
+#include "command_log.h"
+
+/**
+ * @brief Structure representing the state of a command session.
+ */
+typedef struct {
+    arena scratch;        /**< Temporary memory of a command, reset after it */
+    set staging;          /**< Set a read_set list is collected in before it is committed */
+    Operation opr;        /**< Operation of the current command */
+    unsigned long logged; /**< End of the log record of the current command, 0 if it logged none */
+} session;
+
+/**
+ * @brief Parses the sets of a union_all or intersect_all command and executes it.
+ *
+ * @param R Registry of the named sets.
+ * @param ses State of the session.
+ * @param opr UNION_ALL or INTERSECT_ALL.
+ * @param str The rest of the command, "TARGET, SET1, SET2, ...".
+ */
+static void combine_all(registry *R, session *ses, Operation opr, char *str) {
+    set **inputs, *target;
+    token *names, tok;
+    int len = 0, count = 0;
+
+    /* Each set name takes at least one character and a comma, the names are kept for the log */
+    inputs = (set **)arenaAlloc(&ses->scratch, (strlen(str) / 2 + 1) * sizeof(set *));
+    names = (token *)arenaAlloc(&ses->scratch, (strlen(str) / 2 + 2) * sizeof(token));
+
+    /* Extract the target and then every set name */
+    if(nextToken(&str, &names[0]) || nextToken(&str, &tok))
+        return;
+    while(tok.len) {
+        if((inputs[len] = parseSet(tok, R)) != NULL) len++;
+        names[++count] = tok;
+        if(nextToken(&str, &tok))
+            return;
+    }
+    target = parseSet(names[0], R);
+
+    if(!names[0].len || !count) writeStr("Missing parameter\n");
+    else if(!target || len < count) writeStr("Undefined set name\n");
+    else if(isDerived(target)) writeStr("Derived sets cannot be modified\n");
+    else {
+        /* Derived sets are computed again before they are read, if their inputs changed */
+        for(count = 0; count < len; count++)
+            refreshSet(inputs[count], R, &ses->scratch);
+
+        if(opr == UNION_ALL) union_all(inputs, len, target);
+        else intersect_all(inputs, len, target);
+        markModified(target);
+        ses->logged = logNames(opr, names, (size_t)count + 1);
+    }
+}
+
+/**
+ * @brief Enumeration representing the outcome of running a command.
+ */
+typedef enum {
+    COMMAND_DONE,     /**< The command ran, or was rejected with an error */
+    COMMAND_STOP,     /**< The STOP command was received */
+    COMMAND_EXCLUSIVE /**< The command must run again with the registry to itself */
+} CommandStatus;
+
+/**
+ * @brief Parses a command and executes the corresponding set operation.
+ *
+ * Without the registry to itself, a command that changes the registry or
+ * reads a stale derived set gives up before printing anything, and the
+ * other commands lock the sets they use.
+ *
+ * @param R Registry of the named sets.
+ * @param ses State of the session.
+ * @param command The command line or binary command.
+ * @param mark Start time of the current phase of the command.
+ * @param exclusive 1 if no other command runs on the registry, 0 if it is locked shared.
+ * @return The outcome of the command.
+ * @note The tokens are views into the command line, so parsing does not allocate.
+ */
+static CommandStatus runCommand(registry *R, session *ses, char *command, unsigned long *mark, int exclusive) {
+    char *str, *ptr = command;
+    token tokens[5];
+    set *S1, *S2, *S3, *used[3], *target = NULL;
+    unsigned long num = 0;
+    SnapshotStatus snap;
+    Operation opr;
+    char *path;
+    int failed, frame = (unsigned char)*command == FRAME_MAGIC;
+
+    /* A binary command holds its tokens ready, the elements in place of the parameters */
+    if(frame) {
+        if(frameTokens(command, tokens)) return COMMAND_DONE;
+    }
+    /* Extract the first token (operation) */
+    else if(firstToken(&ptr, &tokens[0]))
+        return COMMAND_DONE;
+
+    /* An expression is not a comma separated list, it has its own parser,
+     * and the multi-way operations take any number of sets */
+    opr = findCommand(tokens[0]);
+    ses->opr = opr;
+    if(opr == EVAL || opr == DEFINE || opr == UNION_ALL || opr == INTERSECT_ALL) {
+        /* They compute derived sets and may change the registry */
+        if(!exclusive) return COMMAND_EXCLUSIVE;
+
+        recordPhase(opr, PHASE_PARSE, mark);
+        if(opr == EVAL) {
+            if(!eval_set(R, ptr, &ses->staging, &ses->scratch)) ses->logged = logText(opr, ptr);
+        }
+        else if(opr == DEFINE) {
+            if(!define_set(R, ptr, &ses->scratch)) ses->logged = logText(opr, ptr);
+        }
+        else combine_all(R, ses, opr, ptr);
+        recordPhase(opr, PHASE_EXECUTE, mark);
+        return COMMAND_DONE;
+    }
+
+    if(!frame) {
+        /* Extract the second token (set name) */
+        failed = nextToken(&ptr, &tokens[1]);
+        str = ptr;
+
+        /* Extract the remaining tokens (can be sets names, 'numbers' or empty) */
+        if(failed || nextToken(&ptr, &tokens[2]) || nextToken(&ptr, &tokens[3]) || nextToken(&ptr, &tokens[4])) {
+            recordPhase(opr, PHASE_PARSE, mark);
+            return COMMAND_DONE;
+        }
+    }
+
+    /* Parse the sets from the tokens.
+     * if a set does not exist, then it parsed as NULL */
+    S1 = parseSet(tokens[1], R);
+    S2 = parseSet(tokens[2], R);
+    S3 = parseSet(tokens[3], R);
+    used[0] = S1;
+    used[1] = S2;
+    used[2] = S3;
+
+    /* Creating and dropping sets change the registry, snapshots read or replace every set,
+     * and stale derived sets are computed again */
+    if(!exclusive && (opr == CREATE || opr == DROP || opr == SAVE || opr == LOAD ||
+                      (S1 && needsRefresh(S1)) || (S2 && needsRefresh(S2))))
+        return COMMAND_EXCLUSIVE;
+
+    opr = parseCommand(tokens[0]);
+    recordPhase(opr, PHASE_PARSE, mark);
+    if(opr == STOP) return COMMAND_STOP;
+    if(opr == NONE_OPERATION) return COMMAND_DONE;
+
+    /* Validate the parameters of the command */
+    failed = prompt_err(opr, tokens, S1, S2, S3);
+    if(!failed && (opr == RANK || opr == SELECT)) {
+        num = opr == RANK ? getMaxValue(S1) : MAX_SET_VALUE;
+        failed = frame ? parsePacked(tokens[2], num, &num) : parseNumber(tokens[2], num, &num);
+    }
+    recordPhase(opr, PHASE_VALIDATE, mark);
+    if(failed) return COMMAND_DONE;
+
+    if(exclusive) {
+        /* Derived sets are computed again before they are read, if their inputs changed */
+        if(S1) refreshSet(S1, R, &ses->scratch);
+        if(S2) refreshSet(S2, R, &ses->scratch);
+    }
+    else if(opr != READ) {
+        /* The set written by the command is locked exclusive, and so is a set whose counts are built */
+        if(opr == UNION || opr == INTERSECT || opr == SUB || opr == SYMDIFF) target = S3;
+
+        lockSets(R, used, 3, target);
+        if((opr == SIZE || opr == RANK || opr == SELECT) && !countsReady(S1)) {
+            unlockSets(R, used, 3);
+            lockSets(R, used, 3, S1);
+        }
+    }
+
+    /* Execute the command based on the parsed tokens */
+    switch(opr) {
+        case READ:
+            /* The list is parsed with the set locked shared, readers of the set only wait for the swap */
+            if(!exclusive) lockSets(R, &S1, 1, NULL);
+            failed = frame ? !fillPacked(S1, tokens[2], &ses->staging) : !fillSet(S1, &str, &ses->staging);
+            if(!exclusive) unlockSets(R, &S1, 1);
+
+            if(!failed) {
+                if(!exclusive) lockSets(R, &S1, 1, S1);
+                swapSets(S1, &ses->staging);
+                markModified(S1);
+                ses->logged = logRead(tokens[1], S1);
+                if(!exclusive) unlockSets(R, &S1, 1);
+            }
+            break;
+
+        case PRINT:
+            print_set(S1);
+            break;
+
+        case UNION:
+            union_set(S1, S2, S3);
+            markModified(S3);
+            ses->logged = logNames(opr, tokens + 1, 3);
+            break;
+
+        case INTERSECT:
+            intersect_set(S1, S2, S3);
+            markModified(S3);
+            ses->logged = logNames(opr, tokens + 1, 3);
+            break;
+
+        case SUB:
+            sub_set(S1, S2, S3);
+            markModified(S3);
+            ses->logged = logNames(opr, tokens + 1, 3);
+            break;
+
+        case SYMDIFF:
+            symdiff_set(S1, S2, S3);
+            markModified(S3);
+            ses->logged = logNames(opr, tokens + 1, 3);
+            break;
+
+        case SIZE:
+            size_set(S1);
+            break;
+
+        case RANK:
+            rank_set(S1, num);
+            break;
+
+        case SELECT:
+            select_set(S1, num);
+            break;
+
+        case CREATE:
+            createSet(R, tokens[1].ptr, tokens[1].len);
+            ses->logged = logNames(opr, tokens + 1, 1);
+            break;
+
+        case DROP:
+            dropSet(R, tokens[1].ptr, tokens[1].len);
+            ses->logged = logNames(opr, tokens + 1, 1);
+            break;
+
+        case STATS:
+            if(!tokens[1].len) print_stats();
+            else if(tokenEquals(tokens[1], "reset")) resetStats();
+            else setStats(tokenEquals(tokens[1], "on"));
+            break;
+
+        case SAVE:
+        case LOAD:
+            /* The path is a view into the command line, the file functions need it terminated */
+            path = (char *)arenaAlloc(&ses->scratch, tokens[1].len + 1);
+            memcpy(path, tokens[1].ptr, tokens[1].len);
+            path[tokens[1].len] = '\0';
+
+            snap = opr == SAVE ? saveSnapshot(R, path, 0) : loadSnapshot(R, path, NULL);
+            if(snap != SNAPSHOT_OK) {
+                writeStr(snapshotMessage(snap));
+                writeStr("\n");
+            }
+
+            /* The log cannot replay a load, it starts over from the loaded sets */
+            else if(opr == LOAD) compactLog(R);
+            break;
+
+        default:
+            break;
+    }
+
+    if(!exclusive && opr != READ) unlockSets(R, used, 3);
+
+    recordPhase(opr, PHASE_EXECUTE, mark);
+    return COMMAND_DONE;
+}
+
+/**
+ * @brief Reads the next command and executes the corresponding set operation.
+ *
+ * A command first runs with the registry locked shared, so that commands on
+ * the sets run in parallel, and runs again with the registry to itself if it
+ * needs it.
+ *
+ * @param R Registry of the named sets.
+ * @param ses State of the session.
+ * @return Returns 1 if the STOP command is received, otherwise returns 0.
+ */
+int parseInput(registry *R, session *ses) {
+    char *command;
+    unsigned long mark;
+    CommandStatus status;
+
+    /* Prompt the user to enter a command, unless running quietly */
+    command = read_line(isQuiet() ? "" : "Please enter a command:\n");
+    if(!command) return 1;
+    if(!isQuiet() && (unsigned char)*command != FRAME_MAGIC) {
+        writeStr("Command received:\n");
+        writeStr(command);
+        writeChar('\n');
+    }
+
+    /* The time spent waiting for the command is not counted */
+    mark = startStats();
+    ses->logged = 0;
+
+    /* A registry used by a single thread is always its own */
+    lockRegistry(R, 0);
+    status = runCommand(R, ses, command, &mark, !isShared(R));
+    unlockRegistry(R);
+
+    if(status == COMMAND_EXCLUSIVE) {
+        lockRegistry(R, 1);
+        status = runCommand(R, ses, command, &mark, 1);
+        unlockRegistry(R);
+    }
+
+    /* The reply is read once the command is on disk, the commands of a file are synced together */
+    if(ses->logged && isInteractive()) {
+        commitLog(ses->logged);
+        recordPhase(ses->opr, PHASE_COMMIT, &mark);
+    }
+
+    /* Compacting the log needs the registry to itself, the sets are saved as they are */
+    if(needsCompaction()) {
+        lockRegistry(R, 1);
+        if(needsCompaction()) compactLog(R);
+        unlockRegistry(R);
+    }
+    return status == COMMAND_STOP;
+}
+
+/**
+ * @brief Starts the program loop to process commands on the named sets.
+ *
+ * @param R Registry of the named sets.
+ * @note This function runs an infinite loop until the STOP command is received.
+ */
+void boot_program(registry *R) {
+    session ses;
+
+    /* The staging set starts out like new sets, fillSet adapts it otherwise */
+    initArena(&ses.scratch);
+    initSet(&ses.staging, R->maxValue, R->kind);
+
+    /* Continue parsing input until the STOP command is received,
+     * the scratch memory of a command is released after it */
+    while(!parseInput(R, &ses))
+        resetArena(&ses.scratch);
+
+    freeArena(&ses.scratch);
+    freeSet(&ses.staging);
+}
@@ -1,26 +1,21 @@
-/**
- * @file program.h
- * @brief Header file for the program to perform various set operations based on user commands.
- *
- * This header file declares the function `boot_program`, which initializes the sets
- * and starts the program loop to process commands.
- */
-
-#ifndef PROGRAM_H
-#define PROGRAM_H
-
-#include "set.h"
-
-/**
- * @brief Initializes the sets and starts the program loop to process commands.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the third set.
- * @param D Pointer to the fourth set.
- * @param E Pointer to the fifth set.
- * @param F Pointer to the sixth set.
- */
-void boot_program(set *A, set *B, set *C, set *D, set *E, set *F);
-
-#endif /* PROGRAM_H */
+/**
+ * @file program.h
+ * @brief Header file for the program to perform various set operations based on user commands.
+ *
+ * This header file declares the function `boot_program`, which starts the program
+ * loop to process commands.
+ */
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include "registry.h"
+
+/**
+ * @brief Starts the program loop to process commands on the named sets.
+ *
+ * @param R Registry of the named sets.
+ */
+void boot_program(registry *R);
+
+#endif /* PROGRAM_H */
@@ -0,0 +1,509 @@
+/**
+ * @file registry.c
+ * @brief Registry of the named sets of a session.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "registry.h"
+#include "string_utils.h"
+
+static pthread_mutex_t staleLock = PTHREAD_MUTEX_INITIALIZER; /**< Guards the stale flags of the derived sets */
+
+/**
+ * @brief Allocates memory or exits the program.
+ *
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the memory.
+ */
+static void *allocOrExit(size_t size) {
+    void *ptr = malloc(size);
+
+    if(!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Frees a set of the registry and detaches it from its inputs.
+ *
+ * @param node Pointer to the set.
+ */
+static void freeNamedSet(namedSet *node) {
+    size_t i, j;
+    namedSet *in;
+
+    for(i = 0; i < node->inputCount; i++) {
+        in = node->inputs[i];
+        for(j = 0; j < in->dependentCount && in->dependents[j] != node; j++);
+        if(j < in->dependentCount) in->dependents[j] = in->dependents[--in->dependentCount];
+    }
+    freeSet(&node->value);
+    pthread_rwlock_destroy(&node->lock);
+    free(node->definition);
+    free(node->inputs);
+    free(node->dependents);
+    free(node);
+}
+
+/**
+ * @brief Finds the slot of a name, or the empty slot where it would be inserted.
+ *
+ * @param R Pointer to the registry.
+ * @param name Characters of the name.
+ * @param len Number of characters in the name.
+ * @param hash Hash of the name.
+ * @return Index of the slot.
+ */
+static size_t findSlot(registry *R, const char *name, size_t len, unsigned long hash) {
+    size_t mask = R->capacity - 1, i = (size_t)hash & mask;
+    registryEntry *slot;
+
+    for(;; i = (i + 1) & mask) {
+        slot = &R->slots[i];
+        if(!slot->name) return i;
+        if(slot->hash == hash && slot->len == len && !memcmp(slot->name, name, len)) return i;
+    }
+}
+
+/**
+ * @brief Allocates an empty table of slots.
+ *
+ * @param R Pointer to the registry.
+ * @param capacity Number of slots, a power of 2.
+ */
+static void allocSlots(registry *R, size_t capacity) {
+    R->slots = (registryEntry *)allocOrExit(capacity * sizeof(registryEntry));
+    memset(R->slots, 0, capacity * sizeof(registryEntry));
+    R->capacity = capacity;
+}
+
+/**
+ * @brief Doubles the number of slots and moves every set to its new slot.
+ *
+ * @param R Pointer to the registry.
+ */
+static void growRegistry(registry *R) {
+    registryEntry *old = R->slots;
+    size_t i, oldCapacity = R->capacity;
+
+    allocSlots(R, oldCapacity * 2);
+    for(i = 0; i < oldCapacity; i++)
+        if(old[i].name)
+            R->slots[findSlot(R, old[i].name, old[i].len, old[i].hash)] = old[i];
+    free(old);
+}
+
+/**
+ * @brief Initializes an empty registry.
+ *
+ * @param R Pointer to the registry.
+ * @param maxValue Largest element of the universe of the sets created in it.
+ * @param kind Representation of the sets created in it.
+ */
+void initRegistry(registry *R, unsigned long maxValue, SetKind kind) {
+    allocSlots(R, REGISTRY_SIZE);
+    R->count = 0;
+    R->maxValue = maxValue;
+    R->kind = kind;
+    R->shared = 0;
+    R->files = NULL;
+    pthread_rwlock_init(&R->lock, NULL);
+}
+
+/**
+ * @brief Frees every set of a registry and its table.
+ *
+ * @param R Pointer to the registry.
+ */
+static void freeSets(registry *R) {
+    size_t i;
+
+    /* Only dependency lists of sets still in the registry are updated */
+    for(i = 0; i < R->capacity; i++)
+        if(R->slots[i].name) R->slots[i].value->inputCount = 0;
+
+    for(i = 0; i < R->capacity; i++) {
+        if(!R->slots[i].name) continue;
+        freeNamedSet(R->slots[i].value);
+        free(R->slots[i].name);
+    }
+    free(R->slots);
+    R->slots = NULL;
+    R->capacity = R->count = 0;
+}
+
+/**
+ * @brief Frees a registry and every set in it.
+ *
+ * @param R Pointer to the registry.
+ */
+void freeRegistry(registry *R) {
+    mappedFile *file;
+
+    freeSets(R);
+    while((file = R->files) != NULL) {
+        R->files = file->next;
+        munmap(file->addr, file->size);
+        free(file);
+    }
+    pthread_rwlock_destroy(&R->lock);
+}
+
+/**
+ * @brief Replaces every set of a registry with the sets of another one.
+ *
+ * The sets of R are freed and the sets, universe, representation and
+ * mappings of from are moved to R, whose locks are kept. The registry from
+ * is left empty and freed.
+ *
+ * @param R Pointer to the registry to fill.
+ * @param from Pointer to the registry holding the new sets.
+ */
+void replaceRegistry(registry *R, registry *from) {
+    mappedFile **last;
+
+    freeSets(R);
+    R->slots = from->slots;
+    R->capacity = from->capacity;
+    R->count = from->count;
+    R->maxValue = from->maxValue;
+    R->kind = from->kind;
+
+    /* The older mappings stay, sets of the sessions may still use them */
+    for(last = &R->files; *last; last = &(*last)->next);
+    *last = from->files;
+
+    from->slots = NULL;
+    from->capacity = from->count = 0;
+    from->files = NULL;
+    freeRegistry(from);
+}
+
+/**
+ * @brief Keeps a mapped snapshot until the registry is freed.
+ *
+ * Sets may keep using the words of a snapshot after they are replaced, for
+ * instance through the staging set of a session, so the mapping is only
+ * released with the registry.
+ *
+ * @param R Pointer to the registry.
+ * @param addr Start of the mapping.
+ * @param size Size of the mapping in bytes.
+ */
+void keepMapping(registry *R, void *addr, size_t size) {
+    mappedFile *file = (mappedFile *)allocOrExit(sizeof(mappedFile));
+
+    file->addr = addr;
+    file->size = size;
+    file->next = R->files;
+    R->files = file;
+}
+
+/**
+ * @brief Looks up a set by its name.
+ *
+ * @param R Pointer to the registry.
+ * @param name Characters of the name, not necessarily null-terminated.
+ * @param len Number of characters in the name.
+ * @return Pointer to the set, or NULL if no set has this name.
+ */
+set *findSet(registry *R, const char *name, size_t len) {
+    namedSet *node = R->slots[findSlot(R, name, len, hashChars(name, len))].value;
+
+    return node ? &node->value : NULL;
+}
+
+/**
+ * @brief Creates an empty set with the given name.
+ *
+ * @param R Pointer to the registry.
+ * @param name Characters of the name, not necessarily null-terminated.
+ * @param len Number of characters in the name.
+ * @return Pointer to the new set, or NULL if a set already has this name.
+ */
+set *createSet(registry *R, const char *name, size_t len) {
+    unsigned long hash = hashChars(name, len);
+    registryEntry *slot;
+
+    if(R->slots[findSlot(R, name, len, hash)].name) return NULL;
+
+    /* Keep at least half of the slots empty so probes stay short */
+    if((R->count + 1) * REGISTRY_LOAD > R->capacity) growRegistry(R);
+
+    slot = &R->slots[findSlot(R, name, len, hash)];
+    slot->name = (char *)allocOrExit(len + 1);
+    memcpy(slot->name, name, len);
+    slot->name[len] = '\0';
+    slot->len = len;
+    slot->hash = hash;
+    slot->value = (namedSet *)allocOrExit(sizeof(namedSet));
+    memset(slot->value, 0, sizeof(namedSet));
+    initSet(&slot->value->value, R->maxValue, R->kind);
+    pthread_rwlock_init(&slot->value->lock, NULL);
+    R->count++;
+    return &slot->value->value;
+}
+
+/**
+ * @brief Drops the set with the given name and frees it.
+ *
+ * The sets probed after it are shifted back into the freed slot, so lookups
+ * never need markers of deleted slots.
+ *
+ * @param R Pointer to the registry.
+ * @param name Characters of the name, not necessarily null-terminated.
+ * @param len Number of characters in the name.
+ * @return 1 if the set was dropped, 0 if no set has this name.
+ */
+int dropSet(registry *R, const char *name, size_t len) {
+    size_t mask = R->capacity - 1, hole = findSlot(R, name, len, hashChars(name, len)), i, home;
+
+    if(!R->slots[hole].name) return 0;
+
+    freeNamedSet(R->slots[hole].value);
+    free(R->slots[hole].name);
+    R->count--;
+
+    for(i = (hole + 1) & mask; R->slots[i].name; i = (i + 1) & mask) {
+        home = (size_t)R->slots[i].hash & mask;
+
+        /* Move the set back if its home slot is not between the hole and its slot */
+        if(((i - home) & mask) >= ((i - hole) & mask)) {
+            R->slots[hole] = R->slots[i];
+            hole = i;
+        }
+    }
+    memset(&R->slots[hole], 0, sizeof(registryEntry));
+    return 1;
+}
+
+/**
+ * @brief Adds a derived set to the dependents of a set.
+ *
+ * @param node Pointer to the set.
+ * @param dependent Pointer to the derived set.
+ */
+static void addDependent(namedSet *node, namedSet *dependent) {
+    namedSet **tmp;
+
+    if(node->dependentCount == node->dependentCap) {
+        node->dependentCap = node->dependentCap ? node->dependentCap * 2 : 4;
+        tmp = (namedSet **)realloc(node->dependents, node->dependentCap * sizeof(namedSet *));
+        if(!tmp) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        node->dependents = tmp;
+    }
+    node->dependents[node->dependentCount++] = dependent;
+}
+
+/**
+ * @brief Creates a derived set with the given name.
+ *
+ * The set starts out stale, it is computed when it is first read.
+ *
+ * @param R Pointer to the registry.
+ * @param name Characters of the name, not necessarily null-terminated.
+ * @param len Number of characters in the name.
+ * @param definition Characters of the expression defining the set.
+ * @param defLen Number of characters in the expression.
+ * @param inputs Sets of the registry used by the expression, possibly repeated.
+ * @param inputCount Number of inputs.
+ * @return Pointer to the new set, or NULL if a set already has this name.
+ */
+set *defineSet(registry *R, const char *name, size_t len, const char *definition, size_t defLen,
+               set *inputs[], size_t inputCount) {
+    set *A = createSet(R, name, len);
+    namedSet *node, *in;
+    size_t i, j;
+
+    if(!A) return NULL;
+    node = (namedSet *)A;
+
+    node->definition = (char *)allocOrExit(defLen + 1);
+    memcpy(node->definition, definition, defLen);
+    node->definition[defLen] = '\0';
+    node->stale = 1;
+
+    /* Each distinct input learns about the new set once */
+    node->inputs = (namedSet **)allocOrExit((inputCount ? inputCount : 1) * sizeof(namedSet *));
+    for(i = 0; i < inputCount; i++) {
+        in = (namedSet *)inputs[i];
+        for(j = 0; j < node->inputCount && node->inputs[j] != in; j++);
+        if(j < node->inputCount) continue;
+
+        node->inputs[node->inputCount++] = in;
+        addDependent(in, node);
+    }
+    return A;
+}
+
+/**
+ * @brief Checks whether a set of the registry is derived.
+ *
+ * @param A Pointer to a set of the registry.
+ * @return 1 if the set is defined by an expression, 0 otherwise.
+ */
+int isDerived(set *A) {
+    return ((namedSet *)A)->definition != NULL;
+}
+
+/**
+ * @brief Checks whether derived sets use a set of the registry.
+ *
+ * @param A Pointer to a set of the registry.
+ * @return 1 if the set is an input of a derived set, 0 otherwise.
+ */
+int hasDependents(set *A) {
+    return ((namedSet *)A)->dependentCount > 0;
+}
+
+/**
+ * @brief Marks the derived sets depending on a set as stale.
+ *
+ * A set that is already stale has its dependents marked already, so the walk
+ * stops there and only visits the sets that change state.
+ *
+ * @param node Pointer to the set.
+ */
+static void markDependents(namedSet *node) {
+    size_t i;
+
+    for(i = 0; i < node->dependentCount; i++) {
+        if(node->dependents[i]->stale) continue;
+        node->dependents[i]->stale = 1;
+        markDependents(node->dependents[i]);
+    }
+}
+
+/**
+ * @brief Records that a set of the registry was modified.
+ *
+ * Every derived set depending on it, directly or not, becomes stale. Writers
+ * of distinct sets may share dependents, so the flags are changed under a lock.
+ *
+ * @param A Pointer to a set of the registry.
+ */
+void markModified(set *A) {
+    namedSet *node = (namedSet *)A;
+
+    if(!node->dependentCount) return;
+
+    pthread_mutex_lock(&staleLock);
+    markDependents(node);
+    pthread_mutex_unlock(&staleLock);
+}
+
+/**
+ * @brief Checks whether a derived set must be computed again before it is read.
+ *
+ * @param A Pointer to a set of the registry.
+ * @return 1 if the set is derived and one of its inputs changed, 0 otherwise.
+ */
+int needsRefresh(set *A) {
+    namedSet *node = (namedSet *)A;
+    int stale;
+
+    if(!node->definition) return 0;
+
+    pthread_mutex_lock(&staleLock);
+    stale = node->stale;
+    pthread_mutex_unlock(&staleLock);
+    return stale;
+}
+
+/**
+ * @brief Makes the registry safe to use from several threads.
+ *
+ * @param R Pointer to the registry.
+ * @note The locks below do nothing until the registry is shared.
+ */
+void shareRegistry(registry *R) {
+    R->shared = 1;
+}
+
+/**
+ * @brief Checks whether several threads use the registry.
+ *
+ * @param R Pointer to the registry.
+ * @return 1 if the registry is shared, 0 otherwise.
+ */
+int isShared(registry *R) {
+    return R->shared;
+}
+
+/**
+ * @brief Locks the registry for a command.
+ *
+ * @param R Pointer to the registry.
+ * @param exclusive 1 to keep every other command out, 0 to only keep out the exclusive ones.
+ */
+void lockRegistry(registry *R, int exclusive) {
+    if(!R->shared) return;
+    if(exclusive) pthread_rwlock_wrlock(&R->lock);
+    else pthread_rwlock_rdlock(&R->lock);
+}
+
+/**
+ * @brief Unlocks the registry after a command.
+ *
+ * @param R Pointer to the registry.
+ */
+void unlockRegistry(registry *R) {
+    if(R->shared) pthread_rwlock_unlock(&R->lock);
+}
+
+/**
+ * @brief Locks the sets used by a command while holding the registry lock shared.
+ *
+ * The sets are locked in the order of their addresses, so two commands
+ * never wait for each other.
+ *
+ * @param R Pointer to the registry.
+ * @param sets Sets of the registry used by the command, NULL entries and repeats are skipped. Sorted in place.
+ * @param count Number of entries.
+ * @param target The set written by the command, locked exclusive, or NULL.
+ */
+void lockSets(registry *R, set *sets[], size_t count, set *target) {
+    size_t i, j;
+    set *tmp;
+
+    if(!R->shared) return;
+
+    /* A command uses a few sets, an insertion sort is enough */
+    for(i = 1; i < count; i++)
+        for(j = i; j > 0 && (size_t)sets[j - 1] > (size_t)sets[j]; j--) {
+            tmp = sets[j];
+            sets[j] = sets[j - 1];
+            sets[j - 1] = tmp;
+        }
+
+    for(i = 0; i < count; i++) {
+        if(!sets[i] || (i > 0 && sets[i] == sets[i - 1])) continue;
+        if(sets[i] == target) pthread_rwlock_wrlock(&((namedSet *)sets[i])->lock);
+        else pthread_rwlock_rdlock(&((namedSet *)sets[i])->lock);
+    }
+}
+
+/**
+ * @brief Unlocks the sets locked by lockSets.
+ *
+ * @param R Pointer to the registry.
+ * @param sets The sets, as sorted by lockSets.
+ * @param count Number of entries.
+ */
+void unlockSets(registry *R, set *sets[], size_t count) {
+    size_t i;
+
+    if(!R->shared) return;
+
+    for(i = 0; i < count; i++)
+        if(sets[i] && (i == 0 || sets[i] != sets[i - 1]))
+            pthread_rwlock_unlock(&((namedSet *)sets[i])->lock);
+}
@@ -0,0 +1,253 @@
+/**
+ * @file registry.h
+ * @brief Registry of the named sets of a session.
+ *
+ * The sets are kept in an open-addressing hash table keyed by their name,
+ * with linear probing, so a name is resolved in constant expected time
+ * however many sets exist. Sets are created and dropped on demand.
+ *
+ * A derived set is defined by an expression over other sets. Every set knows
+ * the derived sets that use it, so a change to a set marks exactly the derived
+ * sets depending on it, directly or not, as stale.
+ *
+ * A registry shared by the clients of the server is guarded by two levels of
+ * reader-writer locks. Commands that only read and write existing plain sets
+ * hold the registry lock shared and lock their own sets, shared for the sets
+ * they read and exclusive for the set they write, so commands on distinct
+ * sets and reads of the same set run in parallel. Commands that change the
+ * registry itself or compute derived sets hold the registry lock exclusive.
+ */
+
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <pthread.h>
+#include "set.h"
+
+#define REGISTRY_SIZE 16 /**< Define the initial number of slots of the table, a power of 2 */
+#define REGISTRY_LOAD 2  /**< Define the table is grown once it is 1/REGISTRY_LOAD full */
+
+/**
+ * @brief Structure representing a set of the registry and its dependencies.
+ */
+typedef struct namedSet {
+    set value;                    /**< The set, first so that a set of the registry converts to its namedSet */
+    char *definition;             /**< Expression of a derived set, NULL for a plain set */
+    int stale;                    /**< 1 if a derived set must be computed again before it is read */
+    struct namedSet **inputs;     /**< Distinct sets used by the definition */
+    size_t inputCount;            /**< Number of inputs */
+    struct namedSet **dependents; /**< Derived sets whose definition uses this set */
+    size_t dependentCount;        /**< Number of dependents */
+    size_t dependentCap;          /**< Number of dependents the array can hold */
+    pthread_rwlock_t lock;        /**< Guards the set while the registry is shared */
+} namedSet;
+
+/**
+ * @brief Structure representing a slot of the registry.
+ */
+typedef struct {
+    char *name;         /**< Name of the set, NULL for an empty slot */
+    size_t len;         /**< Number of characters in the name */
+    unsigned long hash; /**< Hash of the name */
+    namedSet *value;    /**< The set, its address does not change while it exists */
+} registryEntry;
+
+/**
+ * @brief Structure representing a snapshot file mapped into memory.
+ */
+typedef struct mappedFile {
+    void *addr;              /**< Start of the mapping */
+    size_t size;             /**< Size of the mapping in bytes */
+    struct mappedFile *next; /**< Next mapping of the registry */
+} mappedFile;
+
+/**
+ * @brief Structure representing the registry of named sets.
+ */
+typedef struct {
+    registryEntry *slots;   /**< Hash table of the sets */
+    size_t capacity;        /**< Number of slots, a power of 2 */
+    size_t count;           /**< Number of sets */
+    unsigned long maxValue; /**< Largest element of the universe of new sets */
+    SetKind kind;           /**< Representation of new sets */
+    int shared;             /**< 1 if several threads use the registry */
+    mappedFile *files;      /**< Snapshots whose words sets may use, unmapped when the registry is freed */
+    pthread_rwlock_t lock;  /**< Guards the table and the derived sets while the registry is shared */
+} registry;
+
+/**
+ * @brief Initializes an empty registry.
+ *
+ * @param R Pointer to the registry.
+ * @param maxValue Largest element of the universe of the sets created in it.
+ * @param kind Representation of the sets created in it.
+ */
+void initRegistry(registry *R, unsigned long maxValue, SetKind kind);
+
+/**
+ * @brief Frees a registry and every set in it.
+ *
+ * @param R Pointer to the registry.
+ */
+void freeRegistry(registry *R);
+
+/**
+ * @brief Replaces every set of a registry with the sets of another one.
+ *
+ * The sets of R are freed and the sets, universe, representation and
+ * mappings of from are moved to R, whose locks are kept. The registry from
+ * is left empty and freed.
+ *
+ * @param R Pointer to the registry to fill.
+ * @param from Pointer to the registry holding the new sets.
+ */
+void replaceRegistry(registry *R, registry *from);
+
+/**
+ * @brief Keeps a mapped snapshot until the registry is freed.
+ *
+ * Sets may keep using the words of a snapshot after they are replaced, for
+ * instance through the staging set of a session, so the mapping is only
+ * released with the registry.
+ *
+ * @param R Pointer to the registry.
+ * @param addr Start of the mapping.
+ * @param size Size of the mapping in bytes.
+ */
+void keepMapping(registry *R, void *addr, size_t size);
+
+/**
+ * @brief Looks up a set by its name.
+ *
+ * @param R Pointer to the registry.
+ * @param name Characters of the name, not necessarily null-terminated.
+ * @param len Number of characters in the name.
+ * @return Pointer to the set, or NULL if no set has this name.
+ */
+set *findSet(registry *R, const char *name, size_t len);
+
+/**
+ * @brief Creates an empty set with the given name.
+ *
+ * @param R Pointer to the registry.
+ * @param name Characters of the name, not necessarily null-terminated.
+ * @param len Number of characters in the name.
+ * @return Pointer to the new set, or NULL if a set already has this name.
+ */
+set *createSet(registry *R, const char *name, size_t len);
+
+/**
+ * @brief Drops the set with the given name and frees it.
+ *
+ * @param R Pointer to the registry.
+ * @param name Characters of the name, not necessarily null-terminated.
+ * @param len Number of characters in the name.
+ * @return 1 if the set was dropped, 0 if no set has this name.
+ * @note A set used by a derived set must not be dropped, see hasDependents.
+ */
+int dropSet(registry *R, const char *name, size_t len);
+
+/**
+ * @brief Creates a derived set with the given name.
+ *
+ * The set starts out stale, it is computed when it is first read.
+ *
+ * @param R Pointer to the registry.
+ * @param name Characters of the name, not necessarily null-terminated.
+ * @param len Number of characters in the name.
+ * @param definition Characters of the expression defining the set.
+ * @param defLen Number of characters in the expression.
+ * @param inputs Sets of the registry used by the expression, possibly repeated.
+ * @param inputCount Number of inputs.
+ * @return Pointer to the new set, or NULL if a set already has this name.
+ */
+set *defineSet(registry *R, const char *name, size_t len, const char *definition, size_t defLen,
+               set *inputs[], size_t inputCount);
+
+/**
+ * @brief Checks whether a set of the registry is derived.
+ *
+ * @param A Pointer to a set of the registry.
+ * @return 1 if the set is defined by an expression, 0 otherwise.
+ */
+int isDerived(set *A);
+
+/**
+ * @brief Checks whether derived sets use a set of the registry.
+ *
+ * @param A Pointer to a set of the registry.
+ * @return 1 if the set is an input of a derived set, 0 otherwise.
+ */
+int hasDependents(set *A);
+
+/**
+ * @brief Records that a set of the registry was modified.
+ *
+ * Every derived set depending on it, directly or not, becomes stale.
+ *
+ * @param A Pointer to a set of the registry.
+ */
+void markModified(set *A);
+
+/**
+ * @brief Checks whether a derived set must be computed again before it is read.
+ *
+ * @param A Pointer to a set of the registry.
+ * @return 1 if the set is derived and one of its inputs changed, 0 otherwise.
+ */
+int needsRefresh(set *A);
+
+/**
+ * @brief Makes the registry safe to use from several threads.
+ *
+ * @param R Pointer to the registry.
+ * @note The locks below do nothing until the registry is shared.
+ */
+void shareRegistry(registry *R);
+
+/**
+ * @brief Checks whether several threads use the registry.
+ *
+ * @param R Pointer to the registry.
+ * @return 1 if the registry is shared, 0 otherwise.
+ */
+int isShared(registry *R);
+
+/**
+ * @brief Locks the registry for a command.
+ *
+ * @param R Pointer to the registry.
+ * @param exclusive 1 to keep every other command out, 0 to only keep out the exclusive ones.
+ */
+void lockRegistry(registry *R, int exclusive);
+
+/**
+ * @brief Unlocks the registry after a command.
+ *
+ * @param R Pointer to the registry.
+ */
+void unlockRegistry(registry *R);
+
+/**
+ * @brief Locks the sets used by a command while holding the registry lock shared.
+ *
+ * The sets are locked in the order of their addresses, so two commands
+ * never wait for each other.
+ *
+ * @param R Pointer to the registry.
+ * @param sets Sets of the registry used by the command, NULL entries and repeats are skipped. Sorted in place.
+ * @param count Number of entries.
+ * @param target The set written by the command, locked exclusive, or NULL.
+ */
+void lockSets(registry *R, set *sets[], size_t count, set *target);
+
+/**
+ * @brief Unlocks the sets locked by lockSets.
+ *
+ * @param R Pointer to the registry.
+ * @param sets The sets, as sorted by lockSets.
+ * @param count Number of entries.
+ */
+void unlockSets(registry *R, set *sets[], size_t count);
+
+#endif /* REGISTRY_H */
@@ -0,0 +1,1315 @@
+/**
+ * @file roaring.c
+ * @brief Compressed sets for sparse large universes, modeled on Roaring bitmaps.
+ *
+ * A number is split into a 16-bit key selecting its chunk and a 16-bit low part
+ * stored in the container of that chunk. Containers are never empty, and the
+ * keys of a set are kept sorted so chunks can be found by binary search.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "roaring.h"
+#include "bit_utils.h"
+
+#define CHUNK_BITS 16                          /**< Number of low bits stored in a container */
+#define CHUNK_SIZE 65536UL                     /**< Number of elements in a chunk */
+#define CHUNK_WORDS (CHUNK_SIZE / WORD_BITS)   /**< Number of words in a bitmap container */
+#define ARRAY_MAX 4096                         /**< Largest number of values in an array container */
+
+/**
+ * @brief Low 16 bits of an element, as stored in a container.
+ */
+typedef unsigned short chunkValue;
+
+/**
+ * @brief Enumeration representing the types of containers.
+ */
+typedef enum {
+    ARRAY_CONTAINER,  /**< Sorted array of values */
+    BITMAP_CONTAINER, /**< One bit per value of the chunk */
+    RUN_CONTAINER     /**< Sorted list of runs of consecutive values */
+} ContainerType;
+
+/**
+ * @brief Structure representing a run of consecutive values.
+ */
+typedef struct {
+    chunkValue start; /**< First value of the run */
+    chunkValue last;  /**< Last value of the run, inclusive */
+} run;
+
+/**
+ * @brief Structure representing the container of one chunk.
+ *
+ * Only the array matching the type of the container is allocated.
+ */
+typedef struct {
+    ContainerType type;        /**< Type of the container */
+    unsigned long cardinality; /**< Number of values in the container */
+    size_t length;             /**< Number of values of an array, or runs of a run container */
+    size_t capacity;           /**< Number of values or runs allocated */
+    chunkValue *values;        /**< Values of an array container */
+    setWord *bits;             /**< Words of a bitmap container */
+    run *runs;                 /**< Runs of a run container */
+} container;
+
+/**
+ * @brief Structure representing a compressed set.
+ */
+struct roaringSet {
+    chunkValue *keys;      /**< Sorted keys of the chunks that hold elements */
+    container *containers; /**< Container of each key */
+    size_t count;          /**< Number of containers */
+    size_t capacity;       /**< Number of containers allocated */
+    unsigned long *counts; /**< Number of elements before each container, and in total */
+    int countsValid;       /**< 1 if counts matches the containers */
+};
+
+/**
+ * @brief Allocates memory, exiting the program if the allocation fails.
+ *
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the allocated memory.
+ */
+static void *allocMemory(size_t size) {
+    void *ptr = malloc(size ? size : 1);
+
+    if(!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Resizes memory, exiting the program if the reallocation fails.
+ *
+ * @param ptr Pointer to the memory to resize.
+ * @param size Number of bytes needed.
+ * @return Pointer to the resized memory.
+ */
+static void *resizeMemory(void *ptr, size_t size) {
+    void *tmp = realloc(ptr, size ? size : 1);
+
+    if(!tmp) {
+        fprintf(stderr, "Memory reallocation failed\n");
+        free(ptr);
+        exit(EXIT_FAILURE);
+    }
+    return tmp;
+}
+
+/**
+ * @brief Counts the bits set in the words of a bitmap container.
+ *
+ * @param bits Words of the bitmap.
+ * @return Number of bits set.
+ */
+static unsigned long countBits(const setWord *bits) {
+    unsigned long count = 0;
+    size_t i;
+
+    for(i = 0; i < CHUNK_WORDS; i++)
+        count += popcountWord(bits[i]);
+    return count;
+}
+
+/**
+ * @brief Checks whether a bit of a bitmap container is set.
+ *
+ * @param bits Words of the bitmap.
+ * @param v Value to check.
+ * @return 1 if the bit is set, 0 otherwise.
+ */
+static int testBit(const setWord *bits, unsigned long v) {
+    return (int)((bits[v / WORD_BITS] >> (v % WORD_BITS)) & 1);
+}
+
+/**
+ * @brief Applies an operation to a range of bits with word masks.
+ *
+ * Whole words are set, cleared or flipped at once, and only the words at the
+ * edges of the range are masked.
+ *
+ * @param bits Words of the bitmap.
+ * @param start First value of the range.
+ * @param last Last value of the range, inclusive.
+ * @param op ROARING_OR sets the range, ROARING_ANDNOT clears it and ROARING_XOR flips it.
+ */
+static void applyRange(setWord *bits, unsigned long start, unsigned long last, RoaringOp op) {
+    size_t first = start / WORD_BITS, end = last / WORD_BITS, i;
+    setWord mask;
+
+    for(i = first; i <= end; i++) {
+        mask = ~(setWord)0;
+        if(i == first) mask &= ~(setWord)0 << (start % WORD_BITS);
+        if(i == end) mask &= ~(setWord)0 >> (WORD_BITS - 1 - last % WORD_BITS);
+
+        if(op == ROARING_OR) bits[i] |= mask;
+        else if(op == ROARING_ANDNOT) bits[i] &= ~mask;
+        else bits[i] ^= mask;
+    }
+}
+
+/**
+ * @brief Finds the first value of a sorted array that is not less than v.
+ *
+ * @param values Sorted array of values.
+ * @param n Length of the array.
+ * @param v Value to search for.
+ * @return Index of the value found, or n if all values are less than v.
+ */
+static size_t lowerBound(const chunkValue *values, size_t n, unsigned long v) {
+    size_t low = 0, high = n, mid;
+
+    while(low < high) {
+        mid = low + (high - low) / 2;
+        if(values[mid] < v) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+/**
+ * @brief Finds the first run that ends at or after v.
+ *
+ * @param runs Sorted array of runs.
+ * @param n Number of runs.
+ * @param v Value to search for.
+ * @return Index of the run found, or n if all runs end before v.
+ */
+static size_t findRun(const run *runs, size_t n, unsigned long v) {
+    size_t low = 0, high = n, mid;
+
+    while(low < high) {
+        mid = low + (high - low) / 2;
+        if(runs[mid].last < v) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+/**
+ * @brief Creates an empty container.
+ *
+ * @param type Type of the container.
+ * @param capacity Number of values or runs to allocate, ignored for bitmaps.
+ * @return The new container.
+ */
+static container newContainer(ContainerType type, size_t capacity) {
+    container c;
+
+    c.type = type;
+    c.cardinality = 0;
+    c.length = 0;
+    c.capacity = capacity;
+    c.values = NULL;
+    c.bits = NULL;
+    c.runs = NULL;
+
+    if(type == ARRAY_CONTAINER)
+        c.values = (chunkValue *)allocMemory(capacity * sizeof(chunkValue));
+    else if(type == RUN_CONTAINER)
+        c.runs = (run *)allocMemory(capacity * sizeof(run));
+    else {
+        c.bits = (setWord *)allocMemory(CHUNK_WORDS * sizeof(setWord));
+        memset(c.bits, 0, CHUNK_WORDS * sizeof(setWord));
+    }
+    return c;
+}
+
+/**
+ * @brief Frees the memory held by a container.
+ *
+ * @param c Pointer to the container.
+ */
+static void freeContainer(container *c) {
+    free(c->values);
+    free(c->bits);
+    free(c->runs);
+}
+
+/**
+ * @brief Creates a copy of a container.
+ *
+ * @param c Pointer to the container to copy.
+ * @return The new container.
+ */
+static container copyContainer(const container *c) {
+    container d = newContainer(c->type, c->length);
+
+    if(c->type == ARRAY_CONTAINER) memcpy(d.values, c->values, c->length * sizeof(chunkValue));
+    else if(c->type == RUN_CONTAINER) memcpy(d.runs, c->runs, c->length * sizeof(run));
+    else memcpy(d.bits, c->bits, CHUNK_WORDS * sizeof(setWord));
+
+    d.length = c->length;
+    d.cardinality = c->cardinality;
+    return d;
+}
+
+/**
+ * @brief Appends a run to a run container, merging it with the last run when they touch.
+ *
+ * @param c Pointer to the run container.
+ * @param start First value of the run.
+ * @param last Last value of the run, inclusive.
+ * @note Runs must be appended in increasing order.
+ */
+static void appendRun(container *c, unsigned long start, unsigned long last) {
+    if(c->length && (unsigned long)c->runs[c->length - 1].last + 1 == start)
+        c->runs[c->length - 1].last = (chunkValue)last;
+    else {
+        if(c->length == c->capacity) {
+            c->capacity = c->capacity ? c->capacity * 2 : 4;
+            c->runs = (run *)resizeMemory(c->runs, c->capacity * sizeof(run));
+        }
+        c->runs[c->length].start = (chunkValue)start;
+        c->runs[c->length].last = (chunkValue)last;
+        c->length++;
+    }
+    c->cardinality += last - start + 1;
+}
+
+/**
+ * @brief Converts a container to a bitmap container.
+ *
+ * @param c Pointer to the container.
+ */
+static void toBitmap(container *c) {
+    container b;
+    size_t i;
+
+    if(c->type == BITMAP_CONTAINER) return;
+    b = newContainer(BITMAP_CONTAINER, 0);
+
+    if(c->type == ARRAY_CONTAINER)
+        for(i = 0; i < c->length; i++)
+            b.bits[c->values[i] / WORD_BITS] |= (setWord)1 << (c->values[i] % WORD_BITS);
+    else
+        for(i = 0; i < c->length; i++)
+            applyRange(b.bits, c->runs[i].start, c->runs[i].last, ROARING_OR);
+
+    b.cardinality = c->cardinality;
+    freeContainer(c);
+    *c = b;
+}
+
+/**
+ * @brief Converts a container holding at most ARRAY_MAX values to an array container.
+ *
+ * @param c Pointer to the container.
+ */
+static void toArray(container *c) {
+    container a;
+    unsigned long v;
+    setWord w;
+    size_t i;
+
+    if(c->type == ARRAY_CONTAINER) return;
+    a = newContainer(ARRAY_CONTAINER, c->cardinality);
+
+    if(c->type == BITMAP_CONTAINER) {
+        /* Take the set bits of each word from the lowest one up */
+        for(i = 0; i < CHUNK_WORDS; i++)
+            for(w = c->bits[i]; w; w &= w - 1)
+                a.values[a.length++] = (chunkValue)(i * WORD_BITS + lowestBit(w));
+    }
+    else
+        for(i = 0; i < c->length; i++)
+            for(v = c->runs[i].start; v <= c->runs[i].last; v++)
+                a.values[a.length++] = (chunkValue)v;
+
+    a.cardinality = c->cardinality;
+    freeContainer(c);
+    *c = a;
+}
+
+/**
+ * @brief Counts the runs of consecutive values in a container.
+ *
+ * @param c Pointer to the container.
+ * @return Number of runs.
+ */
+static size_t countRuns(const container *c) {
+    setWord carry = 0, w;
+    size_t i, runs = 0;
+
+    if(c->type == RUN_CONTAINER) return c->length;
+
+    if(c->type == ARRAY_CONTAINER) {
+        for(i = 0; i < c->length; i++)
+            if(!i || c->values[i] != c->values[i - 1] + 1)
+                runs++;
+        return runs;
+    }
+
+    /* A run starts at every set bit whose lower neighbour is clear */
+    for(i = 0; i < CHUNK_WORDS; i++) {
+        w = c->bits[i];
+        runs += popcountWord(w & ~((w << 1) | carry));
+        carry = w >> (WORD_BITS - 1);
+    }
+    return runs;
+}
+
+/**
+ * @brief Converts a container to a run container.
+ *
+ * @param c Pointer to the container.
+ */
+static void toRuns(container *c) {
+    container r;
+    unsigned long v, start;
+    size_t i;
+
+    if(c->type == RUN_CONTAINER) return;
+    r = newContainer(RUN_CONTAINER, countRuns(c));
+
+    if(c->type == ARRAY_CONTAINER)
+        for(i = 0; i < c->length; i++)
+            appendRun(&r, c->values[i], c->values[i]);
+    else {
+        /* Each run goes from a set bit to the next clear bit */
+        for(v = 0; v < CHUNK_SIZE && nextSetBit(c->bits, CHUNK_WORDS, v, &start); ) {
+            if(!nextClearBit(c->bits, CHUNK_WORDS, start, &v))
+                v = CHUNK_SIZE;
+            appendRun(&r, start, v - 1);
+        }
+    }
+
+    freeContainer(c);
+    *c = r;
+}
+
+/**
+ * @brief Converts a container to the type that takes the least memory.
+ *
+ * @param c Pointer to the container.
+ */
+static void optimizeContainer(container *c) {
+    size_t arrayCost, runCost, bitmapCost = CHUNK_WORDS * sizeof(setWord);
+
+    runCost = countRuns(c) * sizeof(run);
+    arrayCost = c->cardinality <= ARRAY_MAX ? c->cardinality * sizeof(chunkValue) : bitmapCost + 1;
+
+    if(runCost < arrayCost && runCost < bitmapCost) toRuns(c);
+    else if(arrayCost <= bitmapCost) toArray(c);
+    else toBitmap(c);
+}
+
+/**
+ * @brief Checks if a value is in a container.
+ *
+ * @param c Pointer to the container.
+ * @param v Value to check.
+ * @return 1 if the value is in the container, 0 otherwise.
+ */
+static int containerContains(const container *c, unsigned long v) {
+    size_t i;
+
+    switch(c->type) {
+        case ARRAY_CONTAINER:
+            i = lowerBound(c->values, c->length, v);
+            return i < c->length && c->values[i] == v;
+
+        case BITMAP_CONTAINER:
+            return testBit(c->bits, v);
+
+        default:
+            i = findRun(c->runs, c->length, v);
+            return i < c->length && c->runs[i].start <= v;
+    }
+}
+
+/**
+ * @brief Adds a value to a container.
+ *
+ * @param c Pointer to the container.
+ * @param v Value to be added.
+ */
+static void containerAdd(container *c, unsigned long v) {
+    size_t i;
+    int joinsPrev, joinsNext;
+
+    switch(c->type) {
+        case ARRAY_CONTAINER:
+            i = lowerBound(c->values, c->length, v);
+            if(i < c->length && c->values[i] == v) return;
+
+            /* A full array becomes a bitmap */
+            if(c->length == ARRAY_MAX) {
+                toBitmap(c);
+                containerAdd(c, v);
+                return;
+            }
+            if(c->length == c->capacity) {
+                c->capacity = c->capacity ? c->capacity * 2 : 4;
+                c->values = (chunkValue *)resizeMemory(c->values, c->capacity * sizeof(chunkValue));
+            }
+            memmove(c->values + i + 1, c->values + i, (c->length - i) * sizeof(chunkValue));
+            c->values[i] = (chunkValue)v;
+            c->length++;
+            break;
+
+        case BITMAP_CONTAINER:
+            if(testBit(c->bits, v)) return;
+            c->bits[v / WORD_BITS] |= (setWord)1 << (v % WORD_BITS);
+            break;
+
+        default:
+            i = findRun(c->runs, c->length, v);
+            if(i < c->length && c->runs[i].start <= v) return;
+
+            /* Extend the neighbouring runs when the value touches them */
+            joinsPrev = i > 0 && (unsigned long)c->runs[i - 1].last + 1 == v;
+            joinsNext = i < c->length && (unsigned long)c->runs[i].start == v + 1;
+
+            if(joinsPrev && joinsNext) {
+                c->runs[i - 1].last = c->runs[i].last;
+                memmove(c->runs + i, c->runs + i + 1, (c->length - i - 1) * sizeof(run));
+                c->length--;
+            }
+            else if(joinsPrev) c->runs[i - 1].last = (chunkValue)v;
+            else if(joinsNext) c->runs[i].start = (chunkValue)v;
+            else {
+                if(c->length == c->capacity) {
+                    c->capacity = c->capacity ? c->capacity * 2 : 4;
+                    c->runs = (run *)resizeMemory(c->runs, c->capacity * sizeof(run));
+                }
+                memmove(c->runs + i + 1, c->runs + i, (c->length - i) * sizeof(run));
+                c->runs[i].start = c->runs[i].last = (chunkValue)v;
+                c->length++;
+            }
+    }
+    c->cardinality++;
+}
+
+/**
+ * @brief Finds the smallest value of a container that is not less than v.
+ *
+ * @param c Pointer to the container.
+ * @param v Value to start from.
+ * @param next Where the value found is stored.
+ * @return 1 if a value was found, 0 otherwise.
+ */
+static int containerNext(const container *c, unsigned long v, unsigned long *next) {
+    size_t i;
+
+    switch(c->type) {
+        case ARRAY_CONTAINER:
+            i = lowerBound(c->values, c->length, v);
+            if(i == c->length) return 0;
+            *next = c->values[i];
+            return 1;
+
+        case BITMAP_CONTAINER:
+            return nextSetBit(c->bits, CHUNK_WORDS, v, next);
+
+        default:
+            i = findRun(c->runs, c->length, v);
+            if(i == c->length) return 0;
+            *next = c->runs[i].start > v ? c->runs[i].start : v;
+            return 1;
+    }
+}
+
+/**
+ * @brief Counts the values of a container that are not greater than v.
+ *
+ * @param c Pointer to the container.
+ * @param v The value.
+ * @return Number of values less than or equal to v.
+ */
+static unsigned long containerRank(const container *c, unsigned long v) {
+    unsigned long rank = 0;
+    size_t i;
+
+    switch(c->type) {
+        case ARRAY_CONTAINER:
+            return lowerBound(c->values, c->length, v + 1);
+
+        case BITMAP_CONTAINER:
+            for(i = 0; i < v / WORD_BITS; i++)
+                rank += popcountWord(c->bits[i]);
+            return rank + popcountWord(c->bits[i] & (~(setWord)0 >> (WORD_BITS - 1 - v % WORD_BITS)));
+
+        default:
+            for(i = 0; i < c->length && c->runs[i].last <= v; i++)
+                rank += c->runs[i].last - c->runs[i].start + 1UL;
+            if(i < c->length && c->runs[i].start <= v)
+                rank += v - c->runs[i].start + 1;
+            return rank;
+    }
+}
+
+/**
+ * @brief Finds the value of a container at a position in increasing order.
+ *
+ * @param c Pointer to the container.
+ * @param k Position of the value, less than the cardinality of the container.
+ * @return The value.
+ */
+static unsigned long containerSelect(const container *c, unsigned long k) {
+    size_t i;
+
+    switch(c->type) {
+        case ARRAY_CONTAINER:
+            return c->values[k];
+
+        case BITMAP_CONTAINER:
+            for(i = 0; popcountWord(c->bits[i]) <= k; i++)
+                k -= popcountWord(c->bits[i]);
+            return i * WORD_BITS + selectBit(c->bits[i], k);
+
+        default:
+            for(i = 0; c->runs[i].last - c->runs[i].start + 1UL <= k; i++)
+                k -= c->runs[i].last - c->runs[i].start + 1UL;
+            return c->runs[i].start + k;
+    }
+}
+
+/**
+ * @brief Decides whether a value belongs to the result of an operation.
+ *
+ * @param op The operation.
+ * @param inA 1 if the value is in the first operand.
+ * @param inB 1 if the value is in the second operand.
+ * @return 1 if the value is in the result, 0 otherwise.
+ */
+static int keepValue(RoaringOp op, int inA, int inB) {
+    switch(op) {
+        case ROARING_OR: return inA || inB;
+        case ROARING_AND: return inA && inB;
+        case ROARING_ANDNOT: return inA && !inB;
+        default: return inA != inB;
+    }
+}
+
+/**
+ * @brief Combines two array containers with a sorted merge.
+ *
+ * @param a Pointer to the first container.
+ * @param b Pointer to the second container.
+ * @param op The operation.
+ * @return The result container.
+ */
+static container combineArrays(const container *a, const container *b, RoaringOp op) {
+    container r = newContainer(ARRAY_CONTAINER, a->length + b->length);
+    size_t i = 0, j = 0;
+    chunkValue v;
+    int inA, inB;
+
+    while(i < a->length || j < b->length) {
+        inA = j == b->length || (i < a->length && a->values[i] <= b->values[j]);
+        inB = i == a->length || (j < b->length && b->values[j] <= a->values[i]);
+        v = inA ? a->values[i++] : b->values[j];
+        if(inB) j++;
+
+        if(keepValue(op, inA, inB))
+            r.values[r.length++] = v;
+    }
+
+    /* A union or symmetric difference may outgrow an array */
+    r.cardinality = r.length;
+    if(r.length > ARRAY_MAX) toBitmap(&r);
+    return r;
+}
+
+/**
+ * @brief Intersects or subtracts any container from an array container.
+ *
+ * Each value of the array is kept or dropped by a membership test in the
+ * other container, so the result is never larger than the array.
+ *
+ * @param a Pointer to the array container.
+ * @param b Pointer to the other container.
+ * @param keepMembers 1 to keep the values found in b (A & B), 0 to drop them (A & ~B).
+ * @return The result container.
+ */
+static container filterArray(const container *a, const container *b, int keepMembers) {
+    container r = newContainer(ARRAY_CONTAINER, a->length);
+    size_t i;
+
+    for(i = 0; i < a->length; i++)
+        if(containerContains(b, a->values[i]) == keepMembers)
+            r.values[r.length++] = a->values[i];
+
+    r.cardinality = r.length;
+    return r;
+}
+
+/**
+ * @brief Combines two bitmap containers a word at a time.
+ *
+ * @param a Pointer to the first container.
+ * @param b Pointer to the second container.
+ * @param op The operation.
+ * @return The result container.
+ */
+static container combineBitmaps(const container *a, const container *b, RoaringOp op) {
+    container r = newContainer(BITMAP_CONTAINER, 0);
+    size_t i;
+
+    for(i = 0; i < CHUNK_WORDS; i++) {
+        if(op == ROARING_OR) r.bits[i] = a->bits[i] | b->bits[i];
+        else if(op == ROARING_AND) r.bits[i] = a->bits[i] & b->bits[i];
+        else if(op == ROARING_ANDNOT) r.bits[i] = a->bits[i] & ~b->bits[i];
+        else r.bits[i] = a->bits[i] ^ b->bits[i];
+    }
+
+    r.cardinality = countBits(r.bits);
+    return r;
+}
+
+/**
+ * @brief Combines a bitmap container with an array or run container.
+ *
+ * The bitmap is copied and the values or runs of the other container are
+ * applied to it directly. Intersections with an array never get here,
+ * they are handled by filterArray.
+ *
+ * @param a Pointer to the first container.
+ * @param b Pointer to the second container.
+ * @param op The operation.
+ * @return The result container.
+ */
+static container combineWithBitmap(const container *a, const container *b, RoaringOp op) {
+    const container *tmp;
+    container r;
+    unsigned long prev = 0;
+    size_t i;
+
+    /* Commutative operations always apply the other container to the bitmap */
+    if(b->type == BITMAP_CONTAINER && op != ROARING_ANDNOT) {
+        tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    if(a->type != BITMAP_CONTAINER) {
+        /* Runs minus a bitmap: expand the runs and clear the bits of b */
+        r = copyContainer(a);
+        toBitmap(&r);
+        for(i = 0; i < CHUNK_WORDS; i++)
+            r.bits[i] &= ~b->bits[i];
+    }
+    else {
+        r = copyContainer(a);
+        if(b->type == ARRAY_CONTAINER)
+            for(i = 0; i < b->length; i++)
+                applyRange(r.bits, b->values[i], b->values[i], op);
+        else if(op == ROARING_AND) {
+            /* Clear the gaps between the runs */
+            for(i = 0; i < b->length; i++) {
+                if(b->runs[i].start > prev)
+                    applyRange(r.bits, prev, b->runs[i].start - 1UL, ROARING_ANDNOT);
+                prev = b->runs[i].last + 1UL;
+            }
+            if(prev < CHUNK_SIZE)
+                applyRange(r.bits, prev, CHUNK_SIZE - 1, ROARING_ANDNOT);
+        }
+        else
+            for(i = 0; i < b->length; i++)
+                applyRange(r.bits, b->runs[i].start, b->runs[i].last, op);
+    }
+
+    r.cardinality = countBits(r.bits);
+    return r;
+}
+
+/**
+ * @brief Retrieves the runs of an array or run container.
+ *
+ * @param c Pointer to the container.
+ * @param owned Set to 1 if the returned container was created and must be freed.
+ * @return The run container, c itself if it already holds runs.
+ */
+static container runsOf(const container *c, int *owned) {
+    container r;
+
+    *owned = c->type != RUN_CONTAINER;
+    if(!*owned) return *c;
+
+    r = copyContainer(c);
+    toRuns(&r);
+    return r;
+}
+
+/**
+ * @brief Combines two containers made of runs by sweeping over their boundaries.
+ *
+ * Between two consecutive run boundaries, membership in each operand is
+ * constant, so every such segment is kept or dropped as a whole.
+ *
+ * @param a Pointer to the first container, an array or run container.
+ * @param b Pointer to the second container, an array or run container.
+ * @param op The operation.
+ * @return The result container.
+ */
+static container combineRuns(const container *a, const container *b, RoaringOp op) {
+    container ra, rb, r;
+    unsigned long pos = 0, endA, endB, next;
+    size_t i = 0, j = 0;
+    int ownedA, ownedB, inA, inB;
+
+    ra = runsOf(a, &ownedA);
+    rb = runsOf(b, &ownedB);
+    r = newContainer(RUN_CONTAINER, ra.length + rb.length);
+
+    while(pos < CHUNK_SIZE && (i < ra.length || j < rb.length)) {
+        /* Membership at pos and where it changes next, for each operand */
+        inA = i < ra.length && ra.runs[i].start <= pos;
+        endA = i == ra.length ? CHUNK_SIZE : inA ? ra.runs[i].last + 1UL : ra.runs[i].start;
+        inB = j < rb.length && rb.runs[j].start <= pos;
+        endB = j == rb.length ? CHUNK_SIZE : inB ? rb.runs[j].last + 1UL : rb.runs[j].start;
+        next = endA < endB ? endA : endB;
+
+        if(keepValue(op, inA, inB))
+            appendRun(&r, pos, next - 1);
+
+        pos = next;
+        if(i < ra.length && pos > ra.runs[i].last) i++;
+        if(j < rb.length && pos > rb.runs[j].last) j++;
+    }
+
+    if(ownedA) freeContainer(&ra);
+    if(ownedB) freeContainer(&rb);
+    return r;
+}
+
+/**
+ * @brief Combines two containers of the same chunk.
+ *
+ * @param a Pointer to the first container.
+ * @param b Pointer to the second container.
+ * @param op The operation.
+ * @return The result container, which may be empty.
+ */
+static container combineContainers(const container *a, const container *b, RoaringOp op) {
+    container r;
+
+    if(a->type == ARRAY_CONTAINER && b->type == ARRAY_CONTAINER)
+        r = combineArrays(a, b, op);
+    else if(a->type == ARRAY_CONTAINER && (op == ROARING_AND || op == ROARING_ANDNOT))
+        r = filterArray(a, b, op == ROARING_AND);
+    else if(b->type == ARRAY_CONTAINER && op == ROARING_AND)
+        r = filterArray(b, a, 1);
+    else if(a->type == BITMAP_CONTAINER && b->type == BITMAP_CONTAINER)
+        r = combineBitmaps(a, b, op);
+    else if(a->type == BITMAP_CONTAINER || b->type == BITMAP_CONTAINER)
+        r = combineWithBitmap(a, b, op);
+    else
+        r = combineRuns(a, b, op);
+
+    if(r.cardinality) optimizeContainer(&r);
+    return r;
+}
+
+/**
+ * @brief Inserts a container into a compressed set.
+ *
+ * @param R Pointer to the set.
+ * @param i Index where the container is inserted, keeping the keys sorted.
+ * @param key Key of the container.
+ * @param c The container, now owned by the set.
+ */
+static void insertContainer(roaringSet *R, size_t i, unsigned long key, container c) {
+    if(R->count == R->capacity) {
+        R->capacity = R->capacity ? R->capacity * 2 : 4;
+        R->keys = (chunkValue *)resizeMemory(R->keys, R->capacity * sizeof(chunkValue));
+        R->containers = (container *)resizeMemory(R->containers, R->capacity * sizeof(container));
+    }
+
+    memmove(R->keys + i + 1, R->keys + i, (R->count - i) * sizeof(chunkValue));
+    memmove(R->containers + i + 1, R->containers + i, (R->count - i) * sizeof(container));
+    R->keys[i] = (chunkValue)key;
+    R->containers[i] = c;
+    R->count++;
+    R->countsValid = 0;
+}
+
+/**
+ * @brief Creates an empty compressed set.
+ *
+ * @return Pointer to the new set.
+ * @note It is the caller's responsibility to release it with freeRoaring.
+ */
+roaringSet *newRoaring(void) {
+    roaringSet *R = (roaringSet *)allocMemory(sizeof(roaringSet));
+
+    R->keys = NULL;
+    R->containers = NULL;
+    R->count = 0;
+    R->capacity = 0;
+    R->counts = NULL;
+    R->countsValid = 0;
+    return R;
+}
+
+/**
+ * @brief Frees a compressed set and all its containers.
+ *
+ * @param R Pointer to the set, may be NULL.
+ */
+void freeRoaring(roaringSet *R) {
+    if(!R) return;
+
+    roaringClear(R);
+    free(R->counts);
+    free(R->keys);
+    free(R->containers);
+    free(R);
+}
+
+/**
+ * @brief Removes all elements of a compressed set.
+ *
+ * @param R Pointer to the set.
+ */
+void roaringClear(roaringSet *R) {
+    size_t i;
+
+    for(i = 0; i < R->count; i++)
+        freeContainer(&R->containers[i]);
+    R->count = 0;
+    R->countsValid = 0;
+}
+
+/**
+ * @brief Creates a copy of a compressed set.
+ *
+ * @param R Pointer to the set to copy.
+ * @return Pointer to the new set.
+ */
+roaringSet *roaringCopy(const roaringSet *R) {
+    roaringSet *copy = newRoaring();
+    size_t i;
+
+    for(i = 0; i < R->count; i++)
+        insertContainer(copy, i, R->keys[i], copyContainer(&R->containers[i]));
+    return copy;
+}
+
+/**
+ * @brief Compares two numbers for qsort.
+ *
+ * @param a Pointer to the first number.
+ * @param b Pointer to the second number.
+ * @return Negative, zero or positive as a is less than, equal to or greater than b.
+ */
+static int compareValues(const void *a, const void *b) {
+    unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Creates a compressed set from an unsorted array of numbers.
+ *
+ * The numbers are sorted and grouped by chunk, so no chunk is ever stored
+ * as a bitmap unless it holds enough elements to need one.
+ *
+ * @param arr Array of numbers, duplicates are allowed.
+ * @param len Length of the array.
+ * @return Pointer to the new set.
+ */
+roaringSet *roaringFromArray(const unsigned long *arr, size_t len) {
+    roaringSet *R = newRoaring();
+    unsigned long *sorted, key;
+    size_t i = 0, j, distinct;
+    container c;
+
+    sorted = (unsigned long *)allocMemory(len * sizeof(unsigned long));
+    memcpy(sorted, arr, len * sizeof(unsigned long));
+    qsort(sorted, len, sizeof(unsigned long), compareValues);
+
+    while(i < len) {
+        key = sorted[i] >> CHUNK_BITS;
+
+        /* Count the distinct values of this chunk */
+        for(j = i, distinct = 0; j < len && sorted[j] >> CHUNK_BITS == key; j++)
+            if(j == i || sorted[j] != sorted[j - 1])
+                distinct++;
+
+        c = newContainer(distinct > ARRAY_MAX ? BITMAP_CONTAINER : ARRAY_CONTAINER, distinct);
+        for(; i < j; i++)
+            if(c.type == BITMAP_CONTAINER)
+                containerAdd(&c, sorted[i] & (CHUNK_SIZE - 1));
+            else if(!c.length || c.values[c.length - 1] != (sorted[i] & (CHUNK_SIZE - 1)))
+                c.values[c.length++] = (chunkValue)(sorted[i] & (CHUNK_SIZE - 1));
+
+        if(c.type == ARRAY_CONTAINER) c.cardinality = c.length;
+        optimizeContainer(&c);
+        insertContainer(R, R->count, key, c);
+    }
+
+    free(sorted);
+    return R;
+}
+
+/**
+ * @brief Adds a number to a compressed set.
+ *
+ * @param R Pointer to the set.
+ * @param num Number to be added, at most MAX_SET_VALUE.
+ */
+void roaringAdd(roaringSet *R, unsigned long num) {
+    unsigned long key = num >> CHUNK_BITS;
+    size_t i = lowerBound(R->keys, R->count, key);
+
+    /* Create the container of the chunk on its first element */
+    if(i == R->count || R->keys[i] != key)
+        insertContainer(R, i, key, newContainer(ARRAY_CONTAINER, 4));
+    containerAdd(&R->containers[i], num & (CHUNK_SIZE - 1));
+    R->countsValid = 0;
+}
+
+/**
+ * @brief Checks if a number is in a compressed set.
+ *
+ * @param R Pointer to the set.
+ * @param num Number to check.
+ * @return 1 if the number is in the set, 0 otherwise.
+ */
+int roaringContains(const roaringSet *R, unsigned long num) {
+    unsigned long key = num >> CHUNK_BITS;
+    size_t i = lowerBound(R->keys, R->count, key);
+
+    return i < R->count && R->keys[i] == key && containerContains(&R->containers[i], num & (CHUNK_SIZE - 1));
+}
+
+/**
+ * @brief Finds the smallest element of a compressed set that is not less than a number.
+ *
+ * @param R Pointer to the set.
+ * @param from Number to start from.
+ * @param num Where the element found is stored.
+ * @return 1 if an element was found, 0 otherwise.
+ */
+int roaringNext(const roaringSet *R, unsigned long from, unsigned long *num) {
+    unsigned long key = from >> CHUNK_BITS, low;
+    size_t i = lowerBound(R->keys, R->count, key);
+
+    for(; i < R->count; i++) {
+        /* Later chunks are searched from their first value */
+        low = R->keys[i] == key ? from & (CHUNK_SIZE - 1) : 0;
+        if(containerNext(&R->containers[i], low, num)) {
+            *num |= (unsigned long)R->keys[i] << CHUNK_BITS;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Combines two compressed sets into a new one.
+ *
+ * Every pair of containers is combined with an algorithm specialized for
+ * their types, and the result container takes the cheapest type.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param op Operation to perform.
+ * @return Pointer to the new set holding A op B.
+ */
+roaringSet *roaringCombine(const roaringSet *A, const roaringSet *B, RoaringOp op) {
+    roaringSet *R = newRoaring();
+    size_t i = 0, j = 0;
+    container c;
+
+    /* Merge the sorted keys of both sets */
+    while(i < A->count || j < B->count) {
+        if(j == B->count || (i < A->count && A->keys[i] < B->keys[j])) {
+            /* Chunk only in A */
+            if(op != ROARING_AND)
+                insertContainer(R, R->count, A->keys[i], copyContainer(&A->containers[i]));
+            i++;
+        }
+        else if(i == A->count || B->keys[j] < A->keys[i]) {
+            /* Chunk only in B */
+            if(op == ROARING_OR || op == ROARING_XOR)
+                insertContainer(R, R->count, B->keys[j], copyContainer(&B->containers[j]));
+            j++;
+        }
+        else {
+            /* Chunk in both sets, drop it if nothing is left */
+            c = combineContainers(&A->containers[i], &B->containers[j], op);
+            if(c.cardinality) insertContainer(R, R->count, A->keys[i], c);
+            else freeContainer(&c);
+            i++;
+            j++;
+        }
+    }
+    return R;
+}
+
+/**
+ * @brief Structure representing the next container of an input of a multi-way union.
+ */
+typedef struct {
+    chunkValue key; /**< Key of the container */
+    size_t input;   /**< Index of the input */
+    size_t pos;     /**< Index of the container in the input */
+} mergeCursor;
+
+/**
+ * @brief Moves a cursor down a binary min-heap ordered by key until the heap is valid.
+ *
+ * @param heap Array of the cursors.
+ * @param n Number of cursors in the heap.
+ * @param i Index of the cursor to move.
+ */
+static void siftDown(mergeCursor *heap, size_t n, size_t i) {
+    mergeCursor tmp;
+    size_t child;
+
+    while((child = 2 * i + 1) < n) {
+        if(child + 1 < n && heap[child + 1].key < heap[child].key) child++;
+        if(heap[i].key <= heap[child].key) break;
+
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+}
+
+/**
+ * @brief Adds the values of any container to a bitmap container.
+ *
+ * The cardinality of the bitmap is not updated.
+ *
+ * @param dst Pointer to the bitmap container.
+ * @param c Pointer to the container to add.
+ */
+static void orIntoBitmap(container *dst, const container *c) {
+    size_t i;
+
+    if(c->type == ARRAY_CONTAINER)
+        for(i = 0; i < c->length; i++)
+            dst->bits[c->values[i] / WORD_BITS] |= (setWord)1 << (c->values[i] % WORD_BITS);
+    else if(c->type == RUN_CONTAINER)
+        for(i = 0; i < c->length; i++)
+            applyRange(dst->bits, c->runs[i].start, c->runs[i].last, ROARING_OR);
+    else
+        for(i = 0; i < CHUNK_WORDS; i++)
+            dst->bits[i] |= c->bits[i];
+}
+
+/**
+ * @brief Computes the union of any number of compressed sets.
+ *
+ * The keys of the inputs are merged through a min-heap, so each chunk is
+ * built once: a chunk held by a single input is copied, and the containers
+ * of a chunk held by several inputs are added into one bitmap that takes
+ * the cheapest type at the end.
+ *
+ * @param sets Array of the sets.
+ * @param len Number of sets.
+ * @return Pointer to the new set holding the union.
+ */
+roaringSet *roaringUnionAll(const roaringSet *sets[], size_t len) {
+    roaringSet *R = newRoaring();
+    mergeCursor *heap = (mergeCursor *)allocMemory(len * sizeof(mergeCursor));
+    size_t i, n = 0, held;
+    const roaringSet *S;
+    chunkValue key;
+    container c;
+
+    for(i = 0; i < len; i++) {
+        if(!sets[i]->count) continue;
+        heap[n].key = sets[i]->keys[0];
+        heap[n].input = i;
+        heap[n].pos = 0;
+        n++;
+    }
+    for(i = n / 2; i-- > 0;)
+        siftDown(heap, n, i);
+
+    while(n) {
+        key = heap[0].key;
+
+        /* Take the container of every input holding the smallest key */
+        for(held = 0; n && heap[0].key == key; held++) {
+            S = sets[heap[0].input];
+            if(!held) c = copyContainer(&S->containers[heap[0].pos]);
+            else {
+                toBitmap(&c);
+                orIntoBitmap(&c, &S->containers[heap[0].pos]);
+            }
+
+            /* Move the cursor to the next container of its input */
+            if(++heap[0].pos < S->count) heap[0].key = S->keys[heap[0].pos];
+            else heap[0] = heap[--n];
+            siftDown(heap, n, 0);
+        }
+
+        if(held > 1) {
+            c.cardinality = countBits(c.bits);
+            optimizeContainer(&c);
+        }
+        insertContainer(R, R->count, key, c);
+    }
+
+    free(heap);
+    return R;
+}
+
+/**
+ * @brief Finds the first key not less than a key, searching forward from a position.
+ *
+ * The step doubles until it passes the key and the last step is searched
+ * by bisection, so the cost grows with the log of the distance covered.
+ *
+ * @param keys Sorted array of keys.
+ * @param n Number of keys.
+ * @param from Position the search starts at.
+ * @param key Key to search for.
+ * @return Index of the key found, or n if all keys from the position are less than it.
+ */
+static size_t gallopKeys(const chunkValue *keys, size_t n, size_t from, unsigned long key) {
+    size_t low = from, step = 1, high;
+
+    while(from + step < n && keys[from + step] < key) {
+        low = from + step;
+        step *= 2;
+    }
+    high = from + step < n ? from + step + 1 : n;
+    return low + lowerBound(keys + low, high - low, key);
+}
+
+/**
+ * @brief Computes the intersection of any number of compressed sets.
+ *
+ * Only the chunks of the input with the fewest containers can be in the
+ * result, the other inputs are searched for them by galloping forward.
+ * A chunk is dropped as soon as its running intersection is empty, and
+ * the search ends once any input has no container left.
+ *
+ * @param sets Array of the sets.
+ * @param len Number of sets.
+ * @return Pointer to the new set holding the intersection, empty if len is 0.
+ */
+roaringSet *roaringIntersectAll(const roaringSet *sets[], size_t len) {
+    roaringSet *R = newRoaring();
+    size_t *pos, i, k, smallest = 0;
+    int exhausted = 0;
+    container c, next;
+
+    for(i = 1; i < len; i++)
+        if(sets[i]->count < sets[smallest]->count) smallest = i;
+    if(!len || !sets[smallest]->count) return R;
+
+    pos = (size_t *)allocMemory(len * sizeof(size_t));
+    memset(pos, 0, len * sizeof(size_t));
+
+    for(k = 0; k < sets[smallest]->count && !exhausted; k++) {
+        /* Check that every input holds the chunk */
+        for(i = 0; i < len; i++) {
+            if(i == smallest) continue;
+            pos[i] = gallopKeys(sets[i]->keys, sets[i]->count, pos[i], sets[smallest]->keys[k]);
+            if(pos[i] == sets[i]->count) exhausted = 1;
+            if(exhausted || sets[i]->keys[pos[i]] != sets[smallest]->keys[k]) break;
+        }
+        if(i < len) continue;
+
+        c = copyContainer(&sets[smallest]->containers[k]);
+        for(i = 0; i < len && c.cardinality; i++) {
+            if(i == smallest) continue;
+            next = combineContainers(&c, &sets[i]->containers[pos[i]], ROARING_AND);
+            freeContainer(&c);
+            c = next;
+        }
+
+        if(c.cardinality) insertContainer(R, R->count, sets[smallest]->keys[k], c);
+        else freeContainer(&c);
+    }
+
+    free(pos);
+    return R;
+}
+
+/**
+ * @brief Computes the number of elements before each container of a compressed set.
+ *
+ * The counts are kept until the set changes, so repeated rank and select
+ * queries only binary search them.
+ *
+ * @param R Pointer to the set.
+ */
+static void buildCounts(roaringSet *R) {
+    size_t i;
+
+    if(R->countsValid) return;
+
+    R->counts = (unsigned long *)resizeMemory(R->counts, (R->count + 1) * sizeof(unsigned long));
+    R->counts[0] = 0;
+    for(i = 0; i < R->count; i++)
+        R->counts[i + 1] = R->counts[i] + R->containers[i].cardinality;
+    R->countsValid = 1;
+}
+
+/**
+ * @brief Counts the elements of a compressed set.
+ *
+ * @param R Pointer to the set.
+ * @return Number of elements.
+ */
+unsigned long roaringCardinality(roaringSet *R) {
+    buildCounts(R);
+    return R->counts[R->count];
+}
+
+/**
+ * @brief Checks whether the counts of a compressed set are up to date.
+ *
+ * @param R Pointer to the set.
+ * @return 1 if counting, rank and select only read the set, 0 if they build its counts first.
+ */
+int roaringCountsReady(const roaringSet *R) {
+    return R->countsValid;
+}
+
+/**
+ * @brief Counts the elements of a compressed set that are not greater than a number.
+ *
+ * @param R Pointer to the set.
+ * @param num The number.
+ * @return Number of elements less than or equal to num.
+ */
+unsigned long roaringRank(roaringSet *R, unsigned long num) {
+    unsigned long key = num >> CHUNK_BITS;
+    size_t i = lowerBound(R->keys, R->count, key);
+
+    buildCounts(R);
+    if(i < R->count && R->keys[i] == key)
+        return R->counts[i] + containerRank(&R->containers[i], num & (CHUNK_SIZE - 1));
+    return R->counts[i];
+}
+
+/**
+ * @brief Finds the element of a compressed set at a position in increasing order.
+ *
+ * @param R Pointer to the set.
+ * @param k Position of the element, starting from 0.
+ * @param num Where the element is stored.
+ * @return 1 if the set has more than k elements, 0 otherwise.
+ */
+int roaringSelect(roaringSet *R, unsigned long k, unsigned long *num) {
+    size_t low = 0, high, mid;
+
+    buildCounts(R);
+    if(k >= R->counts[R->count]) return 0;
+
+    /* Find the last container that starts at or before position k */
+    high = R->count - 1;
+    while(low < high) {
+        mid = low + (high - low + 1) / 2;
+        if(R->counts[mid] <= k) low = mid;
+        else high = mid - 1;
+    }
+
+    *num = ((unsigned long)R->keys[low] << CHUNK_BITS) | containerSelect(&R->containers[low], k - R->counts[low]);
+    return 1;
+}
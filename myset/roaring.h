@@ -0,0 +1,173 @@
+/**
+ * @file roaring.h
+ * @brief Compressed sets for sparse large universes, modeled on Roaring bitmaps.
+ *
+ * The universe is split into chunks of 2^16 elements. Each chunk that holds
+ * at least one element is stored in a container, which is a sorted array,
+ * a bitmap or a list of runs, whichever takes the least memory.
+ */
+
+#ifndef ROARING_H
+#define ROARING_H
+
+#include "set.h"
+
+/**
+ * @brief Structure representing a compressed set.
+ *
+ * The structure is opaque, it is only handled through the functions below.
+ */
+typedef struct roaringSet roaringSet;
+
+/**
+ * @brief Enumeration representing the operations between compressed sets.
+ */
+typedef enum {
+    ROARING_OR,     /**< Union of two sets */
+    ROARING_AND,    /**< Intersection of two sets */
+    ROARING_ANDNOT, /**< Difference of two sets */
+    ROARING_XOR     /**< Symmetric difference of two sets */
+} RoaringOp;
+
+/**
+ * @brief Creates an empty compressed set.
+ *
+ * @return Pointer to the new set.
+ * @note It is the caller's responsibility to release it with freeRoaring.
+ */
+roaringSet *newRoaring(void);
+
+/**
+ * @brief Frees a compressed set and all its containers.
+ *
+ * @param R Pointer to the set, may be NULL.
+ */
+void freeRoaring(roaringSet *R);
+
+/**
+ * @brief Removes all elements of a compressed set.
+ *
+ * @param R Pointer to the set.
+ */
+void roaringClear(roaringSet *R);
+
+/**
+ * @brief Creates a copy of a compressed set.
+ *
+ * @param R Pointer to the set to copy.
+ * @return Pointer to the new set.
+ */
+roaringSet *roaringCopy(const roaringSet *R);
+
+/**
+ * @brief Creates a compressed set from an unsorted array of numbers.
+ *
+ * The numbers are sorted and grouped by chunk, so no chunk is ever stored
+ * as a bitmap unless it holds enough elements to need one.
+ *
+ * @param arr Array of numbers, duplicates are allowed.
+ * @param len Length of the array.
+ * @return Pointer to the new set.
+ */
+roaringSet *roaringFromArray(const unsigned long *arr, size_t len);
+
+/**
+ * @brief Adds a number to a compressed set.
+ *
+ * @param R Pointer to the set.
+ * @param num Number to be added, at most MAX_SET_VALUE.
+ */
+void roaringAdd(roaringSet *R, unsigned long num);
+
+/**
+ * @brief Checks if a number is in a compressed set.
+ *
+ * @param R Pointer to the set.
+ * @param num Number to check.
+ * @return 1 if the number is in the set, 0 otherwise.
+ */
+int roaringContains(const roaringSet *R, unsigned long num);
+
+/**
+ * @brief Finds the smallest element of a compressed set that is not less than a number.
+ *
+ * @param R Pointer to the set.
+ * @param from Number to start from.
+ * @param num Where the element found is stored.
+ * @return 1 if an element was found, 0 otherwise.
+ */
+int roaringNext(const roaringSet *R, unsigned long from, unsigned long *num);
+
+/**
+ * @brief Counts the elements of a compressed set.
+ *
+ * @param R Pointer to the set.
+ * @return Number of elements.
+ */
+unsigned long roaringCardinality(roaringSet *R);
+
+/**
+ * @brief Checks whether the counts of a compressed set are up to date.
+ *
+ * @param R Pointer to the set.
+ * @return 1 if counting, rank and select only read the set, 0 if they build its counts first.
+ */
+int roaringCountsReady(const roaringSet *R);
+
+/**
+ * @brief Counts the elements of a compressed set that are not greater than a number.
+ *
+ * @param R Pointer to the set.
+ * @param num The number.
+ * @return Number of elements less than or equal to num.
+ */
+unsigned long roaringRank(roaringSet *R, unsigned long num);
+
+/**
+ * @brief Finds the element of a compressed set at a position in increasing order.
+ *
+ * @param R Pointer to the set.
+ * @param k Position of the element, starting from 0.
+ * @param num Where the element is stored.
+ * @return 1 if the set has more than k elements, 0 otherwise.
+ */
+int roaringSelect(roaringSet *R, unsigned long k, unsigned long *num);
+
+/**
+ * @brief Combines two compressed sets into a new one.
+ *
+ * Every pair of containers is combined with an algorithm specialized for
+ * their types, and the result container takes the cheapest type.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param op Operation to perform.
+ * @return Pointer to the new set holding A op B.
+ */
+roaringSet *roaringCombine(const roaringSet *A, const roaringSet *B, RoaringOp op);
+
+/**
+ * @brief Computes the union of any number of compressed sets into a new one.
+ *
+ * The keys of all the sets are merged in one pass, and the containers of
+ * a chunk held by several sets are combined together.
+ *
+ * @param sets Array of the sets.
+ * @param len Number of sets.
+ * @return Pointer to the new set holding the union.
+ */
+roaringSet *roaringUnionAll(const roaringSet *sets[], size_t len);
+
+/**
+ * @brief Computes the intersection of any number of compressed sets into a new one.
+ *
+ * The chunks of the smallest set are searched for in the others, and the
+ * search stops early at chunks or sets that leave nothing in common.
+ *
+ * @param sets Array of the sets.
+ * @param len Number of sets.
+ * @return Pointer to the new set holding the intersection, empty if len is 0.
+ */
+roaringSet *roaringIntersectAll(const roaringSet *sets[], size_t len);
+
+#endif /* ROARING_H */
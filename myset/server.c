@@ -0,0 +1,221 @@
+/**
+ * @file server.c
+ * @brief Server running the commands of many local clients on shared sets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+#include "program.h"
+#include "set_utils.h"
+#include "set_kernels.h"
+#include "string_utils.h"
+#include "output_utils.h"
+
+/**
+ * @brief Structure representing a connected client.
+ */
+typedef struct client {
+    int fd;              /**< Socket of the connection */
+    registry *R;         /**< Registry of the named sets */
+    inputStream in;      /**< Commands read from the socket */
+    outputStream out;    /**< Replies written to the socket */
+    struct client *next; /**< Next connected client */
+} client;
+
+static pthread_mutex_t clientsLock = PTHREAD_MUTEX_INITIALIZER; /**< Guards the list of clients */
+static pthread_cond_t clientsDone = PTHREAD_COND_INITIALIZER;   /**< Signaled when the last client leaves */
+static client *clients = NULL;                                  /**< Connected clients */
+static size_t clientCount = 0;                                  /**< Number of connected clients */
+static int wakeFds[2] = { -1, -1 };                             /**< Pipe the signal handler wakes the server with */
+
+/**
+ * @brief Wakes the server up to stop it.
+ *
+ * @param sig The signal received.
+ * @note Any thread may run the handler, so it writes to a pipe the server polls.
+ */
+static void onSignal(int sig) {
+    int saved = errno;
+    ssize_t n;
+
+    /* A full pipe wakes the server as well */
+    n = write(wakeFds[1], "", 1);
+    (void)n;
+    (void)sig;
+    errno = saved;
+}
+
+/**
+ * @brief Main function of a client thread, running a session on its connection.
+ *
+ * @param arg Pointer to the client.
+ * @return Always NULL.
+ */
+static void *clientMain(void *arg) {
+    client *c = (client *)arg, **link;
+
+    bindInput(&c->in, c->fd);
+    bindOutput(&c->out, c->fd);
+
+    boot_program(c->R);
+    flushOutput();
+    bindOutput(NULL, STDOUT_FILENO);
+
+    /* The client leaves the list before its socket is closed, so the server never shuts down a reused descriptor */
+    pthread_mutex_lock(&clientsLock);
+    for(link = &clients; *link != c; link = &(*link)->next);
+    *link = c->next;
+    if(!--clientCount) pthread_cond_signal(&clientsDone);
+    pthread_mutex_unlock(&clientsLock);
+
+    closeInput();
+    free(c);
+    return NULL;
+}
+
+/**
+ * @brief Starts the thread of a new connection.
+ *
+ * @param R Registry of the named sets.
+ * @param fd Socket of the connection.
+ */
+static void startClient(registry *R, int fd) {
+    pthread_attr_t attr;
+    pthread_t thread;
+    client *c = (client *)malloc(sizeof(client));
+
+    if(!c) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    c->fd = fd;
+    c->R = R;
+
+    pthread_mutex_lock(&clientsLock);
+    c->next = clients;
+    clients = c;
+    clientCount++;
+    pthread_mutex_unlock(&clientsLock);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if(pthread_create(&thread, &attr, clientMain, c)) {
+        /* The connection is refused, the client sees its socket closed */
+        pthread_mutex_lock(&clientsLock);
+        clients = c->next;
+        clientCount--;
+        pthread_mutex_unlock(&clientsLock);
+        close(fd);
+        free(c);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+/**
+ * @brief Creates the listening socket.
+ *
+ * @param path Path of the socket.
+ * @return The socket, or -1 if it could not be created (an error is printed).
+ */
+static int openSocket(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if(strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    /* A socket left by a previous server is replaced */
+    unlink(path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, SERVER_BACKLOG)) {
+        fprintf(stderr, "Cannot listen on socket: %s\n", path);
+        if(fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Serves the clients connecting to a Unix domain socket until a signal stops the server.
+ *
+ * @param R Registry of the named sets, shared by every client.
+ * @param path Path of the socket, an existing file there is replaced.
+ * @return 0 if the server stopped on a signal, 1 if the socket could not be created (an error is printed).
+ */
+int serve(registry *R, const char *path) {
+    struct pollfd fds[2];
+    struct sigaction sa;
+    client *c;
+    int listenFd, conn;
+
+    if((listenFd = openSocket(path)) < 0)
+        return 1;
+    if(pipe(wakeFds)) {
+        fprintf(stderr, "Cannot listen on socket: %s\n", path);
+        close(listenFd);
+        unlink(path);
+        return 1;
+    }
+
+    /* A client closing its connection must not kill the server */
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    /* Everything built on first use is built before the clients share it */
+    shareRegistry(R);
+    initCommands();
+    getKernels();
+    setQuiet(1);
+
+    fds[0].fd = listenFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeFds[0];
+    fds[1].events = POLLIN;
+
+    for(;;) {
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        if(fds[1].revents) break;
+        if(!(fds[0].revents & POLLIN)) continue;
+
+        conn = accept(listenFd, NULL, NULL);
+        if(conn >= 0) startClient(R, conn);
+    }
+
+    close(listenFd);
+    unlink(path);
+
+    /* Every session reads the end of its input once its current command is done */
+    pthread_mutex_lock(&clientsLock);
+    for(c = clients; c; c = c->next)
+        shutdown(c->fd, SHUT_RDWR);
+    while(clientCount)
+        pthread_cond_wait(&clientsDone, &clientsLock);
+    pthread_mutex_unlock(&clientsLock);
+
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    return 0;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file server.h
+ * @brief Server running the commands of many local clients on shared sets.
+ *
+ * The server listens on a Unix domain socket and runs a session of the
+ * command language for each connection, on its own thread and over the one
+ * registry of the program. A client writes commands one per line and reads
+ * the replies, without prompts or echoes. The stop command ends the session
+ * of the client, and SIGINT or SIGTERM end the server once the commands
+ * being run are done.
+ *
+ * Commands on the sets run in parallel, the registry locks let any number of
+ * commands read a set while a single one writes it. A read_set command parses
+ * its list before locking its set, so readers only wait for the final swap.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "registry.h"
+
+#define SERVER_BACKLOG 64 /**< Define the number of connections waiting to be accepted */
+
+/**
+ * @brief Serves the clients connecting to a Unix domain socket until a signal stops the server.
+ *
+ * @param R Registry of the named sets, shared by every client.
+ * @param path Path of the socket, an existing file there is replaced.
+ * @return 0 if the server stopped on a signal, 1 if the socket could not be created (an error is printed).
+ */
+int serve(registry *R, const char *path);
+
+#endif /* SERVER_H */
@@ -1,213 +1,1129 @@
-/**
- * @file set.c
- * @brief A collection of functions for set operations.
- */
-
-#include <stdio.h>
-#include "set.h"
-
-/**
- * @brief Retrieves the data array from a set.
- *
- * @param A Pointer to the set.
- * @return Pointer to the data array of the set.
- */
-unsigned char *getData(set *A) {
-    return A->data;
-}
-
-/**
- * @brief Empties a set by setting all its data elements to 0.
- *
- * @param A Pointer to the set to be emptied.
- * @note This function modifies the set in place.
- */
-void emptySet(set *A) {
-    int i;
-
-    /* Iterate over the data array and set each element to 0 */
-    for(i = 0; i < DATA_SIZE; i++)
-        getData(A)[i] = 0;
-}
-
-/**
- * @brief Empties an array of sets by setting all their data elements to 0.
- *
- * @param setArr Array of set pointers to be emptied.
- * @param len Length of the set array.
- * @note This function modifies each set in the array in place.
- */
-
-void emptySetArray(set *setArr[], int len) {
-    int i;
-
-    /* Iterate over each set in the array and empty it */
-    for(i = 0; i < len; i++)
-        emptySet(setArr[i]);
-}
-
-/**
- * @brief Adds a number to a set.
- *
- * @param A Pointer to the set.
- * @param num Number to be added to the set.
- */
-void addToSet(set *A, unsigned char num) {
-    int i = num / BYTE_SIZE;
-    /* Set the bit corresponding to num */
-    getData(A)[i] |= 1 << (num - BYTE_SIZE * i);
-}
-
-/**
- * @brief Checks if a number is in a set.
- *
- * @param A Pointer to the set.
- * @param num Number to check for membership in the set.
- * @return 1 if the number is in the set, 0 otherwise.
- */
-int isInSet(set *A, unsigned char num) {
-    int i = num / BYTE_SIZE;
-    /* Check if the bit corresponding to num is set */
-    return (getData(A)[i] >> (num - BYTE_SIZE * i)) & 1;
-}
-
-/**
- * @brief Reads an array of numbers into a set.
- *
- * @param A Pointer to the set.
- * @param arr Array of numbers to be read into the set.
- * @param len Length of the array.
- * @note This function empties the set before adding new numbers.
- */
-void read_set(set *A, unsigned char *arr, int len) {
-    int i;
-    /* Empty the set before adding new numbers */
-    emptySet(A);
-
-    /* Iterate over the array and add each number to the set */
-    for(i = 0; i < len; i++)
-        addToSet(A, arr[i]);
-
-}
-
-/**
- * @brief Prints the contents of a set.
- *
- * @param A Pointer to the set.
- * @note This function prints the set in a specified format.
- */
-void print_set(set *A) {
-    int i, count = 0, newRow = 1;
-
-    /* Iterate over all possible numbers in the set */
-    for(i = 0; i < SET_SIZE; i++) {
-        /* Check if the number is in the set */
-        if(isInSet(A, i)) {
-            /* If this is the first number found, print the header */
-            if(!count) printf("The set is:\n");
-            count++;
-
-            /* handle formatting for new row and commas */
-            if(newRow)
-                /* Print the first number in the new row */
-                printf("%d", i);
-            else {
-                /* Print subsequent numbers with a preceding comma */
-                printf(", %d", i);
-
-                /* Check if the current row has reached the maximum size */
-                if(!(count % ROW_SIZE)) {
-                    /* Move to the next line */
-                    printf("\n");
-                    /* Mark the start of a new row */
-                    newRow = 1;
-                    continue;
-                }
-            }
-            /* Reset the newRow flag as we've printed a number */
-            newRow = 0;
-        }
-    }
-    /* If no numbers were found in the set, indicate that the set is empty */
-    if(!count)
-        printf("The set is empty\n");
-    /* Ensure the last line of numbers ends correctly */
-    else if(!newRow)
-        printf("\n");
-}
-
-/**
- * @brief Computes the union of two sets and stores the result in a third set.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the set to store the union result.
- * @note This function modifies the result set in place.
- */
-void union_set(set *A, set *B, set *C) {
-    int i;
-    /* Empty the result set before computing the union */
-    emptySet(C);
-
-    /* Iterate over all possible numbers and add them to the result set if they are in either A or B */
-    for(i = 0; i < SET_SIZE; i++)
-        if(isInSet(A, i) || isInSet(B, i))
-            addToSet(C, i);
-}
-
-/**
- * @brief Computes the intersection of two sets and stores the result in a third set.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the set to store the intersection result.
- * @note This function modifies the result set in place.
- */
-void intersect_set(set *A, set *B, set *C) {
-    int i;
-    /* Empty the result set before computing the intersection */
-    emptySet(C);
-
-    /* Iterate over all possible numbers and add them to the result set if they are in both A and B */
-    for(i = 0; i < SET_SIZE; i++)
-        if(isInSet(A, i) && isInSet(B, i))
-            addToSet(C, i);
-}
-
-/**
- * @brief Computes the difference of two sets (A \ B) and stores the result in a third set.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the set to store the difference result.
- * @note This function modifies the result set in place.
- */
-void sub_set(set *A, set *B, set *C) {
-    int i;
-    /* Empty the result set before computing the difference */
-    emptySet(C);
-
-    /* Iterate over all possible numbers and add them to the result set if they are in A but not in B */
-    for(i = 0; i < SET_SIZE; i++)
-        if(isInSet(A, i) && !isInSet(B, i))
-            addToSet(C, i);
-}
-
-/**
- * @brief Computes the symmetric difference of two sets and stores the result in a third set.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the set to store the symmetric difference result.
- * @note This function modifies the result set in place.
- */
-void symdiff_set(set *A, set *B, set *C) {
-    int i;
-    /* Empty the result set before computing the symmetric difference */
-    emptySet(C);
-
-    /* Iterate over all possible numbers and add them to the result set if they are in either A or B but not both */
-    for(i = 0; i < SET_SIZE; i++)
-        if(isInSet(A, i) ^ isInSet(B, i))
-            addToSet(C, i);
-}
\ No newline at end of file
+/**
+ * @file set.c
+ * @brief A collection of functions for set operations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "set.h"
+#include "set_kernels.h"
+#include "worker_pool.h"
+#include "roaring.h"
+#include "bit_utils.h"
+#include "output_utils.h"
+
+#define LINE_WORDS (SET_ALIGN / sizeof(setWord)) /**< Number of words in one aligned block */
+#define COUNT_BLOCK_WORDS 16 /**< Number of words covered by each cumulative count */
+#define COUNT_MIN_WORDS 64   /**< Smallest data array for which cumulative counts are kept */
+
+/**
+ * @brief Allocates memory, exiting the program if the allocation fails.
+ *
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the allocated memory.
+ */
+static void *allocMemory(size_t size) {
+    void *ptr = malloc(size ? size : 1);
+
+    if(!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Computes the number of words needed to hold the elements 0 to num.
+ *
+ * @param num Largest element to hold.
+ * @return Number of words.
+ */
+static size_t wordsFor(unsigned long num) {
+    return num / WORD_BITS + 1;
+}
+
+/**
+ * @brief Replaces the data array of a set with a larger aligned one.
+ *
+ * The current contents are kept and the new words are set to 0.
+ *
+ * @param A Pointer to the set.
+ * @param words Number of words the data array must hold at least.
+ */
+static void growSet(set *A, size_t words) {
+    size_t limit = wordsFor(A->maxValue), size = A->words * 2;
+    char *block;
+    setWord *data;
+
+    /* Grow geometrically in whole aligned blocks, but not past the universe */
+    if(size < words) size = words;
+    size = (size + LINE_WORDS - 1) / LINE_WORDS * LINE_WORDS;
+    if(size > limit) size = limit > words ? limit : words;
+
+    /* Allocate enough extra bytes to align the data array */
+    block = (char *)malloc(size * sizeof(setWord) + SET_ALIGN - 1);
+    if(!block) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    data = (setWord *)(block + (SET_ALIGN - (size_t)block % SET_ALIGN) % SET_ALIGN);
+
+    /* Move the current contents and clear the rest */
+    if(A->words) memcpy(data, A->data, A->words * sizeof(setWord));
+    memset(data + A->words, 0, (size - A->words) * sizeof(setWord));
+
+    free(A->block);
+    A->block = block;
+    A->data = data;
+    A->words = size;
+    A->countsValid = 0;
+}
+
+/**
+ * @brief Makes sure the data array of a set holds at least a number of words.
+ *
+ * @param A Pointer to the set.
+ * @param words Number of words needed.
+ */
+static void reserveWords(set *A, size_t words) {
+    if(words > A->words)
+        growSet(A, words);
+}
+
+/**
+ * @brief Initializes an empty set over the universe 0 to maxValue.
+ *
+ * @param A Pointer to the set.
+ * @param maxValue Largest element of the universe, at most MAX_SET_VALUE.
+ * @param kind Representation of the set.
+ * @note This function dynamically allocates memory for the set.
+ *       It is the caller's responsibility to release it with freeSet.
+ */
+void initSet(set *A, unsigned long maxValue, SetKind kind) {
+    A->kind = kind;
+    A->data = NULL;
+    A->block = NULL;
+    A->words = 0;
+    A->maxValue = maxValue;
+    A->sparse = NULL;
+    A->counts = NULL;
+    A->countBlocks = 0;
+    A->countsValid = 0;
+
+    /* A bitmap starts with a single aligned block, or the whole universe if it is smaller */
+    if(kind == SET_ROARING) A->sparse = newRoaring();
+    else growSet(A, 1);
+}
+
+/**
+ * @brief Frees the memory held by a set.
+ *
+ * @param A Pointer to the set.
+ */
+void freeSet(set *A) {
+    freeRoaring(A->sparse);
+    A->sparse = NULL;
+    free(A->counts);
+    A->counts = NULL;
+    A->countsValid = 0;
+    free(A->block);
+    A->block = NULL;
+    A->data = NULL;
+    A->words = 0;
+}
+
+/**
+ * @brief Exchanges the contents of two sets in constant time.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ */
+void swapSets(set *A, set *B) {
+    set tmp = *A;
+    *A = *B;
+    *B = tmp;
+}
+
+/**
+ * @brief Retrieves the data array from a set.
+ *
+ * @param A Pointer to the set.
+ * @return Pointer to the data array of the set, NULL for a roaring set.
+ */
+setWord *getData(set *A) {
+    return A->data;
+}
+
+/**
+ * @brief Retrieves the representation of a set.
+ *
+ * @param A Pointer to the set.
+ * @return The representation of the set.
+ */
+SetKind getKind(set *A) {
+    return A->kind;
+}
+
+/**
+ * @brief Retrieves the largest element of the universe of a set.
+ *
+ * @param A Pointer to the set.
+ * @return The largest element the set may hold.
+ */
+unsigned long getMaxValue(set *A) {
+    return A->maxValue;
+}
+
+/**
+ * @brief Retrieves the number of words in the data array of a set.
+ *
+ * @param A Pointer to the set.
+ * @return Number of words in the data array, 0 for a roaring set.
+ */
+size_t getWordCount(set *A) {
+    return A->words;
+}
+
+/**
+ * @brief Empties a set by setting all its data elements to 0.
+ *
+ * @param A Pointer to the set to be emptied.
+ * @note This function modifies the set in place.
+ */
+void emptySet(set *A) {
+    if(A->kind == SET_ROARING) {
+        roaringClear(A->sparse);
+        return;
+    }
+
+    /* Set each word of the data array to 0, the array keeps its size */
+    memset(getData(A), 0, getWordCount(A) * sizeof(setWord));
+    A->countsValid = 0;
+}
+
+/**
+ * @brief Empties an array of sets by setting all their data elements to 0.
+ *
+ * @param setArr Array of set pointers to be emptied.
+ * @param len Length of the set array.
+ * @note This function modifies each set in the array in place.
+ */
+
+void emptySetArray(set *setArr[], int len) {
+    int i;
+
+    /* Iterate over each set in the array and empty it */
+    for(i = 0; i < len; i++)
+        emptySet(setArr[i]);
+}
+
+/**
+ * @brief Makes a bitmap set use a data array it does not own.
+ *
+ * The array is never freed by the set. It is written in place, and copied
+ * into an array of the set's own the first time the set grows.
+ *
+ * @param A Pointer to the set, a bitmap.
+ * @param data The words, aligned to SET_ALIGN bytes.
+ * @param words Number of words, from 1 to the number covering the universe.
+ */
+void adoptWords(set *A, setWord *data, size_t words) {
+    free(A->block);
+    A->block = NULL;
+    A->data = data;
+    A->words = words;
+    A->countsValid = 0;
+}
+
+/**
+ * @brief Grows the data array of a bitmap set to cover its whole universe.
+ *
+ * The data array of a set with a reserved universe never moves again, so
+ * its words can be updated in place by several threads.
+ *
+ * @param A Pointer to the set.
+ */
+void reserveUniverse(set *A) {
+    if(A->kind == SET_BITMAP)
+        reserveWords(A, wordsFor(A->maxValue));
+}
+
+/**
+ * @brief Adds a number to a set.
+ *
+ * @param A Pointer to the set.
+ * @param num Number to be added to the set.
+ * @note The data array grows if num is beyond its current end.
+ */
+void addToSet(set *A, unsigned long num) {
+    size_t i = num / WORD_BITS;
+
+    if(A->kind == SET_ROARING) {
+        roaringAdd(A->sparse, num);
+        return;
+    }
+    reserveWords(A, i + 1);
+    /* Set the bit corresponding to num */
+    getData(A)[i] |= (setWord)1 << (num - WORD_BITS * i);
+    A->countsValid = 0;
+}
+
+/**
+ * @brief Checks if a number is in a set.
+ *
+ * @param A Pointer to the set.
+ * @param num Number to check for membership in the set.
+ * @return 1 if the number is in the set, 0 otherwise.
+ */
+int isInSet(set *A, unsigned long num) {
+    size_t i = num / WORD_BITS;
+
+    if(A->kind == SET_ROARING) return roaringContains(A->sparse, num);
+    /* Numbers beyond the data array are never in the set */
+    if(i >= getWordCount(A)) return 0;
+    /* Check if the bit corresponding to num is set */
+    return (int)((getData(A)[i] >> (num - WORD_BITS * i)) & 1);
+}
+
+/**
+ * @brief Computes the number of elements before each block of words of a bitmap set.
+ *
+ * The counts are kept until the set changes, so repeated rank and select
+ * queries on large sets only scan a single block.
+ *
+ * @param A Pointer to the set.
+ */
+static void buildCounts(set *A) {
+    size_t blocks = (getWordCount(A) + COUNT_BLOCK_WORDS - 1) / COUNT_BLOCK_WORDS, i;
+    unsigned long total = 0;
+    unsigned long *counts;
+
+    if(A->countsValid) return;
+
+    if(blocks != A->countBlocks || !A->counts) {
+        counts = (unsigned long *)realloc(A->counts, (blocks + 1) * sizeof(unsigned long));
+        if(!counts) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        A->counts = counts;
+        A->countBlocks = blocks;
+    }
+
+    for(i = 0; i < getWordCount(A); i++) {
+        if(!(i % COUNT_BLOCK_WORDS)) A->counts[i / COUNT_BLOCK_WORDS] = total;
+        total += popcountWord(getData(A)[i]);
+    }
+    A->counts[blocks] = total;
+    A->countsValid = 1;
+}
+
+/**
+ * @brief Counts the elements in the first words of a bitmap set.
+ *
+ * @param A Pointer to the set.
+ * @param words Number of words to count, at most the size of the data array.
+ * @return Number of elements in those words.
+ */
+static unsigned long countWords(set *A, size_t words) {
+    unsigned long count = 0;
+    size_t i = 0;
+
+    /* Large sets start from the count of the enclosing block */
+    if(getWordCount(A) >= COUNT_MIN_WORDS) {
+        buildCounts(A);
+        i = words / COUNT_BLOCK_WORDS * COUNT_BLOCK_WORDS;
+        count = A->counts[words / COUNT_BLOCK_WORDS];
+    }
+
+    for(; i < words; i++)
+        count += popcountWord(getData(A)[i]);
+    return count;
+}
+
+/**
+ * @brief Counts the elements of a set.
+ *
+ * @param A Pointer to the set.
+ * @return Number of elements in the set.
+ */
+unsigned long countSet(set *A) {
+    if(A->kind == SET_ROARING) return roaringCardinality(A->sparse);
+    return countWords(A, getWordCount(A));
+}
+
+/**
+ * @brief Counts the elements of a set that are not greater than a number.
+ *
+ * @param A Pointer to the set.
+ * @param num The number.
+ * @return Number of elements less than or equal to num.
+ */
+unsigned long rankInSet(set *A, unsigned long num) {
+    size_t i = num / WORD_BITS;
+
+    if(A->kind == SET_ROARING) return roaringRank(A->sparse, num);
+    if(i >= getWordCount(A)) return countSet(A);
+
+    /* Count the whole words before num, then the bits up to num in its word */
+    return countWords(A, i) + popcountWord(getData(A)[i] & (~(setWord)0 >> (WORD_BITS - 1 - num % WORD_BITS)));
+}
+
+/**
+ * @brief Finds the k-th smallest element of a set.
+ *
+ * @param A Pointer to the set.
+ * @param k Position of the element, starting from 1.
+ * @param num Where the element is stored.
+ * @return 1 if the set has an element at position k, 0 otherwise.
+ */
+int selectInSet(set *A, unsigned long k, unsigned long *num) {
+    size_t i = 0, low = 0, high;
+
+    if(!k) return 0;
+    if(A->kind == SET_ROARING) return roaringSelect(A->sparse, k - 1, num);
+    if(k > countSet(A)) return 0;
+    k--;
+
+    /* Large sets skip to the last block that starts at or before position k */
+    if(getWordCount(A) >= COUNT_MIN_WORDS) {
+        high = A->countBlocks - 1;
+        while(low < high) {
+            i = low + (high - low + 1) / 2;
+            if(A->counts[i] <= k) low = i;
+            else high = i - 1;
+        }
+        k -= A->counts[low];
+        i = low * COUNT_BLOCK_WORDS;
+    }
+
+    /* Skip whole words, then find the bit within the word */
+    for(; popcountWord(getData(A)[i]) <= k; i++)
+        k -= popcountWord(getData(A)[i]);
+    *num = i * WORD_BITS + selectBit(getData(A)[i], k);
+    return 1;
+}
+
+/**
+ * @brief Checks whether counting the elements of a set only reads it.
+ *
+ * Counting, rank and select build cached counts on large sets, which writes
+ * to the set, so a thread holding the set shared must check this first.
+ *
+ * @param A Pointer to the set.
+ * @return 1 if the counts are built or not used, 0 otherwise.
+ */
+int countsReady(set *A) {
+    if(A->kind == SET_ROARING) return roaringCountsReady(A->sparse);
+    return getWordCount(A) < COUNT_MIN_WORDS || A->countsValid;
+}
+
+/**
+ * @brief Reads an array of numbers into a set.
+ *
+ * @param A Pointer to the set.
+ * @param arr Array of numbers to be read into the set.
+ * @param len Length of the array.
+ * @note This function empties the set before adding new numbers.
+ */
+void read_set(set *A, unsigned long *arr, int len) {
+    int i;
+
+    /* A roaring set is rebuilt from the sorted numbers, one container per chunk */
+    if(A->kind == SET_ROARING) {
+        freeRoaring(A->sparse);
+        A->sparse = roaringFromArray(arr, (size_t)len);
+        return;
+    }
+
+    /* Empty the set before adding new numbers */
+    emptySet(A);
+
+    /* Iterate over the array and add each number to the set */
+    for(i = 0; i < len; i++)
+        addToSet(A, arr[i]);
+
+}
+
+/**
+ * @brief Finds the smallest element of a set that is not less than a number.
+ *
+ * @param A Pointer to the set.
+ * @param from Number to start from.
+ * @param num Where the element found is stored.
+ * @return 1 if an element was found, 0 otherwise.
+ */
+static int nextMember(set *A, unsigned long from, unsigned long *num) {
+    if(A->kind == SET_ROARING) return roaringNext(A->sparse, from, num);
+    return nextSetBit(getData(A), getWordCount(A), from, num);
+}
+
+/**
+ * @brief Finds the smallest element of a set.
+ *
+ * @param A Pointer to the set.
+ * @param num Where the element is stored.
+ * @return 1 if the set is not empty, 0 otherwise.
+ */
+int firstInSet(set *A, unsigned long *num) {
+    return nextMember(A, 0, num);
+}
+
+/**
+ * @brief Advances to the next element of a set.
+ *
+ * @param A Pointer to the set.
+ * @param num The current element, replaced by the smallest element greater than it.
+ * @return 1 if such an element exists, 0 otherwise (num is left unchanged).
+ */
+int nextInSet(set *A, unsigned long *num) {
+    /* Nothing follows the largest element of the largest universe */
+    return *num < MAX_SET_VALUE && nextMember(A, *num + 1, num);
+}
+
+/**
+ * @brief Prints the contents of a set.
+ *
+ * @param A Pointer to the set.
+ * @note This function prints the set in a specified format.
+ */
+void print_set(set *A) {
+    unsigned long i;
+    int found, count = 0, newRow = 1;
+
+    /* Iterate over the numbers in the set */
+    for(found = firstInSet(A, &i); found; found = nextInSet(A, &i)) {
+        /* If this is the first number found, print the header */
+        if(!count) writeStr("The set is:\n");
+        count++;
+
+        /* handle formatting for new row and commas */
+        if(newRow)
+            /* Print the first number in the new row */
+            writeNum(i);
+        else {
+            /* Print subsequent numbers with a preceding comma */
+            writeStr(", ");
+            writeNum(i);
+
+            /* Check if the current row has reached the maximum size */
+            if(!(count % ROW_SIZE)) {
+                /* Move to the next line */
+                writeStr("\n");
+                /* Mark the start of a new row */
+                newRow = 1;
+                continue;
+            }
+        }
+        /* Reset the newRow flag as we've printed a number */
+        newRow = 0;
+    }
+    /* If no numbers were found in the set, indicate that the set is empty */
+    if(!count)
+        writeStr("The set is empty\n");
+    /* Ensure the last line of numbers ends correctly */
+    else if(!newRow)
+        writeStr("\n");
+}
+
+/**
+ * @brief Prints the number of elements of a set.
+ *
+ * @param A Pointer to the set.
+ */
+void size_set(set *A) {
+    writeStr("The set size is ");
+    writeNum(countSet(A));
+    writeChar('\n');
+}
+
+/**
+ * @brief Prints the number of elements of a set that are not greater than a number.
+ *
+ * @param A Pointer to the set.
+ * @param num The number.
+ */
+void rank_set(set *A, unsigned long num) {
+    writeStr("The rank of ");
+    writeNum(num);
+    writeStr(" is ");
+    writeNum(rankInSet(A, num));
+    writeChar('\n');
+}
+
+/**
+ * @brief Prints the k-th smallest element of a set.
+ *
+ * @param A Pointer to the set.
+ * @param k Position of the element, starting from 1.
+ */
+void select_set(set *A, unsigned long k) {
+    unsigned long num;
+
+    if(selectInSet(A, k, &num)) {
+        writeStr("The element at position ");
+        writeNum(k);
+        writeStr(" is ");
+        writeNum(num);
+    }
+    else {
+        writeStr("The set has no element at position ");
+        writeNum(k);
+    }
+    writeChar('\n');
+}
+
+/**
+ * @brief Copies the contents of one set into another.
+ *
+ * @param A Pointer to the set to copy.
+ * @param C Pointer to the destination set, of any representation.
+ */
+void copySet(set *A, set *C) {
+    size_t n = getWordCount(A);
+    unsigned long i;
+    int found;
+
+    if(A->kind == SET_ROARING && C->kind == SET_ROARING) {
+        freeRoaring(C->sparse);
+        C->sparse = roaringCopy(A->sparse);
+    }
+    else if(A->kind == SET_BITMAP && C->kind == SET_BITMAP) {
+        reserveWords(C, n);
+        memcpy(getData(C), getData(A), n * sizeof(setWord));
+        memset(getData(C) + n, 0, (getWordCount(C) - n) * sizeof(setWord));
+        C->countsValid = 0;
+    }
+    else {
+        /* Different representations, add the elements one by one in increasing order */
+        emptySet(C);
+        for(found = firstInSet(A, &i); found; found = nextInSet(A, &i))
+            addToSet(C, i);
+    }
+}
+
+/**
+ * @brief Returns an operand in the representation needed by an operation.
+ *
+ * @param A Pointer to the operand.
+ * @param tmp Pointer to a set used when A must be converted.
+ * @param kind Representation needed.
+ * @return A itself if it already has the representation, tmp holding a copy of it otherwise.
+ * @note If tmp is returned, it is the caller's responsibility to free it with freeSet.
+ */
+static set *matchKind(set *A, set *tmp, SetKind kind) {
+    if(A->kind == kind) return A;
+
+    initSet(tmp, A->maxValue, kind);
+    copySet(A, tmp);
+    return tmp;
+}
+
+/**
+ * @brief Replaces the containers of a roaring set with A op B.
+ *
+ * @param A Pointer to the first operand, of any representation.
+ * @param B Pointer to the second operand, of any representation.
+ * @param C Pointer to the roaring set receiving the result.
+ * @param op The operation.
+ */
+static void combineRoaring(set *A, set *B, set *C, RoaringOp op) {
+    set tmpA, tmpB;
+    set *a = matchKind(A, &tmpA, SET_ROARING), *b = matchKind(B, &tmpB, SET_ROARING);
+    roaringSet *result = roaringCombine(a->sparse, b->sparse, op);
+
+    freeRoaring(C->sparse);
+    C->sparse = result;
+
+    if(a == &tmpA) freeSet(&tmpA);
+    if(b == &tmpB) freeSet(&tmpB);
+}
+
+/**
+ * @brief Applies a word kernel to two sets of possibly different sizes.
+ *
+ * The kernel combines the words both sets have. Beyond the shorter set,
+ * the words of the longer one are copied when keepTail is set for it and
+ * dropped otherwise, which is what each operation does with an empty word.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the result set, distinct from A and B.
+ * @param kernel Kernel computing the common words.
+ * @param keepTailA 1 if the words of A past the end of B belong to the result.
+ * @param keepTailB 1 if the words of B past the end of A belong to the result.
+ */
+static void applyKernel(set *A, set *B, set *C, wordKernel kernel, int keepTailA, int keepTailB) {
+    set tmpA, tmpB;
+    size_t nA, nB, common, n;
+
+    /* Bring roaring operands to the representation of the result */
+    A = matchKind(A, &tmpA, SET_BITMAP);
+    B = matchKind(B, &tmpB, SET_BITMAP);
+    nA = getWordCount(A);
+    nB = getWordCount(B);
+    common = nA < nB ? nA : nB;
+    n = common;
+
+    if(nA > common && keepTailA) n = nA;
+    if(nB > common && keepTailB) n = nB;
+    reserveWords(C, n);
+
+    runKernel(kernel, getData(C), getData(A), getData(B), common);
+    if(n > common)
+        memcpy(getData(C) + common, (nA > nB ? getData(A) : getData(B)) + common, (n - common) * sizeof(setWord));
+    memset(getData(C) + n, 0, (getWordCount(C) - n) * sizeof(setWord));
+    C->countsValid = 0;
+
+    if(A == &tmpA) freeSet(&tmpA);
+    if(B == &tmpB) freeSet(&tmpB);
+}
+
+/*
+ * The result set is emptied before a binary operation is computed, so an
+ * operand that is the result set itself takes part in the operation as an
+ * empty set. Those cases reduce to emptying or copying, and only operations
+ * on distinct sets reach the word kernels, or the container algorithms when
+ * the result is a roaring set.
+ */
+
+/**
+ * @brief Computes the union of two sets and stores the result in a third set.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the set to store the union result.
+ * @note This function modifies the result set in place.
+ *       C may alias A or B, in which case that operand is read as empty.
+ */
+void union_set(set *A, set *B, set *C) {
+    if(A == C && B == C) emptySet(C);
+    else if(A == C) copySet(B, C);
+    else if(B == C) copySet(A, C);
+    else if(C->kind == SET_ROARING) combineRoaring(A, B, C, ROARING_OR);
+    else applyKernel(A, B, C, getKernels()->orWords, 1, 1);
+}
+
+/**
+ * @brief Computes the intersection of two sets and stores the result in a third set.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the set to store the intersection result.
+ * @note This function modifies the result set in place.
+ *       C may alias A or B, in which case that operand is read as empty.
+ */
+void intersect_set(set *A, set *B, set *C) {
+    if(A == C || B == C) emptySet(C);
+    else if(C->kind == SET_ROARING) combineRoaring(A, B, C, ROARING_AND);
+    else applyKernel(A, B, C, getKernels()->andWords, 0, 0);
+}
+
+/**
+ * @brief Computes the difference of two sets (A \ B) and stores the result in a third set.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the set to store the difference result.
+ * @note This function modifies the result set in place.
+ *       C may alias A or B, in which case that operand is read as empty.
+ */
+void sub_set(set *A, set *B, set *C) {
+    if(A == C) emptySet(C);
+    else if(B == C) copySet(A, C);
+    else if(C->kind == SET_ROARING) combineRoaring(A, B, C, ROARING_ANDNOT);
+    else applyKernel(A, B, C, getKernels()->andNotWords, 1, 0);
+}
+
+/**
+ * @brief Computes the symmetric difference of two sets and stores the result in a third set.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the set to store the symmetric difference result.
+ * @note This function modifies the result set in place.
+ *       C may alias A or B, in which case that operand is read as empty.
+ */
+void symdiff_set(set *A, set *B, set *C) {
+    if(A == C && B == C) emptySet(C);
+    else if(A == C) copySet(B, C);
+    else if(B == C) copySet(A, C);
+    else if(C->kind == SET_ROARING) combineRoaring(A, B, C, ROARING_XOR);
+    else applyKernel(A, B, C, getKernels()->xorWords, 1, 1);
+}
+
+/**
+ * @brief Checks whether a block of words is all zero.
+ *
+ * @param words Pointer to the block.
+ * @param n Number of words in the block.
+ * @return 1 if every word is 0, 0 otherwise.
+ */
+static int isZeroBlock(const setWord *words, size_t n) {
+    size_t i;
+
+    for(i = 0; i < n; i++)
+        if(words[i]) return 0;
+    return 1;
+}
+
+/**
+ * @brief Computes the union of bitmap sets in one sweep over their words.
+ *
+ * The words are processed EXPR_BLOCK_WORDS at a time, so each block of the
+ * result stays in cache while every set is added to it.
+ *
+ * @param inputs Array of the bitmap sets.
+ * @param len Number of sets.
+ * @param C Pointer to the bitmap set receiving the union, distinct from every input.
+ */
+static void unionWords(set *inputs[], int len, set *C) {
+    const kernelTable *kernels = getKernels();
+    size_t i, m, n = 0, have;
+    setWord *dst;
+    int k;
+
+    for(k = 0; k < len; k++)
+        if(getWordCount(inputs[k]) > n) n = getWordCount(inputs[k]);
+    reserveWords(C, n);
+
+    for(i = 0; i < n; i += m) {
+        m = n - i < EXPR_BLOCK_WORDS ? n - i : EXPR_BLOCK_WORDS;
+        dst = getData(C) + i;
+        memset(dst, 0, m * sizeof(setWord));
+
+        /* A set holds nothing past its own end */
+        for(k = 0; k < len; k++) {
+            have = getWordCount(inputs[k]) > i ? getWordCount(inputs[k]) - i : 0;
+            if(have) kernels->orWords(dst, dst, getData(inputs[k]) + i, have < m ? have : m);
+        }
+    }
+
+    memset(getData(C) + n, 0, (getWordCount(C) - n) * sizeof(setWord));
+    C->countsValid = 0;
+}
+
+/**
+ * @brief Computes the intersection of bitmap sets in one sweep over their words.
+ *
+ * The words are processed EXPR_BLOCK_WORDS at a time, and the remaining sets
+ * are skipped for a block as soon as its running intersection is empty.
+ *
+ * @param inputs Array of the bitmap sets, at least one.
+ * @param len Number of sets.
+ * @param C Pointer to the bitmap set receiving the intersection, distinct from every input.
+ */
+static void intersectWords(set *inputs[], int len, set *C) {
+    const kernelTable *kernels = getKernels();
+    size_t i, m, n = getWordCount(inputs[0]);
+    setWord *dst;
+    int k;
+
+    /* The intersection ends with the shortest set */
+    for(k = 1; k < len; k++)
+        if(getWordCount(inputs[k]) < n) n = getWordCount(inputs[k]);
+    reserveWords(C, n);
+
+    for(i = 0; i < n; i += m) {
+        m = n - i < EXPR_BLOCK_WORDS ? n - i : EXPR_BLOCK_WORDS;
+        dst = getData(C) + i;
+        memcpy(dst, getData(inputs[0]) + i, m * sizeof(setWord));
+
+        for(k = 1; k < len && !isZeroBlock(dst, m); k++)
+            kernels->andWords(dst, dst, getData(inputs[k]) + i, m);
+    }
+
+    memset(getData(C) + n, 0, (getWordCount(C) - n) * sizeof(setWord));
+    C->countsValid = 0;
+}
+
+/**
+ * @brief Computes the union or intersection of any number of sets.
+ *
+ * @param setArr Array of the sets.
+ * @param len Number of sets.
+ * @param C Pointer to the set to store the result, it may be one of the sets.
+ * @param op ROARING_OR for the union, ROARING_AND for the intersection.
+ */
+static void combineAll(set *setArr[], int len, set *C, RoaringOp op) {
+    set *tmp, **inputs, result, *dst = C;
+    const roaringSet **sparse;
+    roaringSet *combined;
+    int k;
+
+    if(len <= 0) {
+        emptySet(C);
+        return;
+    }
+
+    /* Bring every set to the representation of the result */
+    tmp = (set *)allocMemory(len * sizeof(set));
+    inputs = (set **)allocMemory(len * sizeof(set *));
+    for(k = 0; k < len; k++)
+        inputs[k] = matchKind(setArr[k], &tmp[k], C->kind);
+
+    if(C->kind == SET_ROARING) {
+        /* The containers of the result are new, so C may be read while they are built */
+        sparse = (const roaringSet **)allocMemory(len * sizeof(roaringSet *));
+        for(k = 0; k < len; k++)
+            sparse[k] = inputs[k]->sparse;
+        combined = op == ROARING_OR ? roaringUnionAll(sparse, len) : roaringIntersectAll(sparse, len);
+        freeRoaring(C->sparse);
+        C->sparse = combined;
+        free(sparse);
+    }
+    else {
+        /* A bitmap result that is also an input is computed aside and swapped in */
+        for(k = 0; k < len && setArr[k] != C; k++);
+        if(k < len) {
+            initSet(&result, C->maxValue, SET_BITMAP);
+            dst = &result;
+        }
+
+        if(op == ROARING_OR) unionWords(inputs, len, dst);
+        else intersectWords(inputs, len, dst);
+
+        if(dst == &result) {
+            swapSets(C, &result);
+            freeSet(&result);
+        }
+    }
+
+    for(k = 0; k < len; k++)
+        if(inputs[k] == &tmp[k]) freeSet(&tmp[k]);
+    free(inputs);
+    free(tmp);
+}
+
+/**
+ * @brief Computes the union of any number of sets and stores the result in a set.
+ *
+ * @param setArr Array of the sets.
+ * @param len Number of sets.
+ * @param C Pointer to the set to store the union result.
+ * @note Unlike union_set, C may be one of the sets and is read with its current contents.
+ */
+void union_all(set *setArr[], int len, set *C) {
+    combineAll(setArr, len, C, ROARING_OR);
+}
+
+/**
+ * @brief Computes the intersection of any number of sets and stores the result in a set.
+ *
+ * @param setArr Array of the sets.
+ * @param len Number of sets.
+ * @param C Pointer to the set to store the intersection result, emptied if len is 0.
+ * @note Unlike intersect_set, C may be one of the sets and is read with its current contents.
+ */
+void intersect_all(set *setArr[], int len, set *C) {
+    combineAll(setArr, len, C, ROARING_AND);
+}
+
+/**
+ * @brief Adds every element of B to A (A |= B).
+ *
+ * @param A Pointer to the set to be modified.
+ * @param B Pointer to the set to add.
+ */
+void unionInPlace(set *A, set *B) {
+    set tmp;
+    size_t n;
+
+    if(A->kind == SET_ROARING) {
+        combineRoaring(A, B, A, ROARING_OR);
+        return;
+    }
+    B = matchKind(B, &tmp, SET_BITMAP);
+    n = getWordCount(B);
+
+    reserveWords(A, n);
+    runKernel(getKernels()->orWords, getData(A), getData(A), getData(B), n);
+    A->countsValid = 0;
+    if(B == &tmp) freeSet(&tmp);
+}
+
+/**
+ * @brief Keeps only the elements of A that are also in B (A &= B).
+ *
+ * @param A Pointer to the set to be modified.
+ * @param B Pointer to the set to intersect with.
+ */
+void intersectInPlace(set *A, set *B) {
+    set tmp;
+    size_t nA, nB;
+
+    if(A->kind == SET_ROARING) {
+        combineRoaring(A, B, A, ROARING_AND);
+        return;
+    }
+    B = matchKind(B, &tmp, SET_BITMAP);
+    nA = getWordCount(A);
+    nB = getWordCount(B);
+
+    if(nA > nB) {
+        /* B holds nothing past its own end */
+        memset(getData(A) + nB, 0, (nA - nB) * sizeof(setWord));
+        nA = nB;
+    }
+    runKernel(getKernels()->andWords, getData(A), getData(A), getData(B), nA);
+    A->countsValid = 0;
+    if(B == &tmp) freeSet(&tmp);
+}
+
+/**
+ * @brief Removes every element of B from A (A &= ~B).
+ *
+ * @param A Pointer to the set to be modified.
+ * @param B Pointer to the set to subtract.
+ */
+void subInPlace(set *A, set *B) {
+    set tmp;
+    size_t nA, nB;
+
+    if(A->kind == SET_ROARING) {
+        combineRoaring(A, B, A, ROARING_ANDNOT);
+        return;
+    }
+    B = matchKind(B, &tmp, SET_BITMAP);
+    nA = getWordCount(A);
+    nB = getWordCount(B);
+
+    runKernel(getKernels()->andNotWords, getData(A), getData(A), getData(B), nA < nB ? nA : nB);
+    A->countsValid = 0;
+    if(B == &tmp) freeSet(&tmp);
+}
+
+/**
+ * @brief Toggles every element of B in A (A ^= B).
+ *
+ * @param A Pointer to the set to be modified.
+ * @param B Pointer to the set to toggle.
+ */
+void symdiffInPlace(set *A, set *B) {
+    set tmp;
+    size_t n;
+
+    if(A->kind == SET_ROARING) {
+        combineRoaring(A, B, A, ROARING_XOR);
+        return;
+    }
+    B = matchKind(B, &tmp, SET_BITMAP);
+    n = getWordCount(B);
+
+    reserveWords(A, n);
+    runKernel(getKernels()->xorWords, getData(A), getData(A), getData(B), n);
+    A->countsValid = 0;
+    if(B == &tmp) freeSet(&tmp);
+}
+
+/**
+ * @brief Points a stack entry at a block of words of a set.
+ *
+ * The words are read in place when the set holds the whole block, otherwise
+ * the words it holds are copied to the buffer of the entry and the rest is 0.
+ *
+ * @param P Pointer to the compiled expression.
+ * @param A Pointer to the set.
+ * @param sp Index of the stack entry.
+ * @param i Index of the first word of the block.
+ * @param m Number of words in the block.
+ */
+static void loadBlock(exprProgram *P, set *A, size_t sp, size_t i, size_t m) {
+    setWord *buffer = P->buffers + sp * EXPR_BLOCK_WORDS;
+    size_t n = getWordCount(A), have;
+
+    if(i + m <= n) {
+        P->values[sp] = getData(A) + i;
+        return;
+    }
+
+    have = n > i ? n - i : 0;
+    memcpy(buffer, getData(A) + i, have * sizeof(setWord));
+    memset(buffer + have, 0, (m - have) * sizeof(setWord));
+    P->values[sp] = buffer;
+}
+
+/**
+ * @brief Evaluates a compiled set expression into a set in one fused pass.
+ *
+ * The words are processed EXPR_BLOCK_WORDS at a time, running every step
+ * of the program on a block before moving to the next one. Each word of an
+ * operand is loaded once and no intermediate set is built.
+ *
+ * @param P Pointer to the compiled expression.
+ * @param C Pointer to the bitmap set receiving the result, distinct from every operand.
+ */
+void evalExpression(exprProgram *P, set *C) {
+    static setWord ones[EXPR_BLOCK_WORDS];
+    const kernelTable *kernels = getKernels();
+    size_t i, m, s, sp, n = 0, limit = wordsFor(C->maxValue), converted = 0;
+    set *tmp = NULL;
+    setWord *dst;
+    wordKernel kernel;
+
+    /* Complementing is an exclusive or with a block of ones */
+    if(!ones[0]) memset(ones, 0xFF, sizeof(ones));
+
+    /* Bring roaring operands to the bitmap representation */
+    for(s = 0; s < P->len; s++)
+        if(P->steps[s].op == EXPR_SET && P->steps[s].operand->kind == SET_ROARING) converted++;
+    if(converted) {
+        tmp = (set *)allocMemory(converted * sizeof(set));
+        for(s = 0, converted = 0; s < P->len; s++)
+            if(P->steps[s].op == EXPR_SET && P->steps[s].operand->kind == SET_ROARING)
+                P->steps[s].operand = matchKind(P->steps[s].operand, &tmp[converted++], SET_BITMAP);
+    }
+
+    /* The result reaches the longest operand, or the whole universe once complemented */
+    if(P->complement) n = limit;
+    else
+        for(s = 0; s < P->len; s++)
+            if(P->steps[s].op == EXPR_SET && getWordCount(P->steps[s].operand) > n)
+                n = getWordCount(P->steps[s].operand);
+    if(n > limit) n = limit;
+    reserveWords(C, n);
+
+    for(i = 0; i < n; i += m) {
+        m = n - i < EXPR_BLOCK_WORDS ? n - i : EXPR_BLOCK_WORDS;
+
+        for(s = 0, sp = 0; s < P->len; s++) {
+            if(P->steps[s].op == EXPR_SET) {
+                loadBlock(P, P->steps[s].operand, sp++, i, m);
+                continue;
+            }
+
+            /* The last step writes straight into the result */
+            if(P->steps[s].op == EXPR_NOT) {
+                dst = s + 1 == P->len ? getData(C) + i : P->buffers + (sp - 1) * EXPR_BLOCK_WORDS;
+                kernels->xorWords(dst, P->values[sp - 1], ones, m);
+                P->values[sp - 1] = dst;
+                continue;
+            }
+
+            switch(P->steps[s].op) {
+                case EXPR_UNION: kernel = kernels->orWords; break;
+                case EXPR_INTERSECT: kernel = kernels->andWords; break;
+                case EXPR_SUB: kernel = kernels->andNotWords; break;
+                default: kernel = kernels->xorWords; break;
+            }
+            dst = s + 1 == P->len ? getData(C) + i : P->buffers + (sp - 2) * EXPR_BLOCK_WORDS;
+            kernel(dst, P->values[sp - 2], P->values[sp - 1], m);
+            P->values[sp - 2] = dst;
+            sp--;
+        }
+
+        /* An expression that is a single set is copied */
+        if(P->values[0] != getData(C) + i)
+            memcpy(getData(C) + i, P->values[0], m * sizeof(setWord));
+    }
+
+    /* Clear the rest of the set and the bits past the end of the universe */
+    memset(getData(C) + n, 0, (getWordCount(C) - n) * sizeof(setWord));
+    if(n == limit && (C->maxValue + 1) % WORD_BITS)
+        getData(C)[n - 1] &= ((setWord)1 << (C->maxValue + 1) % WORD_BITS) - 1;
+    C->countsValid = 0;
+
+    while(converted > 0) freeSet(&tmp[--converted]);
+    free(tmp);
+}
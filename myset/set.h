@@ -1,124 +1,434 @@
-/**
- * @file set.h
- * @brief Definitions and functions for set operations.
- */
-
-#ifndef SET_H
-#define SET_H
-
-#define SET_SIZE 128 /**< Define the maximum size of the set */
-#define ROW_SIZE 16  /**< Define the number of elements per row for printing */
-#define DATA_SIZE 16 /**< Define the size of the data array in bytes */
-#define BYTE_SIZE 8  /**< Define the size of a byte in bits */
-#define SET_COUNT 6  /**< Define the number of sets */
-
-/**
- * @brief Structure representing a set.
- *
- * The set is represented using an array of unsigned char, each bit representing an element.
- */
-typedef struct {
-    unsigned char data[DATA_SIZE]; /**< Array to hold set data */
-} set;
-
-/**
- * @brief Retrieves the data array from a set.
- *
- * @param A Pointer to the set.
- * @return Pointer to the data array of the set.
- */
-unsigned char *getData(set *A);
-
-/**
-  * @brief Empties a set by setting all its data elements to 0.
- *
- * @param A Pointer to the set to be emptied.
- * @note This function modifies the set in place.
- */
-void emptySet(set *A);
-
-/**
- * @brief Empties an array of sets by setting all their data elements to 0.
- *
- * @param setArr Array of set pointers to be emptied.
- * @param len Length of the set array.
- * @note This function modifies each set in the array in place.
- */
-void emptySetArray(set *setArr[], int len);
-
-/**
- * @brief Adds a number to a set.
- *
- * @param A Pointer to the set.
- * @param num Number to be added to the set.
- */
-void addToSet(set *A, unsigned char num);
-
-/**
- * @brief Checks if a number is in a set.
- *
- * @param A Pointer to the set.
- * @param num Number to check for membership in the set.
- * @return 1 if the number is in the set, 0 otherwise.
- */
-int isInSet(set *A, unsigned char num);
-
-/**
- * @brief Reads an array of numbers into a set.
- *
- * @param A Pointer to the set.
- * @param arr Array of numbers to be read into the set.
- * @param len Length of the array.
- * @note This function empties the set before adding new numbers.
- */
-void read_set(set *A, unsigned char *arr, int len);
-
-/**
- * @brief Prints the contents of a set.
- *
- * @param A Pointer to the set.
- * @note This function prints the set in a specified format.
- */
-void print_set(set *A);
-
-/**
- * @brief Computes the union of two sets and stores the result in a third set.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the set to store the union result.
- * @note This function modifies the result set in place.
- */
-void union_set(set *A, set *B, set *C);
-
-/**
- * @brief Computes the intersection of two sets and stores the result in a third set.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the set to store the intersection result.
- * @note This function modifies the result set in place.
- */
-void intersect_set(set *A, set *B, set *C);
-
-/**
- * @brief Computes the difference of two sets (A \ B) and stores the result in a third set.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the set to store the difference result.
- * @note This function modifies the result set in place.
- */
-void sub_set(set *A, set *B, set *C);
-
-/**
- * @brief Computes the symmetric difference of two sets and stores the result in a third set.
- *
- * @param A Pointer to the first set.
- * @param B Pointer to the second set.
- * @param C Pointer to the set to store the symmetric difference result.
- * @note This function modifies the result set in place.
- */
-void symdiff_set(set *A, set *B, set *C);
-
-#endif /* SET_H */
+/**
+ * @file set.h
+ * @brief Definitions and functions for set operations.
+ */
+
+#ifndef SET_H
+#define SET_H
+
+#include <stddef.h>
+
+#define SET_SIZE 128 /**< Define the default size of the universe of a set */
+#define ROW_SIZE 16  /**< Define the number of elements per row for printing */
+#define SET_ALIGN 64 /**< Define the alignment of the data array in bytes */
+#define BYTE_SIZE 8  /**< Define the size of a byte in bits */
+#define SET_COUNT 6  /**< Define the number of sets created at startup */
+#define EXPR_BLOCK_WORDS 512 /**< Define the number of words a set expression is evaluated at a time */
+
+#define MAX_SET_VALUE 4294967295UL /**< Define the largest element of the largest universe (2^32 elements) */
+
+/**
+ * @brief Machine word used to store the bits of a set.
+ *
+ * Set operations are performed a whole word at a time.
+ */
+typedef unsigned long setWord;
+
+#define WORD_BITS (sizeof(setWord) * BYTE_SIZE) /**< Define the number of bits in a word */
+
+struct roaringSet; /* Compressed representation, see roaring.h */
+
+/**
+ * @brief Enumeration representing the ways a set can be stored.
+ */
+typedef enum {
+    SET_BITMAP, /**< Array of words, one bit per element of the universe */
+    SET_ROARING /**< Compressed containers, for sparse sets over large universes */
+} SetKind;
+
+/**
+ * @brief Structure representing a set.
+ *
+ * A bitmap set is represented using an array of words, each bit representing an element.
+ * The universe of the set (0 to maxValue) is chosen when the set is initialized,
+ * and the data array only grows to cover it as larger elements are added.
+ * A roaring set keeps its elements in compressed containers instead.
+ */
+typedef struct {
+    SetKind kind;               /**< Representation of the set */
+    setWord *data;              /**< Array to hold set data, aligned to SET_ALIGN bytes */
+    size_t words;               /**< Number of words in the data array */
+    unsigned long maxValue;     /**< Largest element of the universe of the set */
+    void *block;                /**< Allocation holding the data array, NULL if the set does not own it */
+    struct roaringSet *sparse;  /**< Containers of a roaring set, NULL for a bitmap set */
+    unsigned long *counts;      /**< Number of elements before each block of words, and in total */
+    size_t countBlocks;         /**< Number of blocks covered by counts */
+    int countsValid;            /**< 1 if counts matches the data array */
+} set;
+
+/**
+ * @brief Initializes an empty set over the universe 0 to maxValue.
+ *
+ * @param A Pointer to the set.
+ * @param maxValue Largest element of the universe, at most MAX_SET_VALUE.
+ * @param kind Representation of the set.
+ * @note This function dynamically allocates memory for the set.
+ *       It is the caller's responsibility to release it with freeSet.
+ */
+void initSet(set *A, unsigned long maxValue, SetKind kind);
+
+/**
+ * @brief Retrieves the representation of a set.
+ *
+ * @param A Pointer to the set.
+ * @return The representation of the set.
+ */
+SetKind getKind(set *A);
+
+/**
+ * @brief Frees the memory held by a set.
+ *
+ * @param A Pointer to the set.
+ */
+void freeSet(set *A);
+
+/**
+ * @brief Retrieves the largest element of the universe of a set.
+ *
+ * @param A Pointer to the set.
+ * @return The largest element the set may hold.
+ */
+unsigned long getMaxValue(set *A);
+
+/**
+ * @brief Retrieves the number of words in the data array of a set.
+ *
+ * @param A Pointer to the set.
+ * @return Number of words in the data array, 0 for a roaring set.
+ */
+size_t getWordCount(set *A);
+
+/**
+ * @brief Exchanges the contents of two sets in constant time.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ */
+void swapSets(set *A, set *B);
+
+/**
+ * @brief Retrieves the data array from a set.
+ *
+ * @param A Pointer to the set.
+ * @return Pointer to the data array of the set, NULL for a roaring set.
+ */
+setWord *getData(set *A);
+
+/**
+  * @brief Empties a set by setting all its data elements to 0.
+ *
+ * @param A Pointer to the set to be emptied.
+ * @note This function modifies the set in place.
+ */
+void emptySet(set *A);
+
+/**
+ * @brief Empties an array of sets by setting all their data elements to 0.
+ *
+ * @param setArr Array of set pointers to be emptied.
+ * @param len Length of the set array.
+ * @note This function modifies each set in the array in place.
+ */
+void emptySetArray(set *setArr[], int len);
+
+/**
+ * @brief Makes a bitmap set use a data array it does not own.
+ *
+ * The array is never freed by the set. It is written in place, and copied
+ * into an array of the set's own the first time the set grows.
+ *
+ * @param A Pointer to the set, a bitmap.
+ * @param data The words, aligned to SET_ALIGN bytes.
+ * @param words Number of words, from 1 to the number covering the universe.
+ */
+void adoptWords(set *A, setWord *data, size_t words);
+
+/**
+ * @brief Grows the data array of a bitmap set to cover its whole universe.
+ *
+ * The data array of a set with a reserved universe never moves again, so
+ * its words can be updated in place by several threads.
+ *
+ * @param A Pointer to the set.
+ */
+void reserveUniverse(set *A);
+
+/**
+ * @brief Adds a number to a set.
+ *
+ * @param A Pointer to the set.
+ * @param num Number to be added to the set.
+ * @note The data array grows if num is beyond its current end.
+ */
+void addToSet(set *A, unsigned long num);
+
+/**
+ * @brief Checks if a number is in a set.
+ *
+ * @param A Pointer to the set.
+ * @param num Number to check for membership in the set.
+ * @return 1 if the number is in the set, 0 otherwise.
+ */
+int isInSet(set *A, unsigned long num);
+
+/**
+ * @brief Finds the smallest element of a set.
+ *
+ * Together with nextInSet, this walks a set in increasing order in time
+ * proportional to its number of elements rather than to its universe:
+ *
+ *     for(found = firstInSet(A, &num); found; found = nextInSet(A, &num))
+ *
+ * @param A Pointer to the set.
+ * @param num Where the element is stored.
+ * @return 1 if the set is not empty, 0 otherwise.
+ */
+int firstInSet(set *A, unsigned long *num);
+
+/**
+ * @brief Advances to the next element of a set.
+ *
+ * @param A Pointer to the set.
+ * @param num The current element, replaced by the smallest element greater than it.
+ * @return 1 if such an element exists, 0 otherwise (num is left unchanged).
+ */
+int nextInSet(set *A, unsigned long *num);
+
+/**
+ * @brief Counts the elements of a set.
+ *
+ * @param A Pointer to the set.
+ * @return Number of elements in the set.
+ */
+unsigned long countSet(set *A);
+
+/**
+ * @brief Counts the elements of a set that are not greater than a number.
+ *
+ * @param A Pointer to the set.
+ * @param num The number.
+ * @return Number of elements less than or equal to num.
+ */
+unsigned long rankInSet(set *A, unsigned long num);
+
+/**
+ * @brief Finds the k-th smallest element of a set.
+ *
+ * @param A Pointer to the set.
+ * @param k Position of the element, starting from 1.
+ * @param num Where the element is stored.
+ * @return 1 if the set has an element at position k, 0 otherwise.
+ */
+int selectInSet(set *A, unsigned long k, unsigned long *num);
+
+/**
+ * @brief Checks whether counting the elements of a set only reads it.
+ *
+ * Counting, rank and select build cached counts on large sets, which writes
+ * to the set, so a thread holding the set shared must check this first.
+ *
+ * @param A Pointer to the set.
+ * @return 1 if the counts are built or not used, 0 otherwise.
+ */
+int countsReady(set *A);
+
+/**
+ * @brief Reads an array of numbers into a set.
+ *
+ * @param A Pointer to the set.
+ * @param arr Array of numbers to be read into the set.
+ * @param len Length of the array.
+ * @note This function empties the set before adding new numbers.
+ */
+void read_set(set *A, unsigned long *arr, int len);
+
+/**
+ * @brief Prints the contents of a set.
+ *
+ * @param A Pointer to the set.
+ * @note This function prints the set in a specified format.
+ */
+void print_set(set *A);
+
+/**
+ * @brief Prints the number of elements of a set.
+ *
+ * @param A Pointer to the set.
+ */
+void size_set(set *A);
+
+/**
+ * @brief Prints the number of elements of a set that are not greater than a number.
+ *
+ * @param A Pointer to the set.
+ * @param num The number.
+ */
+void rank_set(set *A, unsigned long num);
+
+/**
+ * @brief Prints the k-th smallest element of a set.
+ *
+ * @param A Pointer to the set.
+ * @param k Position of the element, starting from 1.
+ */
+void select_set(set *A, unsigned long k);
+
+/**
+ * @brief Computes the union of two sets and stores the result in a third set.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the set to store the union result.
+ * @note This function modifies the result set in place.
+ *       C may alias A or B, in which case that operand is read as empty.
+ */
+void union_set(set *A, set *B, set *C);
+
+/**
+ * @brief Computes the intersection of two sets and stores the result in a third set.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the set to store the intersection result.
+ * @note This function modifies the result set in place.
+ *       C may alias A or B, in which case that operand is read as empty.
+ */
+void intersect_set(set *A, set *B, set *C);
+
+/**
+ * @brief Computes the difference of two sets (A \ B) and stores the result in a third set.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the set to store the difference result.
+ * @note This function modifies the result set in place.
+ *       C may alias A or B, in which case that operand is read as empty.
+ */
+void sub_set(set *A, set *B, set *C);
+
+/**
+ * @brief Computes the symmetric difference of two sets and stores the result in a third set.
+ *
+ * @param A Pointer to the first set.
+ * @param B Pointer to the second set.
+ * @param C Pointer to the set to store the symmetric difference result.
+ * @note This function modifies the result set in place.
+ *       C may alias A or B, in which case that operand is read as empty.
+ */
+void symdiff_set(set *A, set *B, set *C);
+
+/**
+ * @brief Computes the union of any number of sets and stores the result in a set.
+ *
+ * All the sets are swept once, a block of words at a time, instead of
+ * building an intermediate set for each pair. Compressed sets are merged
+ * chunk by chunk instead.
+ *
+ * @param setArr Array of the sets.
+ * @param len Number of sets.
+ * @param C Pointer to the set to store the union result.
+ * @note Unlike union_set, C may be one of the sets and is read with its current contents.
+ */
+void union_all(set *setArr[], int len, set *C);
+
+/**
+ * @brief Computes the intersection of any number of sets and stores the result in a set.
+ *
+ * All the sets are swept once, a block of words at a time, and a block
+ * is left as soon as its running intersection is empty. Compressed sets
+ * only look up the chunks of the set with the fewest of them.
+ *
+ * @param setArr Array of the sets.
+ * @param len Number of sets.
+ * @param C Pointer to the set to store the intersection result, emptied if len is 0.
+ * @note Unlike intersect_set, C may be one of the sets and is read with its current contents.
+ */
+void intersect_all(set *setArr[], int len, set *C);
+
+/**
+ * @brief Adds every element of B to A (A |= B).
+ *
+ * @param A Pointer to the set to be modified.
+ * @param B Pointer to the set to add.
+ */
+void unionInPlace(set *A, set *B);
+
+/**
+ * @brief Keeps only the elements of A that are also in B (A &= B).
+ *
+ * @param A Pointer to the set to be modified.
+ * @param B Pointer to the set to intersect with.
+ */
+void intersectInPlace(set *A, set *B);
+
+/**
+ * @brief Removes every element of B from A (A &= ~B).
+ *
+ * @param A Pointer to the set to be modified.
+ * @param B Pointer to the set to subtract.
+ */
+void subInPlace(set *A, set *B);
+
+/**
+ * @brief Toggles every element of B in A (A ^= B).
+ *
+ * @param A Pointer to the set to be modified.
+ * @param B Pointer to the set to toggle.
+ */
+void symdiffInPlace(set *A, set *B);
+
+/**
+ * @brief Enumeration representing the steps of a compiled set expression.
+ */
+typedef enum {
+    EXPR_SET,       /**< Push the words of a set */
+    EXPR_NOT,       /**< Complement the top of the stack within the universe */
+    EXPR_UNION,     /**< Replace the two top entries with their union */
+    EXPR_INTERSECT, /**< Replace the two top entries with their intersection */
+    EXPR_SUB,       /**< Replace the two top entries with the first minus the second */
+    EXPR_SYMDIFF    /**< Replace the two top entries with their symmetric difference */
+} ExprOp;
+
+/**
+ * @brief Structure representing a step of a compiled set expression.
+ */
+typedef struct {
+    ExprOp op;    /**< Operation of the step */
+    set *operand; /**< Set pushed by EXPR_SET, NULL otherwise */
+} exprStep;
+
+/**
+ * @brief Structure representing a set expression compiled to postfix steps.
+ */
+typedef struct {
+    exprStep *steps;        /**< Steps in postfix order */
+    size_t len;             /**< Number of steps */
+    size_t depth;           /**< Largest number of entries on the stack */
+    int complement;         /**< 1 if some step complements, so the result may fill the universe */
+    setWord *buffers;       /**< depth blocks of EXPR_BLOCK_WORDS words for the stack */
+    const setWord **values; /**< depth pointers to the words of the stack entries */
+} exprProgram;
+
+/**
+ * @brief Copies the contents of one set into another.
+ *
+ * @param A Pointer to the set to copy.
+ * @param C Pointer to the destination set, of any representation.
+ */
+void copySet(set *A, set *C);
+
+/**
+ * @brief Evaluates a compiled set expression into a set in one fused pass.
+ *
+ * The words are processed EXPR_BLOCK_WORDS at a time, running every step
+ * of the program on a block before moving to the next one. Each word of an
+ * operand is loaded once and no intermediate set is built.
+ *
+ * @param P Pointer to the compiled expression.
+ * @param C Pointer to the bitmap set receiving the result, distinct from every operand.
+ * @note Roaring operands are replaced in the steps by bitmap copies that are freed
+ *       afterwards, so a program is evaluated only once.
+ */
+void evalExpression(exprProgram *P, set *C);
+
+#endif /* SET_H */
@@ -0,0 +1,152 @@
+/**
+ * @file set_atomic.c
+ * @brief Lock-free insertion and removal on a bitmap set shared by threads.
+ */
+
+#include <sched.h>
+#include "set_atomic.h"
+#include "bit_utils.h"
+
+/**
+ * @brief Registers a write in progress, waiting while a snapshot is copied.
+ *
+ * The writer announces itself before checking for a snapshot, and a snapshot
+ * freezes the set before counting the writers, so either the snapshot waits
+ * for the writer or the writer sees the snapshot and steps back.
+ *
+ * @param S Pointer to the shared set.
+ */
+static void enterWrite(sharedSet *S) {
+    for(;;) {
+        __atomic_add_fetch(&S->writers, 1, __ATOMIC_SEQ_CST);
+        if(!__atomic_load_n(&S->frozen, __ATOMIC_SEQ_CST)) return;
+
+        /* Step back so the snapshot does not wait for this writer */
+        __atomic_sub_fetch(&S->writers, 1, __ATOMIC_SEQ_CST);
+        while(__atomic_load_n(&S->frozen, __ATOMIC_ACQUIRE))
+            sched_yield();
+    }
+}
+
+/**
+ * @brief Ends a write, publishing its words to the next snapshot.
+ *
+ * @param S Pointer to the shared set.
+ */
+static void leaveWrite(sharedSet *S) {
+    __atomic_sub_fetch(&S->writers, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Prepares a set to be updated by several threads.
+ *
+ * @param S Pointer to the shared set.
+ * @param A Pointer to the set, it must not be used otherwise until the threads are done.
+ * @return 0 if successful, 1 if the set is a roaring set, whose containers cannot be updated atomically.
+ */
+int shareSet(sharedSet *S, set *A) {
+    if(getKind(A) != SET_BITMAP) return 1;
+
+    /* The counts are stale as soon as a writer starts */
+    reserveUniverse(A);
+    A->countsValid = 0;
+
+    S->target = A;
+    S->writers = 0;
+    S->frozen = 0;
+    return 0;
+}
+
+/**
+ * @brief Adds a number to a shared set.
+ *
+ * @param S Pointer to the shared set.
+ * @param num Number to be added, in the universe of the set.
+ * @return 1 if the number was added, 0 if it was already in the set.
+ */
+int atomicAddToSet(sharedSet *S, unsigned long num) {
+    size_t i = num / WORD_BITS;
+    setWord bit = (setWord)1 << (num - WORD_BITS * i), old;
+
+    enterWrite(S);
+    old = __atomic_fetch_or(&getData(S->target)[i], bit, __ATOMIC_RELAXED);
+    leaveWrite(S);
+    return !(old & bit);
+}
+
+/**
+ * @brief Removes a number from a shared set.
+ *
+ * @param S Pointer to the shared set.
+ * @param num Number to be removed, in the universe of the set.
+ * @return 1 if the number was removed, 0 if it was not in the set.
+ */
+int atomicRemoveFromSet(sharedSet *S, unsigned long num) {
+    size_t i = num / WORD_BITS;
+    setWord bit = (setWord)1 << (num - WORD_BITS * i), old;
+
+    enterWrite(S);
+    old = __atomic_fetch_and(&getData(S->target)[i], ~bit, __ATOMIC_RELAXED);
+    leaveWrite(S);
+    return (old & bit) != 0;
+}
+
+/**
+ * @brief Adds an array of numbers to a shared set.
+ *
+ * Consecutive numbers of the same word are added with a single atomic
+ * operation, so sorted or clustered arrays take few of them. A snapshot
+ * may be taken between two chunks of the array, so it never waits long.
+ *
+ * @param S Pointer to the shared set.
+ * @param nums Numbers to be added, in the universe of the set.
+ * @param len Number of numbers.
+ * @return Number of numbers that were added, repeated and present ones excluded.
+ */
+unsigned long atomicAddArray(sharedSet *S, const unsigned long *nums, size_t len) {
+    setWord *data = getData(S->target), mask, old;
+    unsigned long added = 0;
+    size_t i, j, end, word;
+
+    for(i = 0; i < len; i = end) {
+        end = len - i > BULK_CHUNK ? i + BULK_CHUNK : len;
+
+        enterWrite(S);
+        for(j = i; j < end;) {
+            /* Gather the bits of the numbers of the same word */
+            word = nums[j] / WORD_BITS;
+            for(mask = 0; j < end && nums[j] / WORD_BITS == word; j++)
+                mask |= (setWord)1 << (nums[j] % WORD_BITS);
+
+            old = __atomic_fetch_or(&data[word], mask, __ATOMIC_RELAXED);
+            added += popcountWord(mask & ~old);
+        }
+        leaveWrite(S);
+    }
+    return added;
+}
+
+/**
+ * @brief Copies a shared set while writers may still be updating it.
+ *
+ * New writers are held back and the writes in progress are waited for, so
+ * the copy is the state of the set at a single moment. The writers only wait
+ * while the words are copied.
+ *
+ * @param S Pointer to the shared set.
+ * @param C Pointer to the set receiving the copy, distinct from the shared set.
+ */
+void snapshotSet(sharedSet *S, set *C) {
+    int open = 0;
+
+    /* A single snapshot is copied at a time */
+    while(!__atomic_compare_exchange_n(&S->frozen, &open, 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        open = 0;
+        sched_yield();
+    }
+    while(__atomic_load_n(&S->writers, __ATOMIC_SEQ_CST))
+        sched_yield();
+
+    copySet(S->target, C);
+    __atomic_store_n(&S->frozen, 0, __ATOMIC_RELEASE);
+}
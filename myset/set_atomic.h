@@ -0,0 +1,82 @@
+/**
+ * @file set_atomic.h
+ * @brief Lock-free insertion and removal on a bitmap set shared by threads.
+ *
+ * addToSet updates a word of the data array with a plain read-modify-write,
+ * so two threads adding numbers of the same word can lose each other's bits.
+ * A shared set updates the words with atomic fetch-or and fetch-and instead,
+ * so any number of threads can add and remove numbers at once.
+ *
+ * The data array covers the whole universe while the set is shared, so it
+ * never moves under the writers. The set must not be used through the other
+ * set functions until every writer is done, readers take a snapshot instead.
+ * A snapshot waits for the writers in progress and holds the new ones back
+ * only while the words are copied, so the copy is the state of the set at a
+ * single moment.
+ */
+
+#ifndef SET_ATOMIC_H
+#define SET_ATOMIC_H
+
+#include "set.h"
+
+#define BULK_CHUNK 4096 /**< Define the number of numbers a bulk insertion adds between two snapshots */
+
+/**
+ * @brief Structure representing a bitmap set shared by writer threads.
+ */
+typedef struct {
+    set *target;           /**< The set, a bitmap with its whole universe reserved */
+    unsigned long writers; /**< Number of writes in progress */
+    int frozen;            /**< 1 while a snapshot is being copied */
+} sharedSet;
+
+/**
+ * @brief Prepares a set to be updated by several threads.
+ *
+ * @param S Pointer to the shared set.
+ * @param A Pointer to the set, it must not be used otherwise until the threads are done.
+ * @return 0 if successful, 1 if the set is a roaring set, whose containers cannot be updated atomically.
+ */
+int shareSet(sharedSet *S, set *A);
+
+/**
+ * @brief Adds a number to a shared set.
+ *
+ * @param S Pointer to the shared set.
+ * @param num Number to be added, in the universe of the set.
+ * @return 1 if the number was added, 0 if it was already in the set.
+ */
+int atomicAddToSet(sharedSet *S, unsigned long num);
+
+/**
+ * @brief Removes a number from a shared set.
+ *
+ * @param S Pointer to the shared set.
+ * @param num Number to be removed, in the universe of the set.
+ * @return 1 if the number was removed, 0 if it was not in the set.
+ */
+int atomicRemoveFromSet(sharedSet *S, unsigned long num);
+
+/**
+ * @brief Adds an array of numbers to a shared set.
+ *
+ * Consecutive numbers of the same word are added with a single atomic
+ * operation, so sorted or clustered arrays take few of them.
+ *
+ * @param S Pointer to the shared set.
+ * @param nums Numbers to be added, in the universe of the set.
+ * @param len Number of numbers.
+ * @return Number of numbers that were added, repeated and present ones excluded.
+ */
+unsigned long atomicAddArray(sharedSet *S, const unsigned long *nums, size_t len);
+
+/**
+ * @brief Copies a shared set while writers may still be updating it.
+ *
+ * @param S Pointer to the shared set.
+ * @param C Pointer to the set receiving the copy, distinct from the shared set.
+ */
+void snapshotSet(sharedSet *S, set *C);
+
+#endif /* SET_ATOMIC_H */
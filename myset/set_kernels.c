@@ -0,0 +1,180 @@
+/**
+ * @file set_kernels.c
+ * @brief Scalar word kernels and runtime dispatch of the vector kernels.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "set_kernels.h"
+
+#ifdef SET_KERNELS_X86
+extern const kernelTable sse2Kernels;   /**< Defined in set_kernels_sse2.c */
+extern const kernelTable avx2Kernels;   /**< Defined in set_kernels_avx2.c */
+extern const kernelTable avx512Kernels; /**< Defined in set_kernels_avx512.c */
+#endif
+
+/**
+ * @brief Computes dst = a | b one word at a time.
+ */
+static void orWordsScalar(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i;
+    for(i = 0; i < n; i++)
+        dst[i] = a[i] | b[i];
+}
+
+/**
+ * @brief Computes dst = a & b one word at a time.
+ */
+static void andWordsScalar(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i;
+    for(i = 0; i < n; i++)
+        dst[i] = a[i] & b[i];
+}
+
+/**
+ * @brief Computes dst = a & ~b one word at a time.
+ */
+static void andNotWordsScalar(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i;
+    for(i = 0; i < n; i++)
+        dst[i] = a[i] & ~b[i];
+}
+
+/**
+ * @brief Computes dst = a ^ b one word at a time.
+ */
+static void xorWordsScalar(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i;
+    for(i = 0; i < n; i++)
+        dst[i] = a[i] ^ b[i];
+}
+
+/**
+ * @brief Converts the members at the start of a read_set list one character at a time.
+ */
+static size_t scanListScalar(const char *str, size_t len, unsigned long maxValue, unsigned long *out, size_t cap, size_t *count) {
+    size_t pos = 0, q, n = 0;
+    unsigned long num, digit;
+
+    for(; n < cap; pos = q) {
+        /* A run of digits without a leading zero, stopping at the first digit out of range */
+        for(q = pos, num = 0; q < len && str[q] >= '0' && str[q] <= '9'; q++) {
+            digit = (unsigned long)(str[q] - '0');
+            if(maxValue < digit || num > (maxValue - digit) / 10) break;
+            num = num * 10 + digit;
+        }
+        if(q == pos || (q - pos > 1 && str[pos] == '0') || (q < len && str[q] >= '0' && str[q] <= '9')) break;
+
+        /* A single comma between blanks and the start of the next member */
+        for(; q < len && (str[q] == ' ' || str[q] == '\t'); q++);
+        if(q == len || str[q] != ',') break;
+        for(q++; q < len && (str[q] == ' ' || str[q] == '\t'); q++);
+        if(q == len || ((str[q] < '0' || str[q] > '9') && str[q] != '-')) break;
+
+        out[n++] = num;
+    }
+    *count = n;
+    return pos;
+}
+
+/** Scalar kernels, always available */
+static const kernelTable scalarKernels = {
+    "scalar", orWordsScalar, andWordsScalar, andNotWordsScalar, xorWordsScalar, scanListScalar
+};
+
+/** Kernels currently in use, NULL until a backend is selected */
+static const kernelTable *activeKernels = NULL;
+
+/**
+ * @brief Checks whether the CPU supports a backend.
+ *
+ * @param backend Backend to check.
+ * @return 1 if the backend can be used, 0 otherwise.
+ */
+static int isSupported(KernelBackend backend) {
+    switch(backend) {
+        case KERNEL_SCALAR:
+            return 1;
+#if defined(SET_KERNELS_X86) && defined(__GNUC__)
+        case KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Retrieves the kernel table of a backend.
+ *
+ * @param backend Backend whose kernels are requested.
+ * @return Pointer to the kernel table, or NULL if it is not built in.
+ */
+static const kernelTable *backendKernels(KernelBackend backend) {
+    const kernelTable *table;
+
+    switch(backend) {
+        case KERNEL_SCALAR: table = &scalarKernels; break;
+#ifdef SET_KERNELS_X86
+        case KERNEL_SSE2: table = &sse2Kernels; break;
+        case KERNEL_AVX2: table = &avx2Kernels; break;
+        case KERNEL_AVX512: table = &avx512Kernels; break;
+#endif
+        default: return NULL;
+    }
+
+    /* A vector file compiled without its instruction set has no kernels */
+    return table->orWords ? table : NULL;
+}
+
+/**
+ * @brief Parses a backend name ("auto", "scalar", "sse2", "avx2" or "avx512").
+ *
+ * @param name Name of the backend.
+ * @return The corresponding backend, or KERNEL_NONE if the name is unknown.
+ */
+KernelBackend parseKernelBackend(const char *name) {
+    if(!strcmp(name, "auto")) return KERNEL_AUTO;
+    else if(!strcmp(name, "scalar")) return KERNEL_SCALAR;
+    else if(!strcmp(name, "sse2")) return KERNEL_SSE2;
+    else if(!strcmp(name, "avx2")) return KERNEL_AVX2;
+    else if(!strcmp(name, "avx512")) return KERNEL_AVX512;
+    return KERNEL_NONE;
+}
+
+/**
+ * @brief Selects the kernels used by the set operations.
+ *
+ * @param backend Backend to use, KERNEL_AUTO picks the best one the CPU supports.
+ * @return 0 if successful, 1 if the backend is not supported by this CPU or build.
+ */
+int selectKernels(KernelBackend backend) {
+    if(backend == KERNEL_AUTO) {
+        /* Try the widest vectors first */
+        for(backend = KERNEL_AVX512; backend > KERNEL_SCALAR; backend--)
+            if(backendKernels(backend) && isSupported(backend))
+                break;
+    }
+
+    if(!backendKernels(backend) || !isSupported(backend))
+        return 1;
+
+    activeKernels = backendKernels(backend);
+    return 0;
+}
+
+/**
+ * @brief Retrieves the selected kernels.
+ *
+ * @return Pointer to the kernel table in use.
+ * @note If no backend was selected yet, the best supported one is selected.
+ */
+const kernelTable *getKernels(void) {
+    if(!activeKernels)
+        selectKernels(KERNEL_AUTO);
+    return activeKernels;
+}
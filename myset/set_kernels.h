@@ -0,0 +1,95 @@
+/**
+ * @file set_kernels.h
+ * @brief Word kernels used by the set operations and their runtime dispatch.
+ *
+ * Each binary set operation is computed by a kernel that combines two word
+ * arrays into a third one, and the members of a read_set list are converted
+ * by a list kernel. Scalar, SSE2, AVX2 and AVX-512 versions of the kernels
+ * are available, and the fastest one supported by the CPU is chosen the
+ * first time the kernels are used unless a backend is forced.
+ */
+
+#ifndef SET_KERNELS_H
+#define SET_KERNELS_H
+
+#include <stddef.h>
+#include "set.h"
+
+/**
+ * @brief Enumeration representing the available kernel backends.
+ */
+typedef enum {
+    KERNEL_AUTO,   /**< Pick the best backend supported by the CPU */
+    KERNEL_SCALAR, /**< Portable word-at-a-time loops */
+    KERNEL_SSE2,   /**< 128-bit SSE2 vectors */
+    KERNEL_AVX2,   /**< 256-bit AVX2 vectors */
+    KERNEL_AVX512, /**< 512-bit AVX-512 vectors */
+    KERNEL_NONE    /**< Unknown backend name */
+} KernelBackend;
+
+/**
+ * @brief Kernel combining two word arrays into a destination array.
+ *
+ * @param dst Destination words, may be the same array as a or b.
+ * @param a First operand words.
+ * @param b Second operand words.
+ * @param n Number of words.
+ */
+typedef void (*wordKernel)(setWord *dst, const setWord *a, const setWord *b, size_t n);
+
+/**
+ * @brief Kernel converting the members at the start of a read_set list.
+ *
+ * A member is converted only if it is a run of digits without a leading
+ * zero, no greater than maxValue, followed by a single comma between spaces
+ * or tabs and by the start of the next member. The kernel stops before the
+ * first other member, so that the text parser takes over there and reports
+ * the error, if any.
+ *
+ * @param str The list.
+ * @param len Number of characters of the list.
+ * @param maxValue The largest valid member.
+ * @param out Where the members are stored.
+ * @param cap Largest number of members to convert.
+ * @param count Where the number of members converted is stored.
+ * @return Number of characters of the converted members and their separators.
+ */
+typedef size_t (*listKernel)(const char *str, size_t len, unsigned long maxValue, unsigned long *out, size_t cap, size_t *count);
+
+/**
+ * @brief Structure holding the kernels of one backend.
+ */
+typedef struct {
+    const char *name;       /**< Name of the backend */
+    wordKernel orWords;     /**< dst = a | b */
+    wordKernel andWords;    /**< dst = a & b */
+    wordKernel andNotWords; /**< dst = a & ~b */
+    wordKernel xorWords;    /**< dst = a ^ b */
+    listKernel scanList;    /**< Members at the start of a read_set list */
+} kernelTable;
+
+/**
+ * @brief Parses a backend name ("auto", "scalar", "sse2", "avx2" or "avx512").
+ *
+ * @param name Name of the backend.
+ * @return The corresponding backend, or KERNEL_NONE if the name is unknown.
+ */
+KernelBackend parseKernelBackend(const char *name);
+
+/**
+ * @brief Selects the kernels used by the set operations.
+ *
+ * @param backend Backend to use, KERNEL_AUTO picks the best one the CPU supports.
+ * @return 0 if successful, 1 if the backend is not supported by this CPU or build.
+ */
+int selectKernels(KernelBackend backend);
+
+/**
+ * @brief Retrieves the selected kernels.
+ *
+ * @return Pointer to the kernel table in use.
+ * @note If no backend was selected yet, the best supported one is selected.
+ */
+const kernelTable *getKernels(void);
+
+#endif /* SET_KERNELS_H */
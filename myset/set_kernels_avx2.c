@@ -0,0 +1,178 @@
+/**
+ * @file set_kernels_avx2.c
+ * @brief 256-bit AVX2 word kernels.
+ *
+ * This file is compiled with the AVX2 instruction set enabled, and its kernels
+ * are only selected when the CPU reports AVX2 support.
+ */
+
+#include <stddef.h>
+#include "set_kernels.h"
+#include "bit_utils.h"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+#define LANE_WORDS (32 / sizeof(setWord)) /**< Number of words in one vector */
+#define LANE_BYTES 32                      /**< Number of characters in one vector */
+#define LAST_LANE 0x80000000UL             /**< Bit of the last character of a vector in a mask */
+
+/**
+ * @brief Computes dst = a | b 32 bytes at a time.
+ */
+static void orWordsAVX2(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m256i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm256_loadu_si256((const __m256i *)(a + i));
+        y = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(x, y));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] | b[i];
+}
+
+/**
+ * @brief Computes dst = a & b 32 bytes at a time.
+ */
+static void andWordsAVX2(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m256i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm256_loadu_si256((const __m256i *)(a + i));
+        y = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_and_si256(x, y));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] & b[i];
+}
+
+/**
+ * @brief Computes dst = a & ~b 32 bytes at a time.
+ */
+static void andNotWordsAVX2(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m256i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm256_loadu_si256((const __m256i *)(a + i));
+        y = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_andnot_si256(y, x));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] & ~b[i];
+}
+
+/**
+ * @brief Computes dst = a ^ b 32 bytes at a time.
+ */
+static void xorWordsAVX2(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m256i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm256_loadu_si256((const __m256i *)(a + i));
+        y = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(x, y));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] ^ b[i];
+}
+
+/**
+ * @brief Converts a run of up to 8 digits at once.
+ *
+ * The digits are shifted to the top of 8 bytes, behind zeros, and combined
+ * in pairs, then in pairs of pairs, with multiply-adds.
+ *
+ * @param str The digits, followed by at least 8 - n readable bytes.
+ * @param n Number of digits, 1 to 8.
+ * @return The integer.
+ */
+static unsigned long convertDigitsAVX2(const char *str, size_t n) {
+    __m128i x = _mm_loadl_epi64((const __m128i *)str);
+
+    x = _mm_sub_epi8(x, _mm_set1_epi8('0'));
+    x = _mm_sll_epi64(x, _mm_cvtsi32_si128((int)(8 * (8 - n))));
+    x = _mm_maddubs_epi16(x, _mm_set_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 10, 1, 10, 1, 10, 1, 10));
+    x = _mm_madd_epi16(x, _mm_set_epi16(0, 0, 0, 0, 1, 100, 1, 100));
+    return (unsigned long)_mm_cvtsi128_si32(x) * 10000 + (unsigned long)_mm_cvtsi128_si32(_mm_srli_si128(x, 4));
+}
+
+/**
+ * @brief Converts a run of digits, the last 8 at once.
+ *
+ * @param str The digits, followed by at least 8 readable bytes.
+ * @param n Number of digits.
+ * @param maxValue The largest valid integer.
+ * @param num Where the integer is stored.
+ * @return 1 if the integer is no greater than maxValue, 0 otherwise.
+ */
+static int convertMemberAVX2(const char *str, size_t n, unsigned long maxValue, unsigned long *num) {
+    unsigned long high = 0, low;
+
+    for(; n > 8; n--) high = high * 10 + (unsigned long)(*str++ - '0');
+    low = convertDigitsAVX2(str, n);
+
+    if(low > maxValue || high > (maxValue - low) / 100000000UL) return 0;
+    *num = high * 100000000UL + low;
+    return 1;
+}
+
+/**
+ * @brief Converts the members at the start of a read_set list, classifying 32 characters at a time.
+ *
+ * The digits, blanks and commas of the 32 characters starting at a member
+ * are found at once, so a member and its separator are checked with a few
+ * bit operations. The last 32 characters are left to the text parser.
+ */
+static size_t scanListAVX2(const char *str, size_t len, unsigned long maxValue, unsigned long *out, size_t cap, size_t *count) {
+    size_t pos = 0, n = 0, run, q, maxDigits;
+    unsigned long digitMask, blankMask, commaMask, t;
+    __m256i x;
+
+    for(maxDigits = 1, t = maxValue; t >= 10; t /= 10) maxDigits++;
+
+    for(; n < cap && pos + LANE_BYTES <= len; pos += q, n++) {
+        x = _mm256_loadu_si256((const __m256i *)(str + pos));
+        digitMask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('0' - 1)),
+                                                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), x)));
+        blankMask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')),
+                                                                        _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t'))));
+        commaMask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(',')));
+
+        /* A run of digits without a leading zero, the last lane bounds the runs where words have 32 bits */
+        run = (size_t)lowestBit(~digitMask | LAST_LANE);
+        if(!run || run > maxDigits || (run > 1 && *(str + pos) == '0')) break;
+
+        /* A single comma between blanks and the start of the next member, all within the vector */
+        q = run + (size_t)lowestBit(~(blankMask >> run) | LAST_LANE >> run);
+        if(q >= LANE_BYTES - 1 || !(commaMask >> q & 1)) break;
+        q++;
+        q += (size_t)lowestBit(~(blankMask >> q) | LAST_LANE >> q);
+        if(q >= LANE_BYTES - 1 || (!(digitMask >> q & 1) && *(str + pos + q) != '-')) break;
+
+        if(!convertMemberAVX2(str + pos, run, maxValue, out + n)) break;
+    }
+    *count = n;
+    return pos;
+}
+
+/** AVX2 kernels */
+const kernelTable avx2Kernels = {
+    "avx2", orWordsAVX2, andWordsAVX2, andNotWordsAVX2, xorWordsAVX2, scanListAVX2
+};
+
+#else
+
+/** AVX2 is not enabled for this build, so the dispatcher never selects these kernels */
+const kernelTable avx2Kernels = { "avx2", NULL, NULL, NULL, NULL, NULL };
+
+#endif /* __AVX2__ */
@@ -0,0 +1,107 @@
+/**
+ * @file set_kernels_avx512.c
+ * @brief 512-bit AVX-512 word kernels.
+ *
+ * This file is compiled with the AVX-512 instruction set enabled, and its kernels
+ * are only selected when the CPU reports AVX-512 support.
+ */
+
+#include <stddef.h>
+#include "set_kernels.h"
+
+#ifdef __AVX512F__
+
+#include <immintrin.h>
+
+#define LANE_WORDS (64 / sizeof(setWord)) /**< Number of words in one vector */
+
+extern const kernelTable avx2Kernels; /**< Defined in set_kernels_avx2.c */
+
+/**
+ * @brief Computes dst = a | b 64 bytes at a time.
+ */
+static void orWordsAVX512(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m512i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm512_loadu_si512((const void *)(a + i));
+        y = _mm512_loadu_si512((const void *)(b + i));
+        _mm512_storeu_si512((void *)(dst + i), _mm512_or_si512(x, y));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] | b[i];
+}
+
+/**
+ * @brief Computes dst = a & b 64 bytes at a time.
+ */
+static void andWordsAVX512(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m512i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm512_loadu_si512((const void *)(a + i));
+        y = _mm512_loadu_si512((const void *)(b + i));
+        _mm512_storeu_si512((void *)(dst + i), _mm512_and_si512(x, y));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] & b[i];
+}
+
+/**
+ * @brief Computes dst = a & ~b 64 bytes at a time.
+ */
+static void andNotWordsAVX512(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m512i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm512_loadu_si512((const void *)(a + i));
+        y = _mm512_loadu_si512((const void *)(b + i));
+        _mm512_storeu_si512((void *)(dst + i), _mm512_andnot_si512(y, x));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] & ~b[i];
+}
+
+/**
+ * @brief Computes dst = a ^ b 64 bytes at a time.
+ */
+static void xorWordsAVX512(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m512i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm512_loadu_si512((const void *)(a + i));
+        y = _mm512_loadu_si512((const void *)(b + i));
+        _mm512_storeu_si512((void *)(dst + i), _mm512_xor_si512(x, y));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] ^ b[i];
+}
+
+/**
+ * @brief Converts the members at the start of a read_set list with the AVX2 kernel.
+ *
+ * AVX-512F compares 32-bit lanes only, the CPUs that support it support AVX2.
+ */
+static size_t scanListAVX512(const char *str, size_t len, unsigned long maxValue, unsigned long *out, size_t cap, size_t *count) {
+    return avx2Kernels.scanList(str, len, maxValue, out, cap, count);
+}
+
+/** AVX-512 kernels */
+const kernelTable avx512Kernels = {
+    "avx512", orWordsAVX512, andWordsAVX512, andNotWordsAVX512, xorWordsAVX512, scanListAVX512
+};
+
+#else
+
+/** AVX-512 is not enabled for this build, so the dispatcher never selects these kernels */
+const kernelTable avx512Kernels = { "avx512", NULL, NULL, NULL, NULL, NULL };
+
+#endif /* __AVX512F__ */
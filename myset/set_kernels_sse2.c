@@ -0,0 +1,177 @@
+/**
+ * @file set_kernels_sse2.c
+ * @brief 128-bit SSE2 word kernels.
+ *
+ * This file is compiled with the SSE2 instruction set enabled, and its kernels
+ * are only selected when the CPU reports SSE2 support.
+ */
+
+#include <stddef.h>
+#include "set_kernels.h"
+#include "bit_utils.h"
+
+#ifdef __SSE2__
+
+#include <immintrin.h>
+
+#define LANE_WORDS (16 / sizeof(setWord)) /**< Number of words in one vector */
+#define LANE_BYTES 16                      /**< Number of characters in one vector */
+
+/**
+ * @brief Computes dst = a | b 16 bytes at a time.
+ */
+static void orWordsSSE2(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m128i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm_loadu_si128((const __m128i *)(a + i));
+        y = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(x, y));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] | b[i];
+}
+
+/**
+ * @brief Computes dst = a & b 16 bytes at a time.
+ */
+static void andWordsSSE2(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m128i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm_loadu_si128((const __m128i *)(a + i));
+        y = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_and_si128(x, y));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] & b[i];
+}
+
+/**
+ * @brief Computes dst = a & ~b 16 bytes at a time.
+ */
+static void andNotWordsSSE2(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m128i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm_loadu_si128((const __m128i *)(a + i));
+        y = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_andnot_si128(y, x));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] & ~b[i];
+}
+
+/**
+ * @brief Computes dst = a ^ b 16 bytes at a time.
+ */
+static void xorWordsSSE2(setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    size_t i = 0;
+    __m128i x, y;
+
+    for(; i + LANE_WORDS <= n; i += LANE_WORDS) {
+        x = _mm_loadu_si128((const __m128i *)(a + i));
+        y = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(x, y));
+    }
+    /* Finish the remaining words one at a time */
+    for(; i < n; i++)
+        dst[i] = a[i] ^ b[i];
+}
+
+/**
+ * @brief Converts a run of up to 8 digits at once.
+ *
+ * The digits are shifted to the top of 8 bytes, behind zeros, and combined
+ * in pairs, then in pairs of pairs, with multiply-adds.
+ *
+ * @param str The digits, followed by at least 8 - n readable bytes.
+ * @param n Number of digits, 1 to 8.
+ * @return The integer.
+ */
+static unsigned long convertDigitsSSE2(const char *str, size_t n) {
+    __m128i x = _mm_loadl_epi64((const __m128i *)str);
+
+    x = _mm_sub_epi8(x, _mm_set1_epi8('0'));
+    x = _mm_sll_epi64(x, _mm_cvtsi32_si128((int)(8 * (8 - n))));
+    x = _mm_madd_epi16(_mm_unpacklo_epi8(x, _mm_setzero_si128()), _mm_set_epi16(1, 10, 1, 10, 1, 10, 1, 10));
+    x = _mm_madd_epi16(_mm_packs_epi32(x, x), _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100));
+    return (unsigned long)_mm_cvtsi128_si32(x) * 10000 + (unsigned long)_mm_cvtsi128_si32(_mm_srli_si128(x, 4));
+}
+
+/**
+ * @brief Converts a run of digits, the last 8 at once.
+ *
+ * @param str The digits, followed by at least 8 readable bytes.
+ * @param n Number of digits.
+ * @param maxValue The largest valid integer.
+ * @param num Where the integer is stored.
+ * @return 1 if the integer is no greater than maxValue, 0 otherwise.
+ */
+static int convertMemberSSE2(const char *str, size_t n, unsigned long maxValue, unsigned long *num) {
+    unsigned long high = 0, low;
+
+    for(; n > 8; n--) high = high * 10 + (unsigned long)(*str++ - '0');
+    low = convertDigitsSSE2(str, n);
+
+    if(low > maxValue || high > (maxValue - low) / 100000000UL) return 0;
+    *num = high * 100000000UL + low;
+    return 1;
+}
+
+/**
+ * @brief Converts the members at the start of a read_set list, classifying 16 characters at a time.
+ *
+ * The digits, blanks and commas of the 16 characters starting at a member
+ * are found at once, so a member and its separator are checked with a few
+ * bit operations. The last 16 characters are left to the text parser.
+ */
+static size_t scanListSSE2(const char *str, size_t len, unsigned long maxValue, unsigned long *out, size_t cap, size_t *count) {
+    size_t pos = 0, n = 0, run, q, maxDigits;
+    unsigned long digitMask, blankMask, commaMask, t;
+    __m128i x;
+
+    for(maxDigits = 1, t = maxValue; t >= 10; t /= 10) maxDigits++;
+
+    for(; n < cap && pos + LANE_BYTES <= len; pos += q, n++) {
+        x = _mm_loadu_si128((const __m128i *)(str + pos));
+        digitMask = (unsigned long)_mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('0' - 1)),
+                                                                   _mm_cmplt_epi8(x, _mm_set1_epi8('9' + 1))));
+        blankMask = (unsigned long)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')),
+                                                                  _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))));
+        commaMask = (unsigned long)_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(',')));
+
+        /* A run of digits without a leading zero */
+        run = (size_t)lowestBit(~digitMask);
+        if(!run || run > maxDigits || (run > 1 && *(str + pos) == '0')) break;
+
+        /* A single comma between blanks and the start of the next member, all within the vector */
+        q = run + (size_t)lowestBit(~(blankMask >> run));
+        if(q >= LANE_BYTES || !(commaMask >> q & 1)) break;
+        q++;
+        q += (size_t)lowestBit(~(blankMask >> q));
+        if(q >= LANE_BYTES || (!(digitMask >> q & 1) && *(str + pos + q) != '-')) break;
+
+        if(!convertMemberSSE2(str + pos, run, maxValue, out + n)) break;
+    }
+    *count = n;
+    return pos;
+}
+
+/** SSE2 kernels */
+const kernelTable sse2Kernels = {
+    "sse2", orWordsSSE2, andWordsSSE2, andNotWordsSSE2, xorWordsSSE2, scanListSSE2
+};
+
+#else
+
+/** SSE2 is not enabled for this build, so the dispatcher never selects these kernels */
+const kernelTable sse2Kernels = { "sse2", NULL, NULL, NULL, NULL, NULL };
+
+#endif /* __SSE2__ */
@@ -3,86 +3,332 @@
  * @brief A collection of functions for set operations.
  */
 
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include "integer_utils.h"
 #include "string_utils.h"
-#include "error_utils.h"
+#include "set_utils.h"
+#include "output_utils.h"
+#include "set_kernels.h"
+
+#define COMMAND_SLOTS 32 /**< Define the number of slots of the command hash table, a power of 2 */
+#define LIST_BATCH 256   /**< Define the number of members the list kernel converts at once */
+
+/**
+ * @brief Structure representing a command name and its operation.
+ */
+typedef struct {
+    const char *name; /**< Name of the command */
+    Operation opr;    /**< Operation of the command */
+} commandEntry;
+
+/** Every command the program accepts */
+static const commandEntry commands[] = {
+    { "stop", STOP },
+    { "read_set", READ },
+    { "print_set", PRINT },
+    { "union_set", UNION },
+    { "intersect_set", INTERSECT },
+    { "sub_set", SUB },
+    { "symdiff_set", SYMDIFF },
+    { "size_set", SIZE },
+    { "rank_set", RANK },
+    { "select_set", SELECT },
+    { "create_set", CREATE },
+    { "drop_set", DROP },
+    { "eval", EVAL },
+    { "define", DEFINE },
+    { "union_all", UNION_ALL },
+    { "intersect_all", INTERSECT_ALL },
+    { "stats", STATS },
+    { "save", SAVE },
+    { "load", LOAD }
+};
+
+static unsigned char commandSlots[COMMAND_SLOTS]; /**< Hash table of the command names */
+static int commandSlotsBuilt = 0;                 /**< 1 once commandSlots is filled */
 
 /**
  * @brief Fills a set with elements parsed from a string.
  *
+ * The list is validated and inserted in a single pass into a staging set,
+ * which replaces the contents of the set only if the whole list is valid.
+ * The list kernel converts the runs of well-formed members, and the text
+ * parser takes over at any other token, so the diagnostics are unchanged.
+ * The set itself is only read, so it can be swapped with the staging set
+ * under a short lock once the list is parsed.
+ *
  * @param A Pointer to the set to be filled.
  * @param str Pointer to the string to parse.
- * @param ptr Pointer to the current position in the string.
- * @param len Length of the string.
- * @note This function dynamically allocates memory for the array of elements.
- *       It is the caller's responsibility to free this memory.
+ * @param staging Set the elements are collected in, to be swapped with A.
+ * @return 1 if the list is valid and staging holds it, 0 if the list is invalid (an error is printed).
+ */
+int fillSet(set *A, char **str, set *staging) {
+    unsigned long num, batch[LIST_BATCH];
+    size_t count, i;
+    int status = 0;
+    char *end = *str + strlen(*str);
+    listKernel scanList = getKernels()->scanList;
+    token tok;
+
+    /* The staging set takes the universe and the representation of the set */
+    if(getMaxValue(staging) != getMaxValue(A) || getKind(staging) != getKind(A)) {
+        freeSet(staging);
+        initSet(staging, getMaxValue(A), getKind(A));
+    }
+    emptySet(staging);
+
+    for(;;) {
+        /* The well-formed members are converted in batches by the list kernel */
+        do {
+            *str += scanList(*str, (size_t)(end - *str), getMaxValue(A), batch, LIST_BATCH, &count);
+            for(i = 0; i < count; i++) addToSet(staging, batch[i]);
+        } while(count == LIST_BATCH);
+
+        /* The next token is parsed as text, with its diagnostics */
+        if(nextToken(str, &tok)) return 0;
+        if(!tok.len) break;
+        status = parseInt(tok.ptr, tok.len, getMaxValue(A), &num);
+
+        /* Check if the token is a valid integer */
+        if(status == -2) return 0;
+
+        /* Validate the length of the integer */
+        if(tok.len != (size_t)(status == -1 ? END_DIGITS : countDigits(num))) {
+            writeStr("Invalid set member - not an integer\n");
+            return 0;
+        }
+
+        /* Check for the end of the list */
+        if(status == -1) break;
+
+        /* Insert the number and move to the next token */
+        addToSet(staging, num);
+    }
+
+    /* Final validation of the set format */
+    if(status != -1) writeStr("List of set members is not terminated correctly\n");
+    else if(**str) writeStr("Extraneous text after end of command\n");
+    else return 1;
+
+    return 0;
+}
+
+/**
+ * @brief Parses a non-negative integer parameter of a command.
+ *
+ * @param tok Token holding the integer.
+ * @param maxValue The largest valid integer.
+ * @param num Where the parsed integer is stored.
+ * @return 0 if successful, 1 if the string is not a valid integer (an error is printed).
  */
-void fillSet(set *A, char **str, char *ptr, size_t len) {
-    unsigned char *arr;
-    char *tmp = *str;
-    int num, i = 0;
-
-    /* Check if the string is readable as a set */
-    if(!isReadableSet(str, ptr))
-        return;
-    *str = tmp;
-
-    /* Allocate memory for the array of elements */
-    arr = (unsigned char *)malloc(len * sizeof(unsigned char));
-    if(!arr){
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+int parseNumber(token tok, unsigned long maxValue, unsigned long *num) {
+    int status = parseInt(tok.ptr, tok.len, maxValue, num);
+
+    if(status == -2) return 1;
+
+    /* The list terminator is not a valid parameter */
+    if(status == -1 && tok.len == END_DIGITS)
+        writeStr("Invalid set member - value out of range\n");
+    else if(status == -1 || tok.len != (size_t)countDigits(*num))
+        writeStr("Invalid set member - not an integer\n");
+    else return 0;
+
+    return 1;
+}
+
+/**
+ * @brief Fills a set with the elements of a binary read_set command.
+ *
+ * The elements are decoded straight into the staging set, with no text to
+ * scan. Like fillSet, the set itself is only read.
+ *
+ * @param A Pointer to the set to be filled.
+ * @param list Token holding the number of elements and the elements, 4 bytes each.
+ * @param staging Set the elements are collected in, to be swapped with A.
+ * @return 1 if the elements are valid and staging holds them, 0 otherwise (an error is printed).
+ */
+int fillPacked(set *A, token list, set *staging) {
+    unsigned long count = unpack32(list.ptr), num, maxValue = getMaxValue(A);
+    const char *ptr = list.ptr + 4;
+
+    /* The staging set takes the universe and the representation of the set */
+    if(getMaxValue(staging) != maxValue || getKind(staging) != getKind(A)) {
+        freeSet(staging);
+        initSet(staging, maxValue, getKind(A));
     }
+    emptySet(staging);
 
-    /* Parse integers from the string and store them in the array */
-    nextToken(str, ptr);
-    while(*ptr != '-') {
-        num = parseInt(ptr);
-        arr[i] = (unsigned char)num;
-        nextToken(str, ptr);
-        i++;
+    for(; count; count--, ptr += 4) {
+        num = unpack32(ptr);
+        if(num > maxValue) {
+            writeStr("Invalid set member - value out of range\n");
+            return 0;
+        }
+        addToSet(staging, num);
     }
+    return 1;
+}
+
+/**
+ * @brief Parses the number parameter of a binary command.
+ *
+ * @param tok Token holding the 4 bytes of the number.
+ * @param maxValue The largest valid number.
+ * @param num Where the number is stored.
+ * @return 0 if successful, 1 if the number is out of range (an error is printed).
+ */
+int parsePacked(token tok, unsigned long maxValue, unsigned long *num) {
+    *num = unpack32(tok.ptr);
+    if(*num <= maxValue) return 0;
 
-    /* Read the array of elements into the set */
-    read_set(A, arr, i);
-    /* free the memory */
-    free(arr);
+    writeStr("Invalid set member - value out of range\n");
+    return 1;
+}
+
+/**
+ * @brief Checks whether a set name of a binary command could be written in a text command.
+ *
+ * @param name The characters of the name.
+ * @param len Number of characters.
+ * @return 1 if the name is not empty and holds no separator, 0 otherwise.
+ */
+static int isPlainName(const char *name, size_t len) {
+    if(!len) return 0;
+    for(; len; name++, len--)
+        if(*name == ' ' || *name == '\t' || *name == ',' || *name == '\n' || *name == '\0') return 0;
+    return 1;
+}
+
+/**
+ * @brief Splits a binary command into the tokens of the equivalent text command.
+ *
+ * tokens[0] is the name of the command and the set names follow it. The
+ * elements of a read_set command are a single token, their number followed
+ * by the elements, so that an empty list is still a parameter. The elements
+ * of the other commands are a token each, in place of their numbers. The
+ * tokens past the last one are empty, as the text parser leaves them.
+ *
+ * @param frame The binary command, as returned by read_line.
+ * @param tokens Array of 5 tokens filled from the command.
+ * @return 0 if successful, 1 if the command is malformed (an error is printed).
+ */
+int frameTokens(char *frame, token tokens[]) {
+    const unsigned char *b = (const unsigned char *)frame;
+    char *names = frame + FRAME_HEADER, *end = names + ((size_t)b[2] | (size_t)b[3] << 8);
+    unsigned long count = unpack32(end);
+    Operation opr = b[1] <= DROP ? (Operation)b[1] : NONE_OPERATION;
+    int i;
+
+    for(i = 0; i < 5; i++) {
+        tokens[i].ptr = end;
+        tokens[i].len = 0;
+    }
+
+    /* The commands whose parameters are not names and numbers have no binary form */
+    tokens[0].ptr = (char *)commandName(opr);
+    tokens[0].len = strlen(tokens[0].ptr);
+
+    /* Each name is its length in a byte followed by its characters */
+    for(i = 1; names < end; i++) {
+        if(i == 5 || (size_t)(end - names) < 1 + (size_t)(unsigned char)*names ||
+           !isPlainName(names + 1, (unsigned char)*names)) {
+            writeStr("Invalid binary command\n");
+            return 1;
+        }
+        tokens[i].ptr = names + 1;
+        tokens[i].len = (unsigned char)*names;
+        names += 1 + tokens[i].len;
+    }
+
+    /* The elements of read_set can only follow the name of its set */
+    if(opr == READ) {
+        if(i > 2) {
+            writeStr("Invalid binary command\n");
+            return 1;
+        }
+        tokens[i].len = 4 + 4 * (size_t)count;
+    }
+    else for(end += 4; i < 5 && count; i++, count--, end += 4) {
+        tokens[i].ptr = end;
+        tokens[i].len = 4;
+    }
+    return 0;
 }
 
 /**
  * @brief Parses a set name and returns a pointer to the corresponding set.
  *
  * @param set_name Name of the set to parse.
- * @param setArr Array of set pointers.
+ * @param R Registry of the named sets.
  * @return Pointer to the corresponding set, or NULL if the set name is invalid.
  */
-set *parseSet(char *set_name, set *setArr[]) {
-    if(!strcmp(set_name, "SETA")) return setArr[0];
-    else if(!strcmp(set_name, "SETB")) return setArr[1];
-    else if(!strcmp(set_name, "SETC")) return setArr[2];
-    else if(!strcmp(set_name, "SETD")) return setArr[3];
-    else if(!strcmp(set_name, "SETE")) return setArr[4];
-    else if(!strcmp(set_name, "SETF")) return setArr[5];
-    return NULL;
+set *parseSet(token set_name, registry *R) {
+    return findSet(R, set_name.ptr, set_name.len);
+}
+
+/**
+ * @brief Builds the hash table of the command names.
+ *
+ * Each slot holds the index of a command in the commands table plus 1,
+ * or 0 if it is empty. The table is built on the first lookup, a server
+ * builds it before its clients look up commands concurrently.
+ */
+void initCommands(void) {
+    size_t i, slot;
+
+    if(commandSlotsBuilt) return;
+
+    for(i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        slot = hashChars(commands[i].name, strlen(commands[i].name)) & (COMMAND_SLOTS - 1);
+        while(commandSlots[slot]) slot = (slot + 1) & (COMMAND_SLOTS - 1);
+        commandSlots[slot] = (unsigned char)(i + 1);
+    }
+    commandSlotsBuilt = 1;
+}
+
+/**
+ * @brief Looks up the operation of a command without reporting unknown names.
+ *
+ * @param command Token representing the command.
+ * @return The corresponding operation enum value, NONE_OPERATION if there is none.
+ */
+Operation findCommand(token command) {
+    size_t slot;
+
+    if(!commandSlotsBuilt) initCommands();
+
+    /* Probe the hash table of the command names */
+    slot = hashChars(command.ptr, command.len) & (COMMAND_SLOTS - 1);
+    for(; commandSlots[slot]; slot = (slot + 1) & (COMMAND_SLOTS - 1))
+        if(tokenEquals(command, commands[commandSlots[slot] - 1].name))
+            return commands[commandSlots[slot] - 1].opr;
+
+    return NONE_OPERATION;
+}
+
+/**
+ * @brief Retrieves the command name of an operation.
+ *
+ * @param opr The operation.
+ * @return The name of the command, "unknown" for NONE_OPERATION.
+ */
+const char *commandName(Operation opr) {
+    size_t i;
+
+    for(i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+        if(commands[i].opr == opr) return commands[i].name;
+    return "unknown";
 }
 
 /**
  * @brief Parses a command string and returns the corresponding operation.
  *
- * @param command String representing the command to parse.
+ * @param command Token representing the command to parse.
  * @return The corresponding operation enum value.
  */
- Operation parseCommand(char *command) {
-    if(!strcmp(command, "stop")) return STOP;
-    else if(!strcmp(command, "read_set")) return READ;
-    else if(!strcmp(command, "print_set")) return PRINT;
-    else if(!strcmp(command, "union_set")) return UNION;
-    else if(!strcmp(command, "intersect_set")) return INTERSECT;
-    else if(!strcmp(command, "sub_set")) return SUB;
-    else if(!strcmp(command, "symdiff_set")) return SYMDIFF;
-    printf("Undefined command name\n");
-    return NONE_OPERATION;
+Operation parseCommand(token command) {
+    Operation opr = findCommand(command);
+
+    if(opr == NONE_OPERATION) writeStr("Undefined command name\n");
+    return opr;
 }
@@ -1,54 +1,141 @@
-/**
- * @file set_utils.h
- * @brief Header file for a collection of functions for set operations.
- */
-
-#ifndef SET_UTILS_H
-#define SET_UTILS_H
-
-#include "set.h"
-
-/**
- * @brief Enumeration representing various operations on sets.
- */
-typedef enum {
-    STOP,          /**< Stop the program */
-    READ,          /**< Read a set */
-    PRINT,         /**< Print a set */
-    UNION,         /**< Union of two sets */
-    INTERSECT,     /**< Intersection of two sets */
-    SUB,           /**< Subtraction of two sets */
-    SYMDIFF,       /**< Symmetric difference of two sets */
-    NONE_OPERATION /**< No operation */
-} Operation;
-
-/**
- * @brief Fills a set with elements parsed from a string.
- *
- * @param A Pointer to the set to be filled.
- * @param str Pointer to the string to parse.
- * @param ptr Pointer to the current position in the string.
- * @param len Length of the string.
- * @note This function dynamically allocates memory for the array of elements.
- *       It is the caller's responsibility to free this memory.
- */
-void fillSet(set *A, char **str, char *ptr, size_t len);
-
-/**
- * @brief Parses a set name and returns a pointer to the corresponding set.
- *
- * @param set_name Name of the set to parse.
- * @param setArr Array of set pointers.
- * @return Pointer to the corresponding set, or NULL if the set name is invalid.
- */
-set *parseSet(char *set_name, set *setArr[]);
-
-/**
- * @brief Parses a command string and returns the corresponding operation.
- *
- * @param command String representing the command to parse.
- * @return The corresponding operation enum value.
- */
-Operation parseCommand(char *command);
-
-#endif /* SET_UTILS_H */
+/**
+ * @file set_utils.h
+ * @brief Header file for a collection of functions for set operations.
+ */
+
+#ifndef SET_UTILS_H
+#define SET_UTILS_H
+
+#include "set.h"
+#include "registry.h"
+#include "string_utils.h"
+
+/**
+ * @brief Enumeration representing various operations on sets.
+ */
+typedef enum {
+    STOP,          /**< Stop the program */
+    READ,          /**< Read a set */
+    PRINT,         /**< Print a set */
+    UNION,         /**< Union of two sets */
+    INTERSECT,     /**< Intersection of two sets */
+    SUB,           /**< Subtraction of two sets */
+    SYMDIFF,       /**< Symmetric difference of two sets */
+    SIZE,          /**< Number of elements of a set */
+    RANK,          /**< Number of elements of a set up to a number */
+    SELECT,        /**< k-th smallest element of a set */
+    CREATE,        /**< Create a named set */
+    DROP,          /**< Drop a named set */
+    EVAL,          /**< Evaluate a set expression */
+    DEFINE,        /**< Define a derived set */
+    UNION_ALL,     /**< Union of any number of sets */
+    INTERSECT_ALL, /**< Intersection of any number of sets */
+    STATS,         /**< Latency statistics of the commands */
+    SAVE,          /**< Save every set to a snapshot file */
+    LOAD,          /**< Load every set from a snapshot file */
+    NONE_OPERATION /**< No operation */
+} Operation;
+
+/**
+ * @brief Fills a set with elements parsed from a string.
+ *
+ * The list is validated and inserted in a single pass into a staging set,
+ * which replaces the contents of the set only if the whole list is valid.
+ * The set itself is only read, so it can be swapped with the staging set
+ * under a short lock once the list is parsed.
+ *
+ * @param A Pointer to the set to be filled.
+ * @param str Pointer to the string to parse.
+ * @param staging Set the elements are collected in, to be swapped with A.
+ * @return 1 if the list is valid and staging holds it, 0 if the list is invalid (an error is printed).
+ */
+int fillSet(set *A, char **str, set *staging);
+
+/**
+ * @brief Parses a non-negative integer parameter of a command.
+ *
+ * @param tok Token holding the integer.
+ * @param maxValue The largest valid integer.
+ * @param num Where the parsed integer is stored.
+ * @return 0 if successful, 1 if the string is not a valid integer (an error is printed).
+ */
+int parseNumber(token tok, unsigned long maxValue, unsigned long *num);
+
+/**
+ * @brief Fills a set with the elements of a binary read_set command.
+ *
+ * @param A Pointer to the set to be filled.
+ * @param list Token holding the number of elements and the elements, 4 bytes each.
+ * @param staging Set the elements are collected in, to be swapped with A.
+ * @return 1 if the elements are valid and staging holds them, 0 otherwise (an error is printed).
+ */
+int fillPacked(set *A, token list, set *staging);
+
+/**
+ * @brief Parses the number parameter of a binary command.
+ *
+ * @param tok Token holding the 4 bytes of the number.
+ * @param maxValue The largest valid number.
+ * @param num Where the number is stored.
+ * @return 0 if successful, 1 if the number is out of range (an error is printed).
+ */
+int parsePacked(token tok, unsigned long maxValue, unsigned long *num);
+
+/**
+ * @brief Splits a binary command into the tokens of the equivalent text command.
+ *
+ * A binary command is FRAME_MAGIC, the operation in a byte and the number of
+ * bytes of the set names in 2 bytes. Each set name follows as its length in
+ * a byte and its characters, then the number of elements in 4 bytes and the
+ * elements, 4 bytes each. Every number is stored least significant byte
+ * first. The elements are the list of read_set and the number of rank_set
+ * and select_set. Only the commands up to drop_set have a binary form.
+ *
+ * @param frame The binary command, as returned by read_line.
+ * @param tokens Array of 5 tokens filled from the command.
+ * @return 0 if successful, 1 if the command is malformed (an error is printed).
+ */
+int frameTokens(char *frame, token tokens[]);
+
+/**
+ * @brief Parses a set name and returns a pointer to the corresponding set.
+ *
+ * @param set_name Name of the set to parse.
+ * @param R Registry of the named sets.
+ * @return Pointer to the corresponding set, or NULL if the set name is invalid.
+ */
+set *parseSet(token set_name, registry *R);
+
+/**
+ * @brief Builds the hash table of the command names.
+ *
+ * The table is built on the first lookup, a server builds it before its
+ * clients look up commands concurrently.
+ */
+void initCommands(void);
+
+/**
+ * @brief Looks up the operation of a command without reporting unknown names.
+ *
+ * @param command Token representing the command.
+ * @return The corresponding operation enum value, NONE_OPERATION if there is none.
+ */
+Operation findCommand(token command);
+
+/**
+ * @brief Retrieves the command name of an operation.
+ *
+ * @param opr The operation.
+ * @return The name of the command, "unknown" for NONE_OPERATION.
+ */
+const char *commandName(Operation opr);
+
+/**
+ * @brief Parses a command string and returns the corresponding operation.
+ *
+ * @param command Token representing the command to parse.
+ * @return The corresponding operation enum value.
+ */
+Operation parseCommand(token command);
+
+#endif /* SET_UTILS_H */
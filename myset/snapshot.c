@@ -0,0 +1,553 @@
+/**
+ * @file snapshot.c
+ * @brief Binary snapshots of every set of a registry.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+#include "roaring.h"
+
+#define SNAPSHOT_CHUNK 1024 /**< Define the number of elements of a roaring set written at a time */
+
+/**
+ * @brief Structure representing the header of a snapshot file.
+ */
+typedef struct {
+    char magic[8];            /**< SNAPSHOT_MAGIC, without its terminator */
+    unsigned long version;    /**< Version of the format */
+    unsigned long byteOrder;  /**< SNAPSHOT_BYTE_ORDER as stored by the machine that saved it */
+    unsigned long wordSize;   /**< Size of a word in bytes */
+    unsigned long maxValue;   /**< Largest element of the universe of the registry */
+    unsigned long kind;       /**< Representation of the new sets of the registry */
+    unsigned long count;      /**< Number of sets */
+    unsigned long tableSize;  /**< Number of bytes of the directory, the data starts right after it */
+    unsigned long generation; /**< Generation of the command log the snapshot starts, 0 without a log */
+    unsigned long checksum;   /**< Checksum of the header, with this field 0, and of the directory */
+} snapshotHeader;
+
+/**
+ * @brief Structure representing the entry of a set in the directory.
+ *
+ * Every offset is counted from the start of the file.
+ */
+typedef struct {
+    unsigned long nameOffset;  /**< Offset of the name */
+    unsigned long nameLen;     /**< Number of characters in the name */
+    unsigned long defOffset;   /**< Offset of the definition of a derived set */
+    unsigned long defLen;      /**< Number of characters in the definition, 0 for a plain set */
+    unsigned long inputOffset; /**< Offset of the indices of the entries of the inputs, one word each */
+    unsigned long inputCount;  /**< Number of inputs */
+    unsigned long kind;        /**< Representation of the set */
+    unsigned long maxValue;    /**< Largest element of the universe of the set */
+    unsigned long dataOffset;  /**< Offset of the data, a multiple of SET_ALIGN */
+    unsigned long dataLen;     /**< Number of bytes of data */
+    unsigned long checksum;    /**< Checksum of the data */
+} snapshotEntry;
+
+/**
+ * @brief Structure representing a set of the registry and its position in the snapshot.
+ */
+typedef struct {
+    namedSet *node; /**< The set */
+    size_t slot;    /**< Slot of the set in the registry */
+    size_t index;   /**< Index of its entry, or the number of sets until it has one */
+} setPosition;
+
+/**
+ * @brief Allocates memory, exiting the program if the allocation fails.
+ *
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the allocated memory, filled with zeros.
+ */
+static void *allocZeroed(size_t size) {
+    void *ptr = calloc(size ? size : 1, 1);
+
+    if(!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Rounds a size up to a multiple of SET_ALIGN.
+ *
+ * @param size The size.
+ * @return The smallest multiple of SET_ALIGN not less than size.
+ */
+static size_t alignUp(size_t size) {
+    return (size + SET_ALIGN - 1) / SET_ALIGN * SET_ALIGN;
+}
+
+/**
+ * @brief Adds words to a checksum.
+ *
+ * Each word is mixed into the checksum by steps that never map two
+ * checksums to the same one, so changing any single word of the input
+ * always changes the result, wherever the word is and whatever its bits.
+ *
+ * @param sum The checksum, updated, CHECKSUM_SEED before the first word.
+ * @param words The words.
+ * @param n Number of words.
+ */
+void addChecksum(unsigned long *sum, const unsigned long *words, size_t n) {
+    unsigned long h = *sum;
+    size_t i;
+
+    for(i = 0; i < n; i++) {
+        h = (h ^ words[i]) * 2654435761UL;
+        h ^= h >> 15;
+    }
+    *sum = h;
+}
+
+/**
+ * @brief Compares two set positions by the address of their sets.
+ *
+ * @param a Pointer to the first position.
+ * @param b Pointer to the second position.
+ * @return A negative number, 0 or a positive number as the first set comes before, with or after the second.
+ */
+static int comparePositions(const void *a, const void *b) {
+    size_t x = (size_t)((const setPosition *)a)->node, y = (size_t)((const setPosition *)b)->node;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Finds the position of a set.
+ *
+ * @param positions Positions of every set, sorted by address.
+ * @param count Number of sets.
+ * @param node The set.
+ * @return Pointer to its position.
+ */
+static setPosition *findPosition(setPosition *positions, size_t count, namedSet *node) {
+    setPosition key;
+
+    key.node = node;
+    return (setPosition *)bsearch(&key, positions, count, sizeof(setPosition), comparePositions);
+}
+
+/**
+ * @brief Orders the sets of a registry so that every derived set comes after its inputs.
+ *
+ * @param R Pointer to the registry.
+ * @param positions Positions of every set, sorted by address, their index is filled.
+ * @return Slots of the sets in the order of their entries, to be released with free.
+ */
+static size_t *orderSets(registry *R, setPosition *positions) {
+    size_t *order = (size_t *)allocZeroed(R->count * sizeof(size_t)), done = 0, before, i, j;
+    namedSet *node;
+
+    /* The plain sets come first, then each derived set once all its inputs have an entry */
+    do {
+        before = done;
+        for(i = 0; i < R->count; i++) {
+            node = positions[i].node;
+            if(positions[i].index < R->count) continue;
+
+            for(j = 0; j < node->inputCount && findPosition(positions, R->count, node->inputs[j])->index < R->count; j++);
+            if(j < node->inputCount) continue;
+
+            positions[i].index = done;
+            order[done++] = positions[i].slot;
+        }
+    } while(done > before);
+    return order;
+}
+
+/**
+ * @brief Writes bytes to a snapshot file.
+ *
+ * @param file The file.
+ * @param data The bytes.
+ * @param len Number of bytes.
+ * @param sum Checksum the bytes are added to, or NULL.
+ * @return 0 if successful, 1 if the write failed.
+ */
+static int writeData(FILE *file, const void *data, size_t len, unsigned long *sum) {
+    if(sum) addChecksum(sum, (const unsigned long *)data, len / sizeof(unsigned long));
+    return fwrite(data, 1, len, file) != len;
+}
+
+/**
+ * @brief Writes the elements of a roaring set to a snapshot file, one per word.
+ *
+ * @param file The file.
+ * @param A Pointer to the set.
+ * @param sum Checksum the elements are added to.
+ * @return 0 if successful, 1 if the write failed.
+ */
+static int writeElements(FILE *file, set *A, unsigned long *sum) {
+    unsigned long chunk[SNAPSHOT_CHUNK], num;
+    size_t len = 0;
+    int found;
+
+    for(found = firstInSet(A, &num); found; found = nextInSet(A, &num)) {
+        chunk[len++] = num;
+        if(len < SNAPSHOT_CHUNK) continue;
+
+        if(writeData(file, chunk, sizeof(chunk), sum)) return 1;
+        len = 0;
+    }
+    return writeData(file, chunk, len * sizeof(unsigned long), sum);
+}
+
+/**
+ * @brief Writes the header, the directory and the data of a snapshot.
+ *
+ * @param R Pointer to the registry.
+ * @param file The file, empty.
+ * @param generation Generation of the command log the snapshot starts.
+ * @return 0 if successful, 1 if a write failed.
+ */
+static int writeSnapshot(registry *R, FILE *file, unsigned long generation) {
+    static const char padding[SET_ALIGN] = { 0 };
+    snapshotHeader header;
+    snapshotEntry *entries;
+    setPosition *positions;
+    size_t *order, i, j, tableSize, strings, offset;
+    unsigned long sum, *inputs;
+    registryEntry *slot;
+    namedSet *node;
+    char *table;
+    int failed = 0;
+
+    /* Each set remembers its slot, and gets an entry index once ordered */
+    positions = (setPosition *)allocZeroed((R->count ? R->count : 1) * sizeof(setPosition));
+    for(i = j = 0; i < R->capacity; i++) {
+        if(!R->slots[i].name) continue;
+        positions[j].node = R->slots[i].value;
+        positions[j].slot = i;
+        positions[j++].index = R->count;
+    }
+    qsort(positions, R->count, sizeof(setPosition), comparePositions);
+    order = orderSets(R, positions);
+
+    /* The directory holds the entries, then the names, definitions and inputs, padded so the data is aligned */
+    strings = sizeof(snapshotHeader) + R->count * sizeof(snapshotEntry);
+    tableSize = strings;
+    for(i = 0; i < R->count; i++) {
+        slot = &R->slots[order[i]];
+        tableSize += (slot->len + (slot->value->definition ? strlen(slot->value->definition) : 0) + sizeof(unsigned long) - 1)
+                     / sizeof(unsigned long) * sizeof(unsigned long) + slot->value->inputCount * sizeof(unsigned long);
+    }
+    tableSize = alignUp(tableSize) - sizeof(snapshotHeader);
+    table = (char *)allocZeroed(tableSize);
+    entries = (snapshotEntry *)table;
+
+    /* Lay out the directory and the data */
+    offset = sizeof(snapshotHeader) + tableSize;
+    for(i = 0; i < R->count; i++) {
+        slot = &R->slots[order[i]];
+        node = slot->value;
+
+        entries[i].nameOffset = strings;
+        entries[i].nameLen = slot->len;
+        memcpy(table + strings - sizeof(snapshotHeader), slot->name, slot->len);
+        strings += slot->len;
+
+        if(node->definition) {
+            entries[i].defOffset = strings;
+            entries[i].defLen = strlen(node->definition);
+            memcpy(table + strings - sizeof(snapshotHeader), node->definition, entries[i].defLen);
+            strings += entries[i].defLen;
+        }
+
+        strings = (strings + sizeof(unsigned long) - 1) / sizeof(unsigned long) * sizeof(unsigned long);
+        entries[i].inputOffset = strings;
+        entries[i].inputCount = node->inputCount;
+        inputs = (unsigned long *)(table + strings - sizeof(snapshotHeader));
+        for(j = 0; j < node->inputCount; j++)
+            inputs[j] = findPosition(positions, R->count, node->inputs[j])->index;
+        strings += node->inputCount * sizeof(unsigned long);
+
+        entries[i].kind = (unsigned long)getKind(&node->value);
+        entries[i].maxValue = getMaxValue(&node->value);
+        entries[i].dataOffset = offset;
+
+        /* A derived set is computed again after loading, so its data is not saved */
+        if(node->definition) entries[i].dataLen = 0;
+        else if(getKind(&node->value) == SET_BITMAP) entries[i].dataLen = getWordCount(&node->value) * sizeof(setWord);
+        else entries[i].dataLen = countSet(&node->value) * sizeof(unsigned long);
+        offset = alignUp(offset + entries[i].dataLen);
+    }
+
+    /* The data comes first, its checksums go in the directory written afterwards */
+    if(fseek(file, (long)(sizeof(snapshotHeader) + tableSize), SEEK_SET)) failed = 1;
+    for(i = 0; i < R->count && !failed; i++) {
+        node = R->slots[order[i]].value;
+        sum = CHECKSUM_SEED;
+
+        if(!entries[i].dataLen);
+        else if(getKind(&node->value) == SET_BITMAP) failed = writeData(file, getData(&node->value), entries[i].dataLen, &sum);
+        else failed = writeElements(file, &node->value, &sum);
+        entries[i].checksum = sum;
+
+        if(!failed && i + 1 < R->count)
+            failed = writeData(file, padding, entries[i + 1].dataOffset - entries[i].dataOffset - entries[i].dataLen, NULL);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.wordSize = sizeof(setWord);
+    header.maxValue = R->maxValue;
+    header.kind = (unsigned long)R->kind;
+    header.count = R->count;
+    header.tableSize = tableSize;
+    header.generation = generation;
+    sum = CHECKSUM_SEED;
+    addChecksum(&sum, (const unsigned long *)&header, sizeof(header) / sizeof(unsigned long));
+    addChecksum(&sum, (const unsigned long *)table, tableSize / sizeof(unsigned long));
+    header.checksum = sum;
+
+    if(!failed) failed = fseek(file, 0, SEEK_SET) || writeData(file, &header, sizeof(header), NULL) ||
+                         writeData(file, table, tableSize, NULL);
+
+    free(table);
+    free(order);
+    free(positions);
+    return failed;
+}
+
+/**
+ * @brief Saves every set of a registry to a snapshot file.
+ *
+ * The snapshot is written to a temporary file next to the path, which then
+ * replaces the file once it is on disk, so an existing snapshot is never
+ * left half written, even by a crash.
+ *
+ * @param R Pointer to the registry.
+ * @param path Path of the snapshot file.
+ * @param generation Generation of the command log the snapshot starts, 0 without a log.
+ * @return SNAPSHOT_OK if successful, SNAPSHOT_IO_ERROR otherwise.
+ */
+SnapshotStatus saveSnapshot(registry *R, const char *path, unsigned long generation) {
+    char *temp = (char *)allocZeroed(strlen(path) + 5);
+    FILE *file;
+    int failed;
+
+    strcpy(temp, path);
+    strcat(temp, ".tmp");
+
+    file = fopen(temp, "wb");
+    if(!file) {
+        free(temp);
+        return SNAPSHOT_IO_ERROR;
+    }
+    failed = writeSnapshot(R, file, generation) || fflush(file) || fsync(fileno(file));
+    failed = fclose(file) || failed || rename(temp, path);
+
+    if(failed) remove(temp);
+    free(temp);
+    return failed ? SNAPSHOT_IO_ERROR : SNAPSHOT_OK;
+}
+
+/**
+ * @brief Checks that a range of bytes lies within a region of the file.
+ *
+ * @param offset Offset of the range.
+ * @param len Number of bytes of the range.
+ * @param start Offset of the region.
+ * @param end Offset of the end of the region.
+ * @return 1 if the range is inside the region, 0 otherwise.
+ */
+static int inRegion(unsigned long offset, unsigned long len, unsigned long start, unsigned long end) {
+    return offset >= start && offset <= end && len <= end - offset;
+}
+
+/**
+ * @brief Checks an entry of the directory and its data.
+ *
+ * @param base Start of the mapped file.
+ * @param size Size of the file in bytes.
+ * @param header The header of the snapshot.
+ * @param e The entry.
+ * @param index Index of the entry.
+ * @return 1 if the entry is valid, 0 otherwise.
+ */
+static int checkEntry(const char *base, size_t size, const snapshotHeader *header, const snapshotEntry *e, size_t index) {
+    unsigned long tableEnd = sizeof(snapshotHeader) + header->tableSize, sum = CHECKSUM_SEED;
+    const unsigned long *words = (const unsigned long *)(base + e->dataOffset);
+    size_t n = e->dataLen / sizeof(unsigned long), i;
+    const unsigned long *inputs;
+
+    /* The name, the definition and the inputs are part of the directory */
+    if(!e->nameLen || !inRegion(e->nameOffset, e->nameLen, sizeof(snapshotHeader), tableEnd) ||
+       (e->defLen && !inRegion(e->defOffset, e->defLen, sizeof(snapshotHeader), tableEnd)) ||
+       e->inputOffset % sizeof(unsigned long) || e->inputCount > index ||
+       !inRegion(e->inputOffset, e->inputCount * sizeof(unsigned long), sizeof(snapshotHeader), tableEnd))
+        return 0;
+
+    /* A derived set only uses sets of earlier entries */
+    inputs = (const unsigned long *)(base + e->inputOffset);
+    for(i = 0; i < e->inputCount; i++)
+        if(inputs[i] >= index) return 0;
+    if(!e->defLen && e->inputCount) return 0;
+
+    if(e->kind > SET_ROARING || e->maxValue > MAX_SET_VALUE || e->dataOffset % SET_ALIGN ||
+       e->dataLen % sizeof(unsigned long) || !inRegion(e->dataOffset, e->dataLen, tableEnd, size))
+        return 0;
+
+    /* A bitmap holds at least one word and no bit beyond its universe,
+     * a roaring set holds increasing elements of its universe */
+    if(e->defLen) {
+        if(e->dataLen) return 0;
+    }
+    else if(e->kind == SET_BITMAP) {
+        if(!n || n > e->maxValue / WORD_BITS + 1) return 0;
+        if(n == e->maxValue / WORD_BITS + 1 && e->maxValue % WORD_BITS < WORD_BITS - 1 &&
+           words[n - 1] >> (e->maxValue % WORD_BITS + 1))
+            return 0;
+    }
+    else {
+        for(i = 0; i < n; i++)
+            if(words[i] > e->maxValue || (i && words[i] <= words[i - 1])) return 0;
+    }
+
+    addChecksum(&sum, words, n);
+    return sum == e->checksum;
+}
+
+/**
+ * @brief Creates the sets of a snapshot in an empty registry.
+ *
+ * @param R Pointer to the registry.
+ * @param base Start of the mapped file.
+ * @param size Size of the file in bytes.
+ * @param header The header of the snapshot.
+ * @return 1 if every set was created, 0 if the snapshot is invalid.
+ */
+static int buildSets(registry *R, char *base, size_t size, const snapshotHeader *header) {
+    const snapshotEntry *entries = (const snapshotEntry *)(base + sizeof(snapshotHeader)), *e;
+    set **sets = (set **)allocZeroed(header->count * sizeof(set *));
+    set **inputs = (set **)allocZeroed(header->count * sizeof(set *));
+    const unsigned long *indices;
+    size_t i, j;
+    set *A;
+
+    for(i = 0; i < header->count; i++) {
+        e = &entries[i];
+        if(!checkEntry(base, size, header, e, i)) break;
+
+        if(e->defLen) {
+            indices = (const unsigned long *)(base + e->inputOffset);
+            for(j = 0; j < e->inputCount; j++)
+                inputs[j] = sets[indices[j]];
+            A = defineSet(R, base + e->nameOffset, e->nameLen, base + e->defOffset, e->defLen, inputs, e->inputCount);
+        }
+        else A = createSet(R, base + e->nameOffset, e->nameLen);
+
+        /* Names are unique */
+        if(!A) break;
+        sets[i] = A;
+
+        if(getKind(A) != (SetKind)e->kind || getMaxValue(A) != e->maxValue) {
+            freeSet(A);
+            initSet(A, e->maxValue, (SetKind)e->kind);
+        }
+        if(e->defLen) continue;
+
+        /* A bitmap uses the words of the mapping, a roaring set is built from its elements */
+        if(e->kind == SET_BITMAP) adoptWords(A, (setWord *)(base + e->dataOffset), e->dataLen / sizeof(setWord));
+        else {
+            freeRoaring(A->sparse);
+            A->sparse = roaringFromArray((const unsigned long *)(base + e->dataOffset), e->dataLen / sizeof(unsigned long));
+        }
+    }
+
+    free(sets);
+    free(inputs);
+    return i == header->count;
+}
+
+/**
+ * @brief Replaces every set of a registry with the sets of a snapshot file.
+ *
+ * The registry takes the universe and the representation of the snapshot.
+ * It is left unchanged if the file cannot be loaded.
+ *
+ * @param R Pointer to the registry.
+ * @param path Path of the snapshot file.
+ * @param generation Where the generation of the command log the snapshot starts is stored, or NULL.
+ * @return SNAPSHOT_OK if successful, SNAPSHOT_IO_ERROR or SNAPSHOT_INVALID otherwise.
+ */
+SnapshotStatus loadSnapshot(registry *R, const char *path, unsigned long *generation) {
+    snapshotHeader header;
+    unsigned long sum = CHECKSUM_SEED, checksum;
+    registry loaded;
+    struct stat st;
+    size_t size;
+    char *base;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0) return SNAPSHOT_IO_ERROR;
+    if(fstat(fd, &st)) {
+        close(fd);
+        return SNAPSHOT_IO_ERROR;
+    }
+    if(st.st_size < (off_t)sizeof(snapshotHeader)) {
+        close(fd);
+        return SNAPSHOT_INVALID;
+    }
+
+    /* Private pages are copied on the first write, the file itself never changes */
+    size = (size_t)st.st_size;
+    base = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == (char *)MAP_FAILED) return SNAPSHOT_IO_ERROR;
+
+    /* The header must come from this format version and machine, and match its checksum */
+    memcpy(&header, base, sizeof(header));
+    checksum = header.checksum;
+    header.checksum = 0;
+    if(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) || header.version != SNAPSHOT_VERSION ||
+       header.byteOrder != SNAPSHOT_BYTE_ORDER || header.wordSize != sizeof(setWord) ||
+       header.maxValue > MAX_SET_VALUE || header.kind > SET_ROARING || (sizeof(header) + header.tableSize) % SET_ALIGN ||
+       header.tableSize > size - sizeof(header) || header.count > header.tableSize / sizeof(snapshotEntry)) {
+        munmap(base, size);
+        return SNAPSHOT_INVALID;
+    }
+    addChecksum(&sum, (const unsigned long *)&header, sizeof(header) / sizeof(unsigned long));
+    addChecksum(&sum, (const unsigned long *)(base + sizeof(header)), header.tableSize / sizeof(unsigned long));
+    if(sum != checksum) {
+        munmap(base, size);
+        return SNAPSHOT_INVALID;
+    }
+
+    /* The sets are built aside, so a snapshot found invalid midway leaves the registry as it was */
+    initRegistry(&loaded, header.maxValue, (SetKind)header.kind);
+    if(!buildSets(&loaded, base, size, &header)) {
+        freeRegistry(&loaded);
+        munmap(base, size);
+        return SNAPSHOT_INVALID;
+    }
+
+    keepMapping(&loaded, base, size);
+    replaceRegistry(R, &loaded);
+    if(generation) *generation = header.generation;
+    return SNAPSHOT_OK;
+}
+
+/**
+ * @brief Retrieves the message describing the outcome of a snapshot operation.
+ *
+ * @param status The outcome.
+ * @return The message, without a newline.
+ */
+const char *snapshotMessage(SnapshotStatus status) {
+    switch(status) {
+        case SNAPSHOT_OK: return "Snapshot done";
+        case SNAPSHOT_IO_ERROR: return "Cannot access snapshot file";
+        default: return "Invalid snapshot file";
+    }
+}
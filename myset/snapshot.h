@@ -0,0 +1,86 @@
+/**
+ * @file snapshot.h
+ * @brief Binary snapshots of every set of a registry.
+ *
+ * A snapshot file starts with a header, followed by a directory with one
+ * entry per set and the names, definitions and inputs the entries refer to,
+ * followed by the data of the sets:
+ *   - a bitmap set stores the raw words of its data array, each array starting
+ *     on a SET_ALIGN boundary of the file,
+ *   - a roaring set stores its elements in increasing order, one per word,
+ *   - a derived set stores its definition and the entries of its inputs,
+ *     which always come before it, and no data since it is computed again.
+ * The header records the format version, the byte order, the word size and
+ * the generation of the command log the snapshot was compacted from, and
+ * checksums cover the header with the directory and the data of each set.
+ *
+ * Loading maps the file privately into memory, and bitmap sets use the words
+ * of the mapping in place, so no element is parsed or copied. A page of the
+ * mapping is only copied when a command first writes to it. Loading still
+ * reads every page once to check the data checksums.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "registry.h"
+
+#define SNAPSHOT_MAGIC "MYSETSNP"        /**< Define the first bytes of a snapshot file */
+#define SNAPSHOT_VERSION 2UL             /**< Define the version of the format written */
+#define SNAPSHOT_BYTE_ORDER 0x01020304UL /**< Define the number whose bytes record the byte order */
+#define CHECKSUM_SEED 0x5EEDUL           /**< Define the checksum of no words */
+
+/**
+ * @brief Enumeration representing the outcome of saving or loading a snapshot.
+ */
+typedef enum {
+    SNAPSHOT_OK,       /**< The snapshot was saved or loaded */
+    SNAPSHOT_IO_ERROR, /**< The file could not be created, written, opened or mapped */
+    SNAPSHOT_INVALID   /**< The file is not a snapshot of this version and machine, or is corrupted */
+} SnapshotStatus;
+
+/**
+ * @brief Saves every set of a registry to a snapshot file.
+ *
+ * The snapshot is written to a temporary file next to the path, which then
+ * replaces the file once it is on disk, so an existing snapshot is never
+ * left half written, even by a crash.
+ *
+ * @param R Pointer to the registry.
+ * @param path Path of the snapshot file.
+ * @param generation Generation of the command log the snapshot starts, 0 without a log.
+ * @return SNAPSHOT_OK if successful, SNAPSHOT_IO_ERROR otherwise.
+ */
+SnapshotStatus saveSnapshot(registry *R, const char *path, unsigned long generation);
+
+/**
+ * @brief Replaces every set of a registry with the sets of a snapshot file.
+ *
+ * The registry takes the universe and the representation of the snapshot.
+ * It is left unchanged if the file cannot be loaded.
+ *
+ * @param R Pointer to the registry.
+ * @param path Path of the snapshot file.
+ * @param generation Where the generation of the command log the snapshot starts is stored, or NULL.
+ * @return SNAPSHOT_OK if successful, SNAPSHOT_IO_ERROR or SNAPSHOT_INVALID otherwise.
+ */
+SnapshotStatus loadSnapshot(registry *R, const char *path, unsigned long *generation);
+
+/**
+ * @brief Retrieves the message describing the outcome of a snapshot operation.
+ *
+ * @param status The outcome.
+ * @return The message, without a newline.
+ */
+const char *snapshotMessage(SnapshotStatus status);
+
+/**
+ * @brief Adds words to a checksum.
+ *
+ * @param sum The checksum, updated, CHECKSUM_SEED before the first word.
+ * @param words The words.
+ * @param n Number of words.
+ */
+void addChecksum(unsigned long *sum, const unsigned long *words, size_t n);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,161 @@
+/**
+ * @file stats_utils.c
+ * @brief Latency statistics of the commands.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "stats_utils.h"
+#include "output_utils.h"
+
+/**
+ * @brief Structure representing the statistics of one phase of an operation.
+ */
+typedef struct {
+    unsigned long count;                  /**< Number of commands timed */
+    unsigned long total;                  /**< Total time in nanoseconds */
+    unsigned long buckets[STATS_BUCKETS]; /**< Number of latencies in [2^b, 2^(b+1)) nanoseconds, bucket 0 also holds 0 */
+} phaseStats;
+
+static phaseStats stats[NONE_OPERATION + 1][PHASE_COUNT]; /**< Statistics of each operation and phase */
+static int statsOn = 0;                                   /**< 1 if the commands are timed */
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER; /**< Guards the statistics, the clients of a server share them */
+
+static const char *phaseNames[PHASE_COUNT] = { "parse", "validate", "execute", "commit" };
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return The current time in nanoseconds, it may wrap around but differences stay exact.
+ */
+static unsigned long readClock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000UL + (unsigned long)ts.tv_nsec;
+}
+
+/**
+ * @brief Turns the timing of the commands on or off.
+ *
+ * @param enabled 1 to time the commands, 0 to stop.
+ */
+void setStats(int enabled) {
+    pthread_mutex_lock(&statsLock);
+    statsOn = enabled;
+    pthread_mutex_unlock(&statsLock);
+}
+
+/**
+ * @brief Reads the clock at the start of a command.
+ *
+ * @return The current time in nanoseconds, or 0 if the timing is off.
+ */
+unsigned long startStats(void) {
+    int on;
+
+    pthread_mutex_lock(&statsLock);
+    on = statsOn;
+    pthread_mutex_unlock(&statsLock);
+
+    /* A time of 0 means the command is not timed, so it is moved by one nanosecond */
+    return on ? readClock() | 1 : 0;
+}
+
+/**
+ * @brief Records the end of a phase of a command.
+ *
+ * @param opr Operation of the command.
+ * @param phase The phase that ended.
+ * @param mark Time the phase started at, as returned by startStats, replaced by the current time.
+ * @note Nothing is recorded if the timing was off when the command started.
+ */
+void recordPhase(Operation opr, StatsPhase phase, unsigned long *mark) {
+    phaseStats *s = &stats[opr][phase];
+    unsigned long now, elapsed, rest;
+    int b;
+
+    if(!*mark) return;
+
+    now = readClock() | 1;
+    elapsed = now - *mark;
+    *mark = now;
+
+    for(b = 0, rest = elapsed; rest > 1 && b < STATS_BUCKETS - 1; rest >>= 1) b++;
+
+    pthread_mutex_lock(&statsLock);
+    s->count++;
+    s->total += elapsed;
+    s->buckets[b]++;
+    pthread_mutex_unlock(&statsLock);
+}
+
+/**
+ * @brief Clears the statistics of every operation.
+ */
+void resetStats(void) {
+    pthread_mutex_lock(&statsLock);
+    memset(stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&statsLock);
+}
+
+/**
+ * @brief Prints the histogram of one phase of an operation.
+ *
+ * @param s Pointer to the statistics of the phase.
+ * @param phase The phase.
+ */
+static void printPhase(phaseStats *s, StatsPhase phase) {
+    int b;
+
+    writeStr("  ");
+    writeStr(phaseNames[phase]);
+    writeStr(": total ");
+    writeNum(s->total);
+    writeStr(" ns, mean ");
+    writeNum(s->total / s->count);
+    writeStr(" ns\n");
+
+    /* Only the buckets that hold latencies are printed */
+    for(b = 0; b < STATS_BUCKETS; b++) {
+        if(!s->buckets[b]) continue;
+
+        writeStr("    ");
+        writeNum(b ? 1UL << b : 0);
+        if(b < STATS_BUCKETS - 1) {
+            writeChar('-');
+            writeNum((2UL << b) - 1);
+        }
+        else writeChar('+');
+        writeStr(" ns: ");
+        writeNum(s->buckets[b]);
+        writeChar('\n');
+    }
+}
+
+/**
+ * @brief Prints the statistics of every operation that was timed.
+ */
+void print_stats(void) {
+    int opr, phase, timed = 0;
+
+    pthread_mutex_lock(&statsLock);
+    for(opr = 0; opr <= NONE_OPERATION; opr++) {
+        /* Every timed command goes through the parse phase */
+        if(!stats[opr][PHASE_PARSE].count) continue;
+        timed = 1;
+
+        writeStr(commandName((Operation)opr));
+        writeStr(": ");
+        writeNum(stats[opr][PHASE_PARSE].count);
+        writeStr(" commands\n");
+
+        for(phase = 0; phase < PHASE_COUNT; phase++)
+            if(stats[opr][phase].count) printPhase(&stats[opr][phase], (StatsPhase)phase);
+    }
+
+    pthread_mutex_unlock(&statsLock);
+
+    if(!timed) writeStr("No commands were timed\n");
+}
@@ -0,0 +1,66 @@
+/**
+ * @file stats_utils.h
+ * @brief Latency statistics of the commands.
+ *
+ * Each command is timed in three phases: parsing its tokens, validating them
+ * and executing the operation, and a fourth one committing it to the command
+ * log when there is one. Every operation keeps, for each phase, the
+ * number of commands, their total time and a histogram of their latencies
+ * with one bucket per power of two nanoseconds. The timing is always compiled
+ * in, but while it is off each phase only checks a flag. The clients of a
+ * server share the statistics.
+ */
+
+#ifndef STATS_UTILS_H
+#define STATS_UTILS_H
+
+#include "set_utils.h"
+
+#define STATS_BUCKETS 40 /**< Define the number of histogram buckets, the last one holds every longer latency */
+
+/**
+ * @brief Enumeration representing the timed phases of a command.
+ */
+typedef enum {
+    PHASE_PARSE,    /**< Tokenizing the command and looking up its sets */
+    PHASE_VALIDATE, /**< Checking the parameters with prompt_err */
+    PHASE_EXECUTE,  /**< Performing the operation */
+    PHASE_COMMIT,   /**< Waiting for the record of the command to reach the command log on disk */
+    PHASE_COUNT     /**< Number of phases */
+} StatsPhase;
+
+/**
+ * @brief Turns the timing of the commands on or off.
+ *
+ * @param enabled 1 to time the commands, 0 to stop.
+ */
+void setStats(int enabled);
+
+/**
+ * @brief Reads the clock at the start of a command.
+ *
+ * @return The current time in nanoseconds, or 0 if the timing is off.
+ */
+unsigned long startStats(void);
+
+/**
+ * @brief Records the end of a phase of a command.
+ *
+ * @param opr Operation of the command.
+ * @param phase The phase that ended.
+ * @param mark Time the phase started at, as returned by startStats, replaced by the current time.
+ * @note Nothing is recorded if the timing was off when the command started.
+ */
+void recordPhase(Operation opr, StatsPhase phase, unsigned long *mark);
+
+/**
+ * @brief Clears the statistics of every operation.
+ */
+void resetStats(void);
+
+/**
+ * @brief Prints the statistics of every operation that was timed.
+ */
+void print_stats(void);
+
+#endif /* STATS_UTILS_H */
@@ -1,177 +1,366 @@
-/**
- * @file string_utils.c
- * @brief A collection of utility functions for string manipulation.
- */
-
-#include <stdio.h>
-#include <stdlib.h>
-
-/**
- * @brief Reads a line of input from stdin.
- *
- * @param prompt The prompt to display to the user.
- * @return A dynamically allocated string containing the input line.
- * @note It is the caller's responsibility to free this memory.
- */
-char *read_line(char *prompt) {
-    int size = 2, i = 0;
-    /* Allocate initial memory */
-    char c, *str = (char *)malloc(size), *tmp;
-
-    /* Check if memory allocation was successful */
-    if(!str){
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
-    /* Display the prompt to the user */
-    printf("%s", prompt);
-
-    /* Read characters until EOF or newline */
-    while((c = (char)getchar()) != EOF && c != '\n') {
-        if(i == size - 1) {
-            size *= 2;
-            tmp = (char *)realloc(str, size);
-            /* Check if memory reallocation was successful */
-            if(!tmp) {
-                fprintf(stderr, "Memory reallocation failed\n");
-                free(str);
-                exit(EXIT_FAILURE);
-            }
-            str = tmp;
-        }
-        /* Store the character */
-        str[i++] = c;
-    }
-
-    /* Handle EOF condition */
-    if(c == EOF && i == 0) {
-        printf("End of file reached\n");
-        free(str);
-        return NULL;
-    }
-
-    /* Null-terminate the string */
-    str[i] = '\0';
-    return str;
-}
-
-/**
- * @brief Extracts the first token from a string.
- *
- * @param str The input string.
- * @param dest The destination buffer to store the token.
- * @return 0 if successful, 1 if error occurred.
- */
-int firstToken(char **str, char *dest) {
-    int i = 0;
-
-    /* Skip leading spaces */
-    for(; **str && (**str == ' ' || **str == '\t'); *str += 1);
-    /* Check for empty string */
-    if(!(**str)) {
-        printf("Non-content input\n");
-        return 1;
-    }
-
-    /* Extract token */
-    while(**str && **str != ' ' && **str != '\t' && **str != ',') {
-        dest[i++] = **str;
-        *str += 1;
-    }
-    /* Null-terminate the token */
-    dest[i] = '\0';
-
-    /* Skip trailing spaces */
-    for(; **str && (**str == ' ' || **str == '\t'); *str += 1);
-    /* Check for illegal comma */
-    if(**str == ',') {
-        printf("Illegal comma\n");
-        return 1;
-    }
-    return 0;
-}
-
-/**
- * @brief Extracts the next token from a string.
- *
- * @param str The input string.
- * @param dest The destination buffer to store the token.
- * @return 0 if successful, 1 if error occurred.
- */
-int nextToken(char **str, char *dest) {
-    int i = 0;
-    int cntCommas = 0;
-
-    /* Extract token */
-    while(**str && **str != ' ' && **str != '\t' && **str != ',') {
-        dest[i++] = **str;
-        *str += 1;
-    }
-    /* Null-terminate the token */
-    dest[i] = '\0';
-
-    /* Skip spaces and commas */
-    for(; **str && (**str == ' ' || **str == '\t' || **str == ','); *str += 1)
-        /* Count commas */
-        if(**str == ',') cntCommas++;
-    /* Check for end of string */
-    if(!(**str)) {
-        /* Handle extraneous text */
-        if(cntCommas > 0) {
-            printf("Extraneous text after end of command\n");
-            return 1;
-        }
-        return 0;
-    }
-    /* Handle different comma cases */
-    switch(cntCommas) {
-        case 0:
-            printf("Missing comma\n");
-            return 1;
-        case 1: return 0;
-        default:
-            printf("Multiple consecutive commas\n");
-            return 1;
-    }
-}
-
-/**
- * @brief Allocates memory for an array of strings.
- *
- * @param ptrArr The array of string pointers.
- * @param len The length of the array.
- * @param allocSize The size to allocate for each string.
- * @note This function dynamically allocates memory for each string in ptrArr.
- *       It is the caller's responsibility to free this memory.
- */
-void allocPtrArray(char *ptrArr[], int len, size_t allocSize) {
-    int i;
-
-
-    for(i = 0; i < len; i++) {
-        /* Allocate memory for each string */
-        ptrArr[i] = (char *)malloc(allocSize);
-        /* Check if memory allocation was successful */
-        if(!ptrArr[i]) {
-            fprintf(stderr, "Memory allocation failed\n");
-            /* Free already allocated memory */
-            while(i > 0) free(ptrArr[--i]);
-            exit(EXIT_FAILURE);
-        }
-    }
-}
-
-/**
- * @brief Frees memory allocated for an array of strings.
- *
- * @param ptrArr The array of string pointers.
- * @param len The length of the array.
- * @note This function frees memory allocated for each string in ptrArr.
- */
-void freePtrArray(char *ptrArr[], int len) {
-    int i;
-
-    /* Free each string */
-    for(i = 0; i < len; i++)
-        free(ptrArr[i]);
-}
\ No newline at end of file
+/**
+ * @file string_utils.c
+ * @brief A collection of utility functions for string manipulation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "string_utils.h"
+#include "output_utils.h"
+
+#define FNV_OFFSET 2166136261UL /**< Initial value of the 32-bit FNV-1a hash */
+#define FNV_PRIME 16777619UL    /**< Multiplier of the 32-bit FNV-1a hash */
+
+static inputStream standard = { STDIN_FILENO, NULL, 0, 0, 0, 0, -1 }; /**< Stream of the threads without their own */
+static pthread_key_t streamKey;                                        /**< Stream bound by the calling thread */
+static pthread_once_t streamOnce = PTHREAD_ONCE_INIT;                  /**< Creates streamKey once */
+static int streamsBound = 0;                                           /**< 1 once a thread bound its own stream */
+
+/**
+ * @brief Creates the key of the streams bound by the threads.
+ */
+static void createStreamKey(void) {
+    pthread_key_create(&streamKey, NULL);
+    streamsBound = 1;
+}
+
+/**
+ * @brief Finds the stream of the calling thread.
+ *
+ * @return Pointer to the stream bound by the thread, or to stdin.
+ */
+static inputStream *currentStream(void) {
+    inputStream *in;
+
+    if(!streamsBound) return &standard;
+    in = (inputStream *)pthread_getspecific(streamKey);
+    return in ? in : &standard;
+}
+
+/**
+ * @brief Makes the calling thread read its commands from a stream.
+ *
+ * The output is flushed before every read of a bound stream, since its
+ * client waits for the replies before sending more commands.
+ *
+ * @param in Pointer to the stream.
+ * @param fd Descriptor the stream reads from.
+ */
+void bindInput(inputStream *in, int fd) {
+    pthread_once(&streamOnce, createStreamKey);
+
+    memset(in, 0, sizeof(inputStream));
+    in->fd = fd;
+    in->interactive = 1;
+    pthread_setspecific(streamKey, in);
+}
+
+/**
+ * @brief Reads the next block of input after the bytes already in the buffer.
+ *
+ * The unread part of the buffer is moved to its start first, and the buffer
+ * is doubled when a single line does not fit in it.
+ *
+ * @param in Pointer to the stream.
+ */
+static void fillInput(inputStream *in) {
+    ssize_t n;
+    char *tmp;
+
+    /* Keep only the unread bytes */
+    if(in->start > 0) {
+        memmove(in->buf, in->buf + in->start, in->end - in->start);
+        in->end -= in->start;
+        in->start = 0;
+    }
+
+    /* Make room for at least one more byte and the terminator */
+    if(in->end + 1 >= in->cap) {
+        tmp = (char *)realloc(in->buf, in->cap ? in->cap * 2 : INPUT_SIZE);
+        /* Check if memory reallocation was successful */
+        if(!tmp) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        in->cap = in->cap ? in->cap * 2 : INPUT_SIZE;
+        in->buf = tmp;
+    }
+
+    do {
+        n = read(in->fd, in->buf + in->end, in->cap - in->end - 1);
+    } while(n < 0 && errno == EINTR);
+
+    /* A read error ends the input like the end of file does */
+    if(n <= 0) in->eof = 1;
+    else in->end += (size_t)n;
+}
+
+/**
+ * @brief Reads the commands from a file instead of stdin.
+ *
+ * @param path Path of the command file.
+ * @return 0 if successful, 1 if the file cannot be opened.
+ */
+int openInput(const char *path) {
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0) return 1;
+    closeInput();
+    standard.fd = fd;
+    standard.interactive = 0;
+    return 0;
+}
+
+/**
+ * @brief Releases the input buffer and closes the command file.
+ *
+ * A stream bound by the thread is closed and the thread reads stdin again.
+ */
+void closeInput(void) {
+    inputStream *in = currentStream();
+
+    if(in->fd != STDIN_FILENO) close(in->fd);
+    free(in->buf);
+    if(in != &standard) {
+        pthread_setspecific(streamKey, NULL);
+        return;
+    }
+    memset(in, 0, sizeof(inputStream));
+    in->fd = STDIN_FILENO;
+    in->interactive = -1;
+}
+
+/**
+ * @brief Checks whether the replies to the commands are awaited before more are read.
+ *
+ * @return 1 for a user typing the commands or a client of the server, 0 for a command file or a pipe.
+ */
+int isInteractive(void) {
+    inputStream *in = currentStream();
+
+    if(in->interactive < 0) in->interactive = isatty(in->fd);
+    return in->interactive;
+}
+
+/**
+ * @brief Decodes an unsigned 32-bit integer stored least significant byte first.
+ *
+ * @param bytes The 4 bytes of the integer.
+ * @return The integer.
+ */
+unsigned long unpack32(const char *bytes) {
+    const unsigned char *b = (const unsigned char *)bytes;
+
+    return (unsigned long)b[0] | (unsigned long)b[1] << 8 | (unsigned long)b[2] << 16 | (unsigned long)b[3] << 24;
+}
+
+/**
+ * @brief Computes the length of a binary command from the part of it already read.
+ *
+ * The header is the magic byte, the opcode and the number of bytes of the set
+ * names in 2 bytes, least significant byte first. The names follow it, then
+ * the number of elements in 4 bytes and 4 bytes per element.
+ *
+ * @param frame The start of the binary command.
+ * @param avail Number of bytes of the command already read.
+ * @return Number of bytes of the command, or the number of bytes needed to know it if avail is short of it.
+ */
+static size_t frameLength(const char *frame, size_t avail) {
+    const unsigned char *b = (const unsigned char *)frame;
+    size_t count = FRAME_HEADER;
+
+    if(avail < count) return count;
+    count += ((size_t)b[2] | (size_t)b[3] << 8) + 4;
+    if(avail < count) return count;
+    return count + 4 * (size_t)unpack32(frame + count - 4);
+}
+
+/**
+ * @brief Reads a binary command whole, reading more input as needed.
+ *
+ * @param in Pointer to the stream, whose next byte is FRAME_MAGIC.
+ * @return The binary command, or NULL if the input ends before it does.
+ */
+static char *readFrame(inputStream *in) {
+    size_t len;
+    char *frame;
+
+    /* The header gives the length, the buffer grows until the whole command is in it */
+    while(in->end - in->start < (len = frameLength(in->buf + in->start, in->end - in->start))) {
+        if(in->eof) {
+            in->start = in->end;
+            return NULL;
+        }
+        fillInput(in);
+    }
+
+    frame = in->buf + in->start;
+    in->start += len;
+    return frame;
+}
+
+/**
+ * @brief Reads a line of input.
+ *
+ * The input is read in large blocks and split into lines in place, so no
+ * memory is allocated per line. A binary command, starting with FRAME_MAGIC,
+ * is read whole instead of up to the next newline, and is not null-terminated.
+ *
+ * @param prompt The prompt to display to the user.
+ * @return The input line or binary command, or NULL at the end of the input.
+ * @note The line is owned by the reader and stays valid until the next call.
+ */
+char *read_line(char *prompt) {
+    inputStream *in = currentStream();
+    size_t scanned;
+    char *line, *newline;
+
+    /* Display the prompt to the user */
+    writeStr(prompt);
+
+    /* When the user is typing the commands, the prompt must be seen before reading */
+    if(isInteractive()) flushOutput();
+
+    /* The first byte tells a binary command from a line */
+    if(in->start == in->end && !in->eof) fillInput(in);
+    if(in->start < in->end && (unsigned char)in->buf[in->start] == FRAME_MAGIC) {
+        line = readFrame(in);
+        if(!line) writeStr("End of file reached\n");
+        return line;
+    }
+    scanned = in->start;
+
+    /* Search for the end of the line, reading more input as needed */
+    for(newline = NULL;;) {
+        if(scanned < in->end) newline = (char *)memchr(in->buf + scanned, '\n', in->end - scanned);
+        if(newline || in->eof) break;
+
+        /* The unread bytes move to the start of the buffer */
+        scanned = in->end - in->start;
+        fillInput(in);
+    }
+
+    /* Handle EOF condition */
+    if(!newline && in->start == in->end) {
+        writeStr("End of file reached\n");
+        return NULL;
+    }
+
+    /* Null-terminate the line in place, the last line may lack a newline */
+    line = in->buf + in->start;
+    if(newline) {
+        *newline = '\0';
+        in->start = (size_t)(newline - in->buf) + 1;
+    }
+    else {
+        in->buf[in->end] = '\0';
+        in->start = in->end;
+    }
+    return line;
+}
+
+/**
+ * @brief Checks whether a token is equal to a string.
+ *
+ * @param tok The token.
+ * @param str The null-terminated string.
+ * @return 1 if they hold the same characters, 0 otherwise.
+ */
+int tokenEquals(token tok, const char *str) {
+    return !strncmp(tok.ptr, str, tok.len) && !str[tok.len];
+}
+
+/**
+ * @brief Hashes characters with the FNV-1a hash.
+ *
+ * @param str The characters, not necessarily null-terminated.
+ * @param len Number of characters.
+ * @return The hash of the characters.
+ */
+unsigned long hashChars(const char *str, size_t len) {
+    unsigned long hash = FNV_OFFSET;
+
+    while(len--) {
+        hash ^= (unsigned char)*str++;
+        hash = (hash * FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Extracts the first token from a string.
+ *
+ * @param str The input string.
+ * @param dest The token, a view into the input string.
+ * @return 0 if successful, 1 if error occurred.
+ */
+int firstToken(char **str, token *dest) {
+    /* Skip leading spaces */
+    for(; **str && (**str == ' ' || **str == '\t'); *str += 1);
+    /* Check for empty string */
+    if(!(**str)) {
+        writeStr("Non-content input\n");
+        return 1;
+    }
+
+    /* Extract token */
+    dest->ptr = *str;
+    while(**str && **str != ' ' && **str != '\t' && **str != ',')
+        *str += 1;
+    dest->len = (size_t)(*str - dest->ptr);
+
+    /* Skip trailing spaces */
+    for(; **str && (**str == ' ' || **str == '\t'); *str += 1);
+    /* Check for illegal comma */
+    if(**str == ',') {
+        writeStr("Illegal comma\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Extracts the next token from a string.
+ *
+ * @param str The input string.
+ * @param dest The token, a view into the input string.
+ * @return 0 if successful, 1 if error occurred.
+ */
+int nextToken(char **str, token *dest) {
+    int cntCommas = 0;
+
+    /* Extract token */
+    dest->ptr = *str;
+    while(**str && **str != ' ' && **str != '\t' && **str != ',')
+        *str += 1;
+    dest->len = (size_t)(*str - dest->ptr);
+
+    /* Skip spaces and commas */
+    for(; **str && (**str == ' ' || **str == '\t' || **str == ','); *str += 1)
+        /* Count commas */
+        if(**str == ',') cntCommas++;
+    /* Check for end of string */
+    if(!(**str)) {
+        /* Handle extraneous text */
+        if(cntCommas > 0) {
+            writeStr("Extraneous text after end of command\n");
+            return 1;
+        }
+        return 0;
+    }
+    /* Handle different comma cases */
+    switch(cntCommas) {
+        case 0:
+            writeStr("Missing comma\n");
+            return 1;
+        case 1: return 0;
+        default:
+            writeStr("Multiple consecutive commas\n");
+            return 1;
+    }
+}
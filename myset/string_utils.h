@@ -1,58 +1,127 @@
-/**
- * @file string_utils.h
- * @brief Header file for a collection of utility functions for string manipulation.
- */
-
-#ifndef STRING_UTILS_H
-#define STRING_UTILS_H
-
-#include <stdlib.h>
-
-/**
- * @brief Reads a line of input from stdin.
- *
- * @param prompt The prompt to display to the user.
- * @return A dynamically allocated string containing the input line.
- * @note It is the caller's responsibility to free this memory.
- */
-char *read_line(char *A);
-
-/**
- * @brief Extracts the first token from a string.
- *
- * @param str The input string.
- * @param dest The destination buffer to store the token.
- * @return 0 if successful, 1 if error occurred.
- */
-int firstToken(char **str, char *dest);
-
-/**
- * @brief Extracts the next token from a string.
- *
- * @param str The input string.
- * @param dest The destination buffer to store the token.
- * @return 0 if successful, 1 if error occurred.
- */
-int nextToken(char **str, char *dest);
-
-/**
- * @brief Allocates memory for an array of strings.
- *
- * @param ptrArr The array of string pointers.
- * @param len The length of the array.
- * @param allocSize The size to allocate for each string.
- * @note This function dynamically allocates memory for each string in ptrArr.
- *       It is the caller's responsibility to free this memory.
- */
-void allocPtrArray(char *ptrArr[], int len, size_t allocSize);
-
-/**
- * @brief Frees memory allocated for an array of strings.
- *
- * @param ptrArr The array of string pointers.
- * @param len The length of the array.
- * @note This function frees memory allocated for each string in ptrArr.
- */
-void freePtrArray(char *ptrArr[], int len);
-
-#endif /* STRING_UTILS_H */
+/**
+ * @file string_utils.h
+ * @brief Header file for a collection of utility functions for string manipulation.
+ */
+
+#ifndef STRING_UTILS_H
+#define STRING_UTILS_H
+
+#include <stdlib.h>
+
+#define INPUT_SIZE 65536 /**< Define the initial size of the input buffer in bytes */
+#define FRAME_MAGIC 0xF5 /**< Define the first byte of a binary command, no text command starts with it */
+#define FRAME_HEADER 4   /**< Define the number of bytes of the header of a binary command */
+
+/**
+ * @brief Structure representing a token of a command.
+ *
+ * A token is a view into the command line, it is not null-terminated.
+ */
+typedef struct {
+    char *ptr;  /**< First character of the token */
+    size_t len; /**< Number of characters in the token, 0 if there is none */
+} token;
+
+/**
+ * @brief Structure representing a buffered input stream of commands.
+ */
+typedef struct {
+    int fd;          /**< Descriptor the commands are read from */
+    char *buf;       /**< Block of input being split into lines */
+    size_t cap;      /**< Size of the input block in bytes */
+    size_t start;    /**< Offset of the next line in the block */
+    size_t end;      /**< Number of bytes read into the block */
+    int eof;         /**< 1 once the end of the input was reached */
+    int interactive; /**< 1 if the output is flushed before each read, -1 until checked */
+} inputStream;
+
+/**
+ * @brief Makes the calling thread read its commands from a stream.
+ *
+ * The output is flushed before every read of a bound stream, since its
+ * client waits for the replies before sending more commands.
+ *
+ * @param in Pointer to the stream.
+ * @param fd Descriptor the stream reads from.
+ */
+void bindInput(inputStream *in, int fd);
+
+/**
+ * @brief Reads the commands from a file instead of stdin.
+ *
+ * @param path Path of the command file.
+ * @return 0 if successful, 1 if the file cannot be opened.
+ */
+int openInput(const char *path);
+
+/**
+ * @brief Releases the input buffer and closes the command file.
+ *
+ * A stream bound by the thread is closed and the thread reads stdin again.
+ */
+void closeInput(void);
+
+/**
+ * @brief Checks whether the replies to the commands are awaited before more are read.
+ *
+ * @return 1 for a user typing the commands or a client of the server, 0 for a command file or a pipe.
+ */
+int isInteractive(void);
+
+/**
+ * @brief Reads a line of input.
+ *
+ * A binary command, starting with FRAME_MAGIC, is read whole instead of up
+ * to the next newline, and is not null-terminated.
+ *
+ * @param prompt The prompt to display to the user.
+ * @return The input line or binary command, or NULL at the end of the input.
+ * @note The line is owned by the reader and stays valid until the next call.
+ */
+char *read_line(char *A);
+
+/**
+ * @brief Decodes an unsigned 32-bit integer stored least significant byte first.
+ *
+ * @param bytes The 4 bytes of the integer.
+ * @return The integer.
+ */
+unsigned long unpack32(const char *bytes);
+
+/**
+ * @brief Checks whether a token is equal to a string.
+ *
+ * @param tok The token.
+ * @param str The null-terminated string.
+ * @return 1 if they hold the same characters, 0 otherwise.
+ */
+int tokenEquals(token tok, const char *str);
+
+/**
+ * @brief Hashes characters with the FNV-1a hash.
+ *
+ * @param str The characters, not necessarily null-terminated.
+ * @param len Number of characters.
+ * @return The hash of the characters.
+ */
+unsigned long hashChars(const char *str, size_t len);
+
+/**
+ * @brief Extracts the first token from a string.
+ *
+ * @param str The input string.
+ * @param dest The token, a view into the input string.
+ * @return 0 if successful, 1 if error occurred.
+ */
+int firstToken(char **str, token *dest);
+
+/**
+ * @brief Extracts the next token from a string.
+ *
+ * @param str The input string.
+ * @param dest The token, a view into the input string.
+ * @return 0 if successful, 1 if error occurred.
+ */
+int nextToken(char **str, token *dest);
+
+#endif /* STRING_UTILS_H */
@@ -0,0 +1,157 @@
+/**
+ * @file worker_pool.c
+ * @brief Worker threads sharing the word kernels of large set operations.
+ */
+
+#include <pthread.h>
+#include "worker_pool.h"
+
+#define CHUNK_ALIGN_WORDS (SET_ALIGN / sizeof(setWord)) /**< Number of words in one aligned block */
+
+/**
+ * @brief Structure representing a kernel call shared by the threads.
+ */
+typedef struct {
+    wordKernel kernel; /**< The kernel */
+    setWord *dst;      /**< Destination words */
+    const setWord *a;  /**< First operand words */
+    const setWord *b;  /**< Second operand words */
+    size_t n;          /**< Number of words */
+} kernelJob;
+
+static pthread_mutex_t busy = PTHREAD_MUTEX_INITIALIZER; /**< Held by the thread whose job the pool is running */
+static pthread_t workers[WORKERS_MAX];                   /**< Worker threads, the calling thread excluded */
+static int ranges[WORKERS_MAX];                          /**< Index of the range of each worker thread */
+static int workerCount = 0;                              /**< Number of worker threads */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; /**< Guards every variable below */
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;   /**< Signaled when a job is posted or the pool stops */
+static pthread_cond_t done = PTHREAD_COND_INITIALIZER;   /**< Signaled when the last worker finishes a job */
+static kernelJob job;                                    /**< Job being run */
+static unsigned long generation = 0;                     /**< Number of jobs posted */
+static int pending = 0;                                  /**< Number of workers still running the job */
+static int stopping = 0;                                 /**< 1 once the pool is stopping */
+
+/**
+ * @brief Runs the kernel of the job on one range of its words.
+ *
+ * @param index Index of the range, 0 for the calling thread.
+ */
+static void runRange(int index) {
+    size_t parts = (size_t)workerCount + 1, size, start, end;
+
+    /* Every range but the last is a whole number of aligned blocks */
+    size = (job.n / parts + CHUNK_ALIGN_WORDS - 1) / CHUNK_ALIGN_WORDS * CHUNK_ALIGN_WORDS;
+    start = (size_t)index * size;
+    end = start + size < job.n ? start + size : job.n;
+
+    if(start < end)
+        job.kernel(job.dst + start, job.a + start, job.b + start, end - start);
+}
+
+/**
+ * @brief Main loop of a worker thread, running its range of every posted job.
+ *
+ * @param arg Pointer to the index of the range of the thread.
+ * @return Always NULL.
+ */
+static void *workerMain(void *arg) {
+    int index = *(int *)arg;
+    unsigned long seen;
+
+    /* Only the jobs posted after the thread started are its own */
+    pthread_mutex_lock(&lock);
+    seen = generation;
+    pthread_mutex_unlock(&lock);
+
+    for(;;) {
+        pthread_mutex_lock(&lock);
+        while(generation == seen && !stopping)
+            pthread_cond_wait(&wake, &lock);
+        if(stopping) {
+            pthread_mutex_unlock(&lock);
+            return NULL;
+        }
+        seen = generation;
+        pthread_mutex_unlock(&lock);
+
+        runRange(index);
+
+        pthread_mutex_lock(&lock);
+        if(!--pending) pthread_cond_signal(&done);
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param threads Number of threads sharing the work, the calling thread included, from 1 to WORKERS_MAX.
+ * @return 0 if successful, 1 if the threads could not be created (the pool is left empty).
+ */
+int startWorkers(int threads) {
+    stopWorkers();
+
+    for(; workerCount < threads - 1; workerCount++) {
+        ranges[workerCount] = workerCount + 1;
+        if(pthread_create(&workers[workerCount], NULL, workerMain, &ranges[workerCount])) {
+            stopWorkers();
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops the worker threads and waits for them to exit.
+ */
+void stopWorkers(void) {
+    int i;
+
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    for(i = 0; i < workerCount; i++)
+        pthread_join(workers[i], NULL);
+
+    workerCount = 0;
+    stopping = 0;
+}
+
+/**
+ * @brief Runs a word kernel, on the worker threads if the arrays are large enough.
+ *
+ * @param kernel The kernel.
+ * @param dst Destination words, 64-byte aligned, may be the same array as a or b.
+ * @param a First operand words.
+ * @param b Second operand words.
+ * @param n Number of words.
+ */
+void runKernel(wordKernel kernel, setWord *dst, const setWord *a, const setWord *b, size_t n) {
+    /* While the pool runs the job of another client, the calling thread does the whole job */
+    if(!workerCount || n < PARALLEL_MIN_WORDS || pthread_mutex_trylock(&busy)) {
+        kernel(dst, a, b, n);
+        return;
+    }
+
+    /* Post the job, the workers read it once they see the new generation */
+    pthread_mutex_lock(&lock);
+    job.kernel = kernel;
+    job.dst = dst;
+    job.a = a;
+    job.b = b;
+    job.n = n;
+    pending = workerCount;
+    generation++;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    runRange(0);
+
+    pthread_mutex_lock(&lock);
+    while(pending)
+        pthread_cond_wait(&done, &lock);
+    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&busy);
+}
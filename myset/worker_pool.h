@@ -0,0 +1,47 @@
+/**
+ * @file worker_pool.h
+ * @brief Worker threads sharing the word kernels of large set operations.
+ *
+ * The pool is started once with a fixed number of threads. A kernel call on
+ * at least PARALLEL_MIN_WORDS words is split into one contiguous range per
+ * thread, each a whole number of aligned blocks so that no two threads write
+ * the same cache line, and the calling thread computes the first range.
+ * Every word of the result is computed by the same kernel from the same
+ * operand words whatever the split, so the result does not depend on the
+ * number of threads. The pool runs one call at a time, a thread calling a
+ * kernel while it is busy computes the whole call by itself.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "set_kernels.h"
+
+#define WORKERS_MAX 64               /**< Define the largest number of threads, the calling thread included */
+#define PARALLEL_MIN_WORDS 131072    /**< Define the smallest kernel call split across the threads (1 MiB) */
+
+/**
+ * @brief Starts the worker threads.
+ *
+ * @param threads Number of threads sharing the work, the calling thread included, from 1 to WORKERS_MAX.
+ * @return 0 if successful, 1 if the threads could not be created (the pool is left empty).
+ */
+int startWorkers(int threads);
+
+/**
+ * @brief Stops the worker threads and waits for them to exit.
+ */
+void stopWorkers(void);
+
+/**
+ * @brief Runs a word kernel, on the worker threads if the arrays are large enough.
+ *
+ * @param kernel The kernel.
+ * @param dst Destination words, 64-byte aligned, may be the same array as a or b.
+ * @param a First operand words.
+ * @param b Second operand words.
+ * @param n Number of words.
+ */
+void runKernel(wordKernel kernel, setWord *dst, const setWord *a, const setWord *b, size_t n);
+
+#endif /* WORKER_POOL_H */